@@ -0,0 +1,30 @@
+#ifndef ACTUATOR_STATE_H
+#define ACTUATOR_STATE_H
+
+#include "supabase.h"
+
+/*
+ * Coalesced device_actuator_state publishing.
+ * Commands, auto-offs, schedules and the health check only record the new
+ * value of a field; the changed fields go out as one merged upsert per loop
+ * tick, so a burst of toggles costs one request carrying the final state.
+ */
+
+typedef enum {
+    ASTATE_LIGHTS,
+    ASTATE_PUMP,
+    ASTATE_FAN_DUTY,
+    ASTATE_BME_OK,
+    ASTATE_SOIL_OK,
+    ASTATE_COUNT
+} actuator_state_field_t;
+
+/* Record a field's current value; it is sent only if it differs from what
+ * Supabase last acknowledged (every field is sent once after startup) */
+void actuator_state_mark(actuator_state_field_t field, int value);
+
+/* Upsert every dirty field in one request. Fields stay dirty if it fails and
+ * go out with the next flush. Returns 0 if nothing was pending or it succeeded. */
+int actuator_state_flush(supabase_config_t *cfg);
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef BME680_H
 #define BME680_H
 
+#ifndef PHYTOPI_SIM
 #include "../lib/BME68x_SensorAPI/bme68x.h"
+#endif
 
 /* BME680 sensor reading structure */
 typedef struct {
@@ -19,6 +21,12 @@ int bme680_init(void);
 /* Read sensor data. Returns 0 on success, -1 on failure. */
 int bme680_read(bme680_data_t *data);
 
+/* Split read: start a forced-mode conversion, then fetch its result.
+ * bme680_collect() only sleeps for whatever part of the conversion time has
+ * not already elapsed since bme680_trigger(). Both return 0 on success, -1 on failure. */
+int bme680_trigger(void);
+int bme680_collect(bme680_data_t *data);
+
 /* Cleanup resources */
 void bme680_cleanup(void);
 
@@ -0,0 +1,31 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "commands.h"
+
+#define CAPTURE_MAX_JOBS 4
+#define CAPTURE_TIMEOUT_DEFAULT 120 /* seconds before SIGTERM, override with CAPTURE_TIMEOUT_SEC */
+#define CAPTURE_KILL_GRACE 5        /* seconds between SIGTERM and SIGKILL */
+
+/* Called once per job when it finishes, fails or times out. ok = image captured and uploaded. */
+typedef void (*capture_done_fn)(const char *command_id, int ok, void *ctx);
+
+void capture_init(capture_done_fn on_done, void *ctx);
+
+/* Start a capture for a command without waiting for it: sent to the capture
+ * worker on CAPTURE_WORKER_SOCKET when reachable (autostarting it unless
+ * CAPTURE_WORKER_AUTOSTART=0), otherwise CAPTURE_SCRIPT_PATH as a child.
+ * Returns 0 if the job started, -1 if it could not (table full, fork failed). */
+int capture_start(const char *command_id, const char *device_id);
+
+/* Number of jobs still running */
+int capture_active(void);
+
+/* Collect worker replies, reap finished children and enforce timeouts. Waits up
+ * to timeout_ms (0 = just check), returning early when a job completes. */
+void capture_poll(int timeout_ms);
+
+/* Kill and reap every running job (reported as failed) and stop an autostarted worker */
+void capture_cleanup(void);
+
+#endif
@@ -2,26 +2,105 @@
 #define COMMANDS_H
 
 #include "supabase.h"
+#include <stddef.h>
 
 #define CMD_TYPE_LEN 32
 #define CMD_ID_LEN 64
-#define CMD_PAYLOAD_LEN 256
+#define CMD_ERROR_LEN 128
+#define COMMAND_FETCH_MAX 50   /* pending commands drained per poll */
+#define COMMAND_TABLE_SIZE 32  /* handler hash table slots, power of two */
+#define COMMAND_MAX_DURATION_SEC 86400
+
+struct json_object;
+
+/* Typed payloads, decoded once when the command is fetched */
+typedef struct {
+    int state;          /* 1 = on */
+    int duration_sec;   /* auto-off after, 0 = none */
+} cmd_switch_args_t;    /* toggle_light, toggle_pump, toggle_fans */
+
+typedef struct {
+    int duration_sec;
+    int duty_percent;
+} cmd_ventilation_args_t; /* run_ventilation */
+
+typedef struct {
+    int fan_id;         /* 1 or 2 */
+    int duty_percent;
+} cmd_fan_speed_args_t; /* set_fan_speed */
+
+typedef union {
+    cmd_switch_args_t sw;
+    cmd_ventilation_args_t vent;
+    cmd_fan_speed_args_t fan;
+} command_args_t;
+
+typedef enum {
+    CMD_FAILED,
+    CMD_EXECUTED,
+    CMD_RUNNING     /* acknowledged later, e.g. capture_image */
+} command_result_t;
+
+struct device_command;
+
+/* Decode the payload into args; return -1 with a reason in err to reject it */
+typedef int (*command_decode_fn)(struct json_object *payload, command_args_t *args, char *err, size_t err_len);
+/* Execute a decoded command; set err when returning CMD_FAILED */
+typedef command_result_t (*command_run_fn)(const struct device_command *cmd, void *ctx, char *err, size_t err_len);
 
 typedef struct {
+    const char *type;
+    unsigned int hash;
+    command_decode_fn decode;
+    command_run_fn run;
+} command_handler_t;
+
+typedef struct device_command {
     char id[CMD_ID_LEN];
     char command_type[CMD_TYPE_LEN];
-    char payload_json[CMD_PAYLOAD_LEN];
+    const command_handler_t *handler; /* NULL if the type is unknown or the payload invalid */
+    command_args_t args;
+    char error[CMD_ERROR_LEN];        /* rejection reason when handler is NULL */
 } device_command_t;
 
+/* Register a handler for a command_type (decode may be NULL for payload-less
+ * commands). Returns 0 on success, -1 if the table is full or type is taken. */
+int command_register(const char *type, command_decode_fn decode, command_run_fn run);
+
+/* Handler for a command_type, NULL if none is registered */
+const command_handler_t *command_lookup(const char *type);
+
+/* Run a fetched command through its handler. err receives the failure reason. */
+command_result_t command_dispatch(const device_command_t *cmd, void *ctx, char *err, size_t err_len);
+
+/* Stock payload decoders */
+int command_decode_switch(struct json_object *payload, command_args_t *args, char *err, size_t err_len);
+int command_decode_ventilation(struct json_object *payload, command_args_t *args, char *err, size_t err_len);
+int command_decode_fan_speed(struct json_object *payload, command_args_t *args, char *err, size_t err_len);
+
 /* Fetch the next pending light command for this device. */
 int fetch_next_light_command(const supabase_config_t *cfg, int *desired_state, char *command_id_buf, int command_id_buf_len);
 
 /* Fetch the next pending command of any type. Returns 1 if found, 0 if none, -1 on error. */
 int fetch_next_command(const supabase_config_t *cfg, device_command_t *cmd);
 
+/* Fetch every pending command (up to COMMAND_FETCH_MAX) oldest first in one request.
+ * *cmds is malloc'd, caller frees. Returns the count, 0 if none, -1 on error. */
+int fetch_pending_commands(const supabase_config_t *cfg, device_command_t **cmds, int *count);
+
+/* Set the status of several commands with one PATCH (id=in.(...)).
+ * Final states ("executed", "failed") also stamp executed_at. Returns 0 on success. */
+int mark_commands_status(const supabase_config_t *cfg, const char *const *command_ids, int n, const char *status);
+
+/* Mark a command failed and record why in device_commands.error */
+int mark_command_failed(const supabase_config_t *cfg, const char *command_id, const char *reason);
+
 /* Mark a command as processed with given status ("executed" or "failed"). */
 int mark_command_processed(const supabase_config_t *cfg, const char *command_id, const char *status);
 
+/* Take a long-running command off the pending queue until it is marked processed. */
+int mark_command_running(const supabase_config_t *cfg, const char *command_id);
+
 /* Legacy alias */
 #define mark_light_command_processed mark_command_processed
 
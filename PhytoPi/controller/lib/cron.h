@@ -0,0 +1,34 @@
+#ifndef CRON_H
+#define CRON_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Five-field cron expressions ("min hour day-of-month month day-of-week"),
+ * compiled once into bitmasks. Fields take *, numbers, a-b ranges, comma
+ * lists and /step; months and weekdays also take JAN..DEC / SUN..SAT and
+ * weekday 7 is Sunday. @hourly, @daily, @weekly, @monthly and @yearly are
+ * accepted. Shorter expressions are padded with *, so the older "30 6" and
+ * "*\/15" schedule forms keep their meaning. As in cron, when both day fields
+ * are restricted a day matches if either does. Times are local time.
+ */
+
+typedef struct {
+    uint64_t minute; /* bit n = minute n (0-59) */
+    uint32_t hour;   /* 0-23 */
+    uint32_t mday;   /* 1-31 */
+    uint16_t month;  /* 1-12 */
+    uint8_t wday;    /* 0-6, Sunday = 0 */
+    uint8_t mday_any;
+    uint8_t wday_any;
+} cron_expr_t;
+
+/* Compile expr. Returns 0 on success, -1 if it is malformed. */
+int cron_parse(const char *expr, cron_expr_t *out);
+
+/* First matching minute strictly after 'after', or -1 if none within 5 years
+ * (e.g. "0 0 31 2 *") */
+time_t cron_next(const cron_expr_t *c, time_t after);
+
+#endif
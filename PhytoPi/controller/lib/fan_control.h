@@ -0,0 +1,58 @@
+#ifndef FAN_CONTROL_H
+#define FAN_CONTROL_H
+
+#include <time.h>
+
+/*
+ * Closed-loop fan control.
+ * Drives the fan duty from temperature and/or humidity setpoints on every
+ * BME680 sample instead of fixed-duty blocks. Each setpoint runs its own loop
+ * and the fans follow the higher demand:
+ *
+ *   pid        - PI(D) on the error above the setpoint. The integral stops
+ *                growing while the output is saturated and is clamped to the
+ *                duty range (anti-windup); the derivative acts on the
+ *                filtered measurement, not the error.
+ *   hysteresis - full duty above setpoint + band, off below setpoint - band.
+ *
+ * The output is rate limited (duty % per second), demands below the minimum
+ * running duty switch the fans off, and the PWM is only rewritten when the
+ * duty moves by FAN_CTRL_WRITE_STEP or more, so small corrections do not turn
+ * into actuator writes and state uploads.
+ *
+ * Configured from the environment at fan_control_init():
+ *   PHYTOPI_FAN_MODE=pid|hysteresis       (unset or anything else = off)
+ *   PHYTOPI_FAN_TEMP_SETPOINT=<deg C>     PHYTOPI_FAN_HUMIDITY_SETPOINT=<%RH>
+ *   PHYTOPI_FAN_TEMP_PID="kp:ki:kd"       PHYTOPI_FAN_HUMIDITY_PID="kp:ki:kd"
+ *                                         duty % per unit, per unit-second, per unit/s
+ *   PHYTOPI_FAN_BAND="temp:humidity"      hysteresis half-widths
+ *   PHYTOPI_FAN_MIN_DUTY=<%>              PHYTOPI_FAN_RATE=<% per second>
+ */
+
+#define FAN_CTRL_TEMP_PID_DEFAULT "25:0.2:0"
+#define FAN_CTRL_HUMIDITY_PID_DEFAULT "10:0.08:0"
+#define FAN_CTRL_BAND_DEFAULT "0.5:3"
+#define FAN_CTRL_MIN_DUTY 20   /* lowest duty the fans run at; lower demands switch them off */
+#define FAN_CTRL_MAX_DUTY 100
+#define FAN_CTRL_RATE 5        /* duty % per second */
+#define FAN_CTRL_WRITE_STEP 10 /* smallest duty change worth a PWM write */
+#define FAN_CTRL_MAX_DT 60     /* longer sample gaps restart the loops */
+
+/* Read the configuration. Returns 1 if closed-loop control is enabled. */
+int fan_control_init(void);
+
+int fan_control_enabled(void);
+
+/* Feed one sample taken at 'now' (NAN for a value that is missing or
+ * invalid). applied is the duty the fans run at. Returns the duty to write,
+ * or -1 to leave the fans as they are. */
+int fan_control_update(time_t now, double temp_c, double humidity, int applied);
+
+/* Another source (timed command or schedule) owns the fans for now. The next
+ * update restarts from the duty it left behind. */
+void fan_control_hold(void);
+
+/* Print sample count, error and PWM write statistics */
+void fan_control_report(void);
+
+#endif
@@ -8,8 +8,12 @@
 #include <stdint.h>
 #include <time.h>
 
-/* GPIO Library */
+/* GPIO Library (the simulated backend needs no hardware headers) */
+#ifdef PHYTOPI_SIM
+#include "sim.h"
+#else
 #include <gpiod.h>
+#endif
 
 /* I2C Libraries */
 #include <linux/i2c-dev.h>
@@ -24,6 +28,7 @@
 #define FAN2_PWM_PIN 13      /* Hardware PWM1 - Fan 2 */
 #define DATA_READ_INTERVAL 2 /* In seconds */
 #define PCF8591_ADDR 0x48    /* Default 7-bit I2C address for PCF8591 */
+#define PCF8591_CHANNELS 4   /* AIN0..AIN3 */
 #define BME680_ADDR 0x76     /* BME680 I2C address (or 0x77) */
 
 /* GPIO function declarations */
@@ -34,6 +39,16 @@ int gpio_write(int value);
 int gpio_read(void);
 int gpio_cleanup(void);
 
+/* Digital actuators: one multi-line request for every output pin.
+ * actuators_set() drives the ACT_* bits in mask to the matching bits of
+ * values in a single ioctl, so scene changes switch together. */
+#define ACT_LIGHTS (1u << 0)
+#define ACT_PUMP (1u << 1)
+#define ACT_COUNT 2
+int actuators_init(void);
+int actuators_set(unsigned int mask, unsigned int values);
+unsigned int actuators_get(void); /* ACT_* bits currently driven high */
+
 /* Light control (24V MOSFET on GPIO17) */
 int lights_init(void);
 int lights_set(int on);
@@ -42,6 +57,12 @@ int lights_set(int on);
 int pump_init(void);
 int pump_set(int on);
 
+/* Dry-run interlock. While locked out, requests to switch the pump on drive it
+ * off and return -1. Engaging switches a running pump off in the same call.
+ * Returns 1 if a running pump was cut, 0 if not, -1 if the cut failed. */
+int pump_lockout(int on);
+int pump_locked_out(void);
+
 /* PWM fan control (GPIO12, GPIO13) - duty 0-100 percent */
 int fans_init(void);
 int fans_set_speed(int fan_id, int duty_percent);
@@ -50,8 +71,20 @@ int fans_set_both(int duty_percent);
 /* Photoelectric water level - returns frequency (Hz), -1 on error. Low = low water */
 int read_photoelectric_water_level(int *frequency_hz);
 
+/* Water level edge stream: request rising-edge events on the water pin and
+ * return a file descriptor that polls readable when edges are queued (-1 on
+ * error). water_level_read_edges() drains the queue and returns the number of
+ * rising edges read, -1 on error. */
+#define WATER_EDGE_BUFFER 64
+int water_level_watch(void);
+int water_level_read_edges(void);
+
 /* PCF8591 ADC */
 int i2c_init(const char *i2c_bus);
+int i2c_init_addr(const char *i2c_bus, int addr);
 int read_pcf8591_channel(int fd, int channel);
+/* Read AIN0..AIN3 in one bulk transfer using the auto-increment flag.
+ * values[ch] receives the 8-bit sample. Returns 0 on success, -1 on failure. */
+int read_pcf8591_scan(int fd, int values[PCF8591_CHANNELS]);
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef INTERLOCK_H
+#define INTERLOCK_H
+
+#include <time.h>
+
+/*
+ * Pump dry-run interlock.
+ * A dedicated thread counts rising edges of the photoelectric water level
+ * sensor from the GPIO edge stream in back-to-back measurement windows and
+ * maps every window to a water state. The window that reads Empty locks the
+ * pump out at the GPIO layer, switching off a running pump in the same call;
+ * while locked out every request to start the pump is refused. The lock
+ * releases once a window reads Low or better. None of this waits on the
+ * main loop or the network.
+ *
+ * Without an edge stream (simulator, or the request fails) the water driver
+ * feeds its own readings in, so the interlock still holds at the polling rate.
+ *
+ * Engage, release, cut and refusal events are queued for the main loop,
+ * which records them in SQLite (pump_interlock_log).
+ */
+
+#define INTERLOCK_WINDOW_MS 100   /* one frequency measurement, same as the polled read */
+#define INTERLOCK_RT_PRIORITY 49  /* just below the auto-off thread */
+#define INTERLOCK_EVENT_QUEUE 32  /* oldest events are dropped when full */
+
+typedef enum {
+    INTERLOCK_ENGAGED,  /* reservoir read Empty, pump locked out */
+    INTERLOCK_RELEASED, /* water back, pump allowed again */
+    INTERLOCK_CUT,      /* a running pump was switched off */
+    INTERLOCK_REFUSED,  /* a request to start the pump was refused */
+} interlock_event_type_t;
+
+typedef struct {
+    interlock_event_type_t type;
+    int water_hz;       /* frequency of the window that decided it */
+    time_t timestamp;
+} interlock_event_t;
+
+/* Measure one window and start the edge stream thread. Call before the pump
+ * is switched on for the first time. Returns 0 if the thread runs, -1 if the
+ * interlock falls back to the water driver's readings. */
+int interlock_start(void);
+
+/* Evaluate one frequency measurement (fallback path) */
+void interlock_feed(int hz);
+
+/* Latest windowed frequency from the edge stream. Returns 0 and fills *hz
+ * while the thread runs, -1 otherwise. */
+int interlock_water_hz(int *hz);
+
+/* 1 while the pump is locked out */
+int interlock_engaged(void);
+
+/* Record that a pump start was refused by the lockout */
+void interlock_refused(void);
+
+/* Pop the oldest queued event. Returns 1 if ev was filled, 0 if none. */
+int interlock_take_event(interlock_event_t *ev);
+
+const char *interlock_event_name(interlock_event_type_t type);
+
+void interlock_stop(void);
+
+#endif
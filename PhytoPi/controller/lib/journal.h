@@ -0,0 +1,40 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "supabase.h"
+
+/*
+ * Command journal.
+ * Every fetched device command is written to the local SQLite table
+ * command_journal before it runs and again with its outcome, so a command is
+ * executed at most once even if its acknowledgement is lost or the controller
+ * restarts. Acknowledgements are sent to Supabase from a background thread
+ * that retries unacknowledged outcomes until they stick.
+ */
+
+#define JOURNAL_RETENTION_SEC (7 * 86400) /* acknowledged entries are kept this long */
+#define JOURNAL_RETRY_MIN_SEC 5
+#define JOURNAL_RETRY_MAX_SEC 300
+#define JOURNAL_ACK_BATCH 50
+
+/* Open the journal in db_path (its own connection), load it into the in-memory
+ * index, fail entries interrupted by a restart and start the ack thread.
+ * Returns 0 on success, -1 on error. */
+int journal_init(const char *db_path, const supabase_config_t *cfg);
+
+/* 1 if the command id has been journaled (it must not run again), 0 if not. O(1). */
+int journal_seen(const char *command_id);
+
+/* Record a command's state: "started" before it runs, then "running",
+ * "executed" or "failed" (with error). Final states are queued for ack.
+ * Returns 0 on success, -1 if the entry could not be persisted. Without an
+ * open journal nothing is recorded and every call returns -1. */
+int journal_record(const char *command_id, const char *status, const char *error);
+
+/* Wake the ack thread now (e.g. after a poll saw journaled commands still pending) */
+void journal_kick(void);
+
+/* Stop the ack thread and close the journal */
+void journal_stop(void);
+
+#endif
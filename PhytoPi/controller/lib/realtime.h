@@ -0,0 +1,38 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include "supabase.h"
+
+/*
+ * Supabase Realtime subscription for device_commands.
+ * Holds one websocket to the Realtime server joined to INSERTs for this
+ * device_id, so a queued command wakes the controller instead of waiting for
+ * the next poll. Only the notification travels over the socket; commands are
+ * still fetched and acknowledged over REST.
+ */
+
+#define REALTIME_HEARTBEAT_SEC 25     /* Phoenix heartbeat, server drops idle sockets after ~60s */
+#define REALTIME_CONNECT_TIMEOUT 5    /* seconds for TCP + TLS + upgrade */
+#define REALTIME_RECONNECT_MAX_SEC 60 /* reconnect backoff cap */
+
+/* Configure from cfg. The socket URL is derived from SUPABASE_URL unless
+ * SUPABASE_REALTIME_URL is set (e.g. ws://127.0.0.1:4000/socket for the local
+ * stand-in); SUPABASE_REALTIME=0 disables it. Connects immediately.
+ * Returns 0 if enabled (connected or retrying), -1 if disabled. */
+int realtime_init(const supabase_config_t *cfg);
+
+/* 1 while the socket is up and the channel is joined */
+int realtime_connected(void);
+
+/* Service the socket for up to timeout_ms: read notifications, send
+ * heartbeats, reconnect with backoff. Returns early once a command
+ * notification is pending. Returns 1 if one is pending, 0 if not,
+ * -1 if the socket is down. */
+int realtime_poll(int timeout_ms);
+
+/* 1 (once) if a command was pushed, or the channel (re)joined, since the last call */
+int realtime_take_pending(void);
+
+void realtime_cleanup(void);
+
+#endif
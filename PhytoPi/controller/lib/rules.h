@@ -0,0 +1,79 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <time.h>
+#include "supabase.h"
+
+/*
+ * Local automation rules.
+ * Rows from automation_rules are compiled once into a flat program sorted by
+ * actuator: metric group index, on/off bounds and hold times. Each sampling
+ * tick collapses the live metrics into per-group min/max vectors, steps
+ * every rule's latch and reduces the latches of each actuator to one output
+ * level, with no string work and no network round-trip.
+ *
+ * A rule latches on when its metric goes past on_value ('above': any probe
+ * higher, 'below': any probe lower) and releases once it is back past
+ * off_value, so the band between the two is hysteresis. A latch holds at
+ * least min_on_sec before releasing and stays released at least min_off_sec
+ * before latching again. An actuator is on while any of its rules is
+ * latched; fans run at the highest duty among them.
+ *
+ * Outputs are edge-triggered: the caller applies an actuator only when its
+ * rule output changes, so commands and schedules still work in between.
+ * A change counts as handled once the caller confirms it with rules_applied().
+ */
+
+typedef enum {
+    RULE_LIGHTS,
+    RULE_PUMP,
+    RULE_FANS,
+    RULE_ACTUATOR_COUNT
+} rule_actuator_t;
+
+typedef struct {
+    int group;          /* dense index into the per-group value vectors */
+    int above;
+    double on_value;
+    double off_value;
+    int duty;           /* level while latched: 1 for lights/pump, duty % for fans */
+    int min_on_sec;
+    int min_off_sec;
+    int max_on_sec;
+    int latched;
+    time_t changed;     /* when the latch last flipped, 0 = never */
+    rule_actuator_t actuator;
+    char metric[THRESHOLD_METRIC_LEN];
+    char id[THRESHOLD_ID_LEN];
+} rule_t;
+
+typedef struct {
+    int level;          /* 0 = off, else 1 (lights/pump) or fan duty % */
+    int max_on_sec;     /* auto-off to arm when switching on, 0 = none */
+    int rule;           /* index of the rule that decided the level, -1 if none latched */
+} rule_output_t;
+
+/* Replace the active rules with the enabled rows whose metric is registered
+ * and whose actuator is known. Latches carry over for rows with the same id.
+ * Call after sensors_init(). Returns the number of compiled rules, -1 on
+ * allocation failure (old rules kept). */
+int rules_compile(const device_rule_t *rows, int count);
+
+int rules_count(void);
+const rule_t *rules_rule(int idx);
+
+/* 1 if any compiled rule drives the actuator */
+int rules_controls(rule_actuator_t act);
+
+/* Step every rule against the live sensor values and fill out[] with each
+ * actuator's level. Returns a bitmask (1 << rule_actuator_t) of actuators
+ * whose level differs from the one last confirmed with rules_applied(), so
+ * an output that failed to apply is reported again on the next call. */
+unsigned rules_evaluate(time_t now, rule_output_t out[RULE_ACTUATOR_COUNT]);
+
+/* The caller switched act to level */
+void rules_applied(rule_actuator_t act, int level);
+
+void rules_cleanup(void);
+
+#endif
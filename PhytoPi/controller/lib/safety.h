@@ -0,0 +1,42 @@
+#ifndef SAFETY_H
+#define SAFETY_H
+
+/*
+ * Actuator safety thread.
+ * Owns the auto-off deadlines of timed actuators and switches them off from a
+ * SCHED_FIFO thread woken by a timerfd, so a stalled sync, DB write or
+ * capture never stretches a pump run. The main loop only picks up the
+ * resulting state change afterwards via safety_take_fired().
+ */
+
+typedef enum {
+    SAFETY_LIGHTS,
+    SAFETY_PUMP,
+    SAFETY_FANS,
+    SAFETY_COUNT
+} safety_actuator_t;
+
+#define SAFETY_RT_PRIORITY 50
+#define SAFETY_HIST_BUCKETS 24 /* log2 microsecond buckets: <1us, <2us, <4us, ... last = overflow */
+
+/* Start the thread. Falls back to normal scheduling (with a warning) without
+ * CAP_SYS_NICE, and to in-loop checks if the thread cannot start.
+ * Returns 0 if the thread runs, -1 otherwise. */
+int safety_start(void);
+
+/* Arm an auto-off duration_sec from now, replacing any previous deadline.
+ * duration_sec <= 0 disarms. Call before switching the actuator on. */
+void safety_arm(safety_actuator_t act, int duration_sec);
+
+/* 1 if the deadline is armed */
+int safety_armed(safety_actuator_t act);
+
+/* 1 (once) if the actuator was switched off by its deadline since the last call */
+int safety_take_fired(safety_actuator_t act);
+
+/* Print fired count and overshoot histogram */
+void safety_report(void);
+
+void safety_stop(void);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <time.h>
+#include "supabase.h"
+#include "sql.h"
+#include "cron.h"
+#include "timer_wheel.h"
+
+/*
+ * Schedule timing.
+ * Each schedule is compiled once (cron expression or interval) and arms a
+ * timer on the loop's timer wheel at its next fire time; the loop sleeps
+ * until timer_wheel_next_expiry() and expired schedules queue up for
+ * scheduler_take_due(). Run state (last run, next fire, last
+ * alert) is looked up by schedule id in O(1) and saved to schedule_state, so
+ * interval schedules do not all fire again after a restart and cron runs
+ * missed while the controller was down follow the policy below.
+ *
+ * Missed runs (loop stall, controller down over the fire time):
+ *   cron     - fires once, late, if missed by at most SCHEDULE_MISFIRE_GRACE;
+ *              older misses are skipped and logged. Several missed
+ *              occurrences never fire more than once.
+ *   interval - fires once as soon as it is overdue, then every interval
+ *              from that run.
+ */
+
+#define SCHEDULE_MISFIRE_GRACE 300 /* seconds a cron run may be late and still fire */
+
+/* Load persisted run state from db (the main connection) and save changes
+ * there from now on. Call before the first scheduler_load. Returns the number
+ * of restored states, -1 on error (the scheduler still works, unpersisted). */
+int scheduler_init(sqlite3 *db);
+
+/* Replace the schedule set (timer_wheel_init must have run). Schedules whose id and timing are unchanged keep
+ * their next fire time; interval schedules never run are due immediately.
+ * Rows with an unparsable cron expression are skipped. Returns the number
+ * scheduled, -1 on allocation failure (old set kept). */
+int scheduler_load(const device_schedule_t *rows, int count, time_t now);
+
+/* Pop the next schedule whose timer expired (timer_wheel_advance up to
+ * 'now') into *out and reschedule it. Returns 1 if one is due, 0 if none.
+ * Call until it returns 0; the last call saves the changed run state in one
+ * transaction. */
+int scheduler_take_due(time_t now, device_schedule_t *out);
+
+/* 1 if the schedule's last alert is at least cooldown_sec old */
+int scheduler_alert_due(const char *id, time_t now, int cooldown_sec);
+
+/* Record that the schedule's alert was queued */
+void scheduler_alerted(const char *id, time_t now);
+
+void scheduler_cleanup(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SENSOR_DRIVERS_H
+#define SENSOR_DRIVERS_H
+
+#include "sensors.h"
+
+/* Water level states reported by the photoelectric driver */
+#define WATER_STATE_EMPTY 0
+#define WATER_STATE_FULL 4
+
+/* Map a photoelectric frequency (Hz) to a water state, with hysteresis
+ * around the band edges relative to last_state (-1 = none yet) */
+int frequency_to_water_state(int hz, int last_state);
+
+/*
+ * Register the built-in drivers: BME680, soil probes, photoelectric water
+ * level, and a live fan duty metric read from *fan_duty.
+ * Call before sensors_init(). Returns 0 on success.
+ */
+int sensor_drivers_register_builtin(const int *fan_duty);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <time.h>
+#include <sqlite3.h>
+
+#define SENSOR_MAX_DRIVERS 16
+#define SENSOR_MAX_METRICS 64
+#define SENSOR_METRIC_NAME_LEN 32
+#define SENSOR_VALUE_INVALID (-999.0)
+#define SENSOR_HEARTBEAT_INTERVAL 300   /* Store every metric at least this often (s) */
+#define SENSOR_FAIL_INVALIDATE_AFTER 5  /* Drop cached values after N consecutive failures */
+
+/*
+ * Static description of one metric a driver produces.
+ *   name      : unique key, stored in sensor_readings.metric (e.g. "temp_c", "soil_moisture.2")
+ *   group     : threshold metric name this feeds; several metrics may share one (e.g. all soil probes)
+ *   unit      : Supabase unit string
+ *   deadband  : store when |value - last stored| >= deadband
+ *   persist   : 0 = live value only (thresholds/automation), never stored or synced
+ *   sensor_id : Supabase sensor UUID, NULL/empty = stored locally but not synced
+ */
+typedef struct {
+    char name[SENSOR_METRIC_NAME_LEN];
+    char group[SENSOR_METRIC_NAME_LEN];
+    const char *unit;
+    double deadband;
+    int persist;
+    const char *sensor_id;
+} metric_desc_t;
+
+/*
+ * Sensor driver. init() runs once and may fill metrics/n_metrics.
+ * On each due tick the registry calls trigger() (optional) on every due
+ * driver first, then collect() on each, so slow conversions overlap.
+ * collect() writes n_metrics values, SENSOR_VALUE_INVALID for missing ones,
+ * and returns 0 on success, -1 if the whole read failed. cleanup() is optional.
+ */
+typedef struct sensor_driver {
+    const char *name;
+    int period_sec;
+    int (*init)(struct sensor_driver *drv);
+    int (*trigger)(struct sensor_driver *drv);
+    int (*collect)(struct sensor_driver *drv, double *values);
+    void (*cleanup)(struct sensor_driver *drv);
+    metric_desc_t *metrics;
+    int n_metrics;
+    const char *fail_alert_type;    /* alerts.type raised after repeated failures, NULL = none */
+    const char *fail_alert_msg;
+    void *ctx;
+
+    /* Registry-managed */
+    int init_ok;
+    int fail_count;
+    time_t last_poll;
+    time_t last_fail_alert;
+    int first_metric;
+} sensor_driver_t;
+
+/* Live state for one registered metric */
+typedef struct {
+    const metric_desc_t *desc;
+    sensor_driver_t *drv;
+    double value;
+    int valid;
+    double last_saved;
+    time_t last_saved_ts;
+    int next_in_group;  /* next metric index with the same group, -1 = end */
+} sensor_metric_t;
+
+/* Add a driver before sensors_init(). Returns 0 on success, -1 if the registry is full. */
+int sensors_register(sensor_driver_t *drv);
+
+/* Initialise all registered drivers and build the metric table. Returns metric count. */
+int sensors_init(void);
+
+/* Trigger and collect every driver whose period has elapsed. Returns number polled. */
+int sensors_poll(time_t now);
+
+/* Store metrics that moved past their deadband (or hit the heartbeat). Returns rows written. */
+int sensors_store(sqlite3 *db, time_t now);
+
+int sensors_metric_count(void);
+sensor_metric_t *sensors_metric(int idx);
+
+/* O(1) lookups. Return the metric index, -1 if unknown. */
+int sensors_metric_find(const char *name);
+int sensors_group_find(const char *group);
+
+int sensors_driver_count(void);
+sensor_driver_t *sensors_driver(int idx);
+sensor_driver_t *sensors_driver_find(const char *name);
+
+/* 1 if every metric of the driver currently holds a valid value */
+int sensors_driver_all_valid(const sensor_driver_t *drv);
+
+/* Release driver resources */
+void sensors_cleanup(void);
+
+/* Print one status line with all live metric values */
+void sensors_print(time_t now, const char *prefix);
+
+#endif
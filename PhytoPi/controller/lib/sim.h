@@ -0,0 +1,38 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <time.h>
+
+/*
+ * Simulated hardware backend (make SIM=1).
+ * src/sim.c replaces gpio.c, bme680.c and the Bosch driver: GPIO, PWM,
+ * the PCF8591 and the BME680 are served from waveforms with noise, a small
+ * plant model (pump wets the soil and drains the tank, fans cool, lights heat)
+ * and a fault script. Time is virtual so the loop can run faster than real time.
+ *
+ *   SIM_SPEED=<x>         virtual seconds per real second (default 1, 0 = never sleep)
+ *   SIM_DURATION=<s>      end the run after this many virtual seconds (default: never)
+ *   SIM_SEED=<n>          noise seed (default 1)
+ *   SIM_WAVE_<SIGNAL>="base:amplitude:period_s:noise"
+ *                         SIGNAL = TEMP, HUMIDITY, PRESSURE, GAS, SOIL (raw ADC), WATER (Hz)
+ *   SIM_FAULTS="dev@start[+duration];..."
+ *                         dev = bme680, soil, water, pwm, lights, pump; times in virtual
+ *                         seconds from start, no duration = fails until exit
+ */
+
+time_t sim_time(time_t *t);
+unsigned int sim_sleep(unsigned int seconds);
+
+/* Print actuator/sensor counters gathered during the run */
+void sim_report(void);
+
+/* 1 once SIM_DURATION virtual seconds have passed; the loop then exits cleanly */
+int sim_done(void);
+
+/* Route the controller's wall clock through the virtual clock */
+#ifndef SIM_NO_REDIRECT
+#define time(t) sim_time(t)
+#define sleep(s) sim_sleep(s)
+#endif
+
+#endif
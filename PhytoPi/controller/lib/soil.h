@@ -0,0 +1,51 @@
+#ifndef SOIL_H
+#define SOIL_H
+
+#include "gpio.h"
+
+#define SOIL_MAX_PROBES 32
+#define SOIL_MAX_ADCS 8
+#define SOIL_BUS_LEN 32
+#define SOIL_SENSOR_ID_LEN 64
+
+/*
+ * One soil moisture probe wired to a PCF8591 channel.
+ * Calibration is a two-point line: raw_dry maps to 0 %, raw_wet to 100 %.
+ * raw_dry > raw_wet is allowed (capacitive probes read lower when wet).
+ */
+typedef struct {
+    char bus[SOIL_BUS_LEN];              /* e.g. "/dev/i2c-1" */
+    int addr;                            /* PCF8591 7-bit address */
+    int channel;                         /* AIN0..AIN3 */
+    int raw_dry;
+    int raw_wet;
+    char sensor_id[SOIL_SENSOR_ID_LEN];  /* Supabase sensor UUID, empty = not synced */
+
+    /* Runtime state */
+    int adc;                             /* index into the ADC table */
+    int raw;                             /* last raw sample, -1 if unavailable */
+    int pct;                             /* last percent, -1 if unavailable */
+} soil_probe_t;
+
+/*
+ * Load the probe table and open one I2C handle per (bus, address).
+ * SOIL_PROBES="bus:addr:channel:raw_dry:raw_wet[:sensor_id];..." e.g.
+ *   SOIL_PROBES="/dev/i2c-1:0x48:0:0:150:<uuid>;/dev/i2c-1:0x49:1:210:90:<uuid>"
+ * When unset, a single probe on PCF8591_ADDR AIN0 is configured from
+ * SOIL_ADC_MAX and SUPABASE_SOIL_MOISTURE_SENSOR_ID (legacy behaviour).
+ * Returns the number of probes, -1 on a malformed table.
+ */
+int soil_probes_init(void);
+
+/* Scan every ADC once and update raw/pct on all probes. Returns the number of valid probes. */
+int soil_probes_scan(void);
+
+int soil_probes_count(void);
+soil_probe_t *soil_probe_get(int idx);
+
+/* Map a raw ADC sample to 0–100 % using the probe calibration. Returns -1 if raw < 0. */
+int soil_raw_to_percent(const soil_probe_t *p, int raw);
+
+void soil_probes_cleanup(void);
+
+#endif
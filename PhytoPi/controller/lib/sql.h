@@ -1,24 +1,67 @@
 #ifndef SQL_H
 #define SQL_H
 #include <sqlite3.h>
+#include <stdint.h>
+#include "supabase.h"
 
-/* Reading structure for batch operations */
+/* The command journal writes the same file from its own connection, so every
+ * connection waits this long for the other's write lock instead of failing. */
+#define SQL_BUSY_TIMEOUT_MS 2000
+
+/* One row of sensor_readings (metric name keys into the sensor registry) */
 typedef struct {
     int id;
-    double value1;
-    double value2;  /* For temp_hum: humidity, temperature. For bme680: temp, humidity */
-    double value3;  /* For bme680: pressure */
-    double value4;  /* For bme680: gas_resistance */
+    char metric[32];
+    double value;
     int64_t timestamp;
-    char table_name[64];  /* Which table this came from */
 } sqlite_reading_t;
 
+/* One queued alert in alert_outbox (delivered oldest first) */
+typedef struct {
+    int64_t id;
+    char type[64];
+    char message[256];
+    char severity[16];
+    char source[32];
+    int64_t timestamp;
+} sqlite_alert_t;
+
+/* Run state of one schedule in schedule_state (survives restarts) */
+typedef struct {
+    char id[SCHEDULE_ID_LEN];
+    char cron_expr[64];
+    int interval_seconds;
+    int64_t last_run;
+    int64_t next_fire;
+    int64_t last_alert;
+} sqlite_schedule_state_t;
+
 int sql_execute(sqlite3 *db, const char *sql);
 int sql_execute_insert(sqlite3 *db, const char *sql, int data, int data2, int timestamp);
-int sql_execute_insert_bme680(sqlite3 *db, double temp, double humidity, double pressure, double gas, int timestamp);
 int sql_execute_insert_double(sqlite3 *db, const char *sql, double data, int timestamp);
+int sql_insert_metric_reading(sqlite3 *db, const char *metric, double value, int timestamp);
 sqlite3 *db_init(const char *db_file);
 int sql_get_unsynced_readings(sqlite3 *db, sqlite_reading_t **readings, int *count);
 int sql_mark_as_synced(sqlite3 *db, const char *table_name, int id);
+int sql_alert_enqueue(sqlite3 *db, const char *type, const char *message, const char *severity,
+                      const char *source, int64_t timestamp);
+int sql_get_queued_alerts(sqlite3 *db, sqlite_alert_t **alerts, int *count, int max);
+int sql_delete_alerts_upto(sqlite3 *db, int64_t last_id);
+int sql_log_interlock(sqlite3 *db, const char *event, int water_hz, int64_t timestamp);
+
+/* Last fetched thresholds, schedules and rules, so automation runs from the first tick offline.
+ * save replaces the whole cache in one transaction; load allocates *out (caller frees). */
+int sql_save_thresholds(sqlite3 *db, const device_threshold_t *rows, int count);
+int sql_load_thresholds(sqlite3 *db, device_threshold_t **out, int *count);
+int sql_save_schedules(sqlite3 *db, const device_schedule_t *rows, int count);
+int sql_load_schedules(sqlite3 *db, device_schedule_t **out, int *count);
+int sql_save_rules(sqlite3 *db, const device_rule_t *rows, int count);
+int sql_load_rules(sqlite3 *db, device_rule_t **out, int *count);
+
+/* Schedule run state: save upserts rows in one transaction, prune drops state
+ * of schedules no longer in schedule_cache, load allocates *out (caller frees) */
+int sql_save_schedule_state(sqlite3 *db, const sqlite_schedule_state_t *rows, int count);
+int sql_load_schedule_state(sqlite3 *db, sqlite_schedule_state_t **out, int *count);
+int sql_prune_schedule_state(sqlite3 *db);
 
 #endif
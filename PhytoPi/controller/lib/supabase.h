@@ -24,6 +24,21 @@ int supabase_init(supabase_config_t *config);
 int supabase_send_batch(supabase_config_t *config, supabase_reading_t *readings, int count);
 int supabase_cleanup(void);
 
+/* Alert for batch delivery */
+typedef struct {
+    const char *type;
+    const char *message;
+    const char *severity;
+    const char *source;  // NULL or "" if none
+    int64_t timestamp;   // Unix time the alert was raised
+} supabase_alert_t;
+
+/* Insert alerts in one POST, keeping their raise time as triggered_at.
+ * Returns 0 on success, -1 on a transport or server error (retry later),
+ * -2 if the request was rejected (4xx, retrying it unchanged will not help). */
+int supabase_insert_alerts(supabase_config_t *config, const char *device_id,
+                           const supabase_alert_t *alerts, int count);
+
 /* Insert a single alert (device_id, type, message, severity, source) */
 int supabase_insert_alert(supabase_config_t *config, const char *device_id,
                           const char *type, const char *message, const char *severity,
@@ -32,12 +47,14 @@ int supabase_insert_alert(supabase_config_t *config, const char *device_id,
 /* device_thresholds - configurable thresholds per metric */
 #define THRESHOLD_METRIC_LEN 32
 #define THRESHOLD_ID_LEN 64
+#define SUPABASE_TS_LEN 40
 typedef struct {
     char id[THRESHOLD_ID_LEN];
     char metric[THRESHOLD_METRIC_LEN];
     double min_value;
     double max_value;
     int enabled;
+    char updated_at[SUPABASE_TS_LEN];
 } device_threshold_t;
 
 /* Fetch device thresholds. Returns count, -1 on error. Caller frees *out. */
@@ -54,11 +71,43 @@ typedef struct {
     int interval_seconds;
     char payload_json[SCHEDULE_PAYLOAD_LEN];
     int enabled;
+    char updated_at[SUPABASE_TS_LEN];
 } device_schedule_t;
 
 /* Fetch enabled schedules. Returns count, -1 on error. Caller frees *out. */
 int supabase_fetch_schedules(supabase_config_t *config, device_schedule_t **out, int *count);
 
+/* automation_rules - local sensor-to-actuator rules */
+#define RULE_ACTUATOR_LEN 16
+typedef struct {
+    char id[THRESHOLD_ID_LEN];
+    char metric[THRESHOLD_METRIC_LEN];
+    int above;          /* comparison: 1 = 'above', 0 = 'below' */
+    double on_value;
+    double off_value;   /* on_value when the row has none */
+    char actuator[RULE_ACTUATOR_LEN]; /* lights, pump, fans */
+    int duty_percent;   /* fans only */
+    int min_on_sec;
+    int min_off_sec;
+    int max_on_sec;     /* 0 = no auto-off */
+    int enabled;
+    char updated_at[SUPABASE_TS_LEN];
+} device_rule_t;
+
+/* Fetch enabled automation rules. Returns count, -1 on error. Caller frees *out. */
+int supabase_fetch_rules(supabase_config_t *config, device_rule_t **out, int *count);
+
+/* Cheap change probe for a per-device config table: newest updated_at and row
+ * count. Equal versions mean the rows have not changed since the last fetch. */
+typedef struct {
+    char updated_at[SUPABASE_TS_LEN];
+    long count;
+} supabase_version_t;
+
+/* Fetch the version of table (device_thresholds, schedules, automation_rules) for this device.
+ * Transfers at most one timestamp. Returns 0 on success, -1 on error. */
+int supabase_fetch_version(supabase_config_t *config, const char *table, supabase_version_t *out);
+
 /* Heartbeat: update device_units.last_seen for offline detection. Returns 0 on success. */
 int supabase_heartbeat(supabase_config_t *config);
 
@@ -0,0 +1,63 @@
+#ifndef THRESHOLDS_H
+#define THRESHOLDS_H
+
+#include <time.h>
+#include "supabase.h"
+
+/*
+ * Compiled device thresholds.
+ * Rows fetched from device_thresholds are resolved once, at fetch time, into
+ * a flat rule array: metric group index, numeric bounds, cooldown, alert type
+ * and local action. Evaluation is then one pass collapsing live metrics into
+ * per-group min/max vectors and one pass comparing every rule against them,
+ * with no string work. Any number of rows may target the same metric; each
+ * keeps its own alert cooldown.
+ */
+
+#define WATER_LEVEL_LOW_HZ_DEFAULT 50 /* low-water cutoff (Hz) if the row has no value */
+#define WATER_ALERT_COOLDOWN 1800     /* 30 min between water-low alerts */
+#define THRESHOLD_ALERT_COOLDOWN 900  /* 15 min between alerts of one threshold row */
+#define THRESHOLD_MAX_HITS 16         /* alerts reported per evaluation, the rest wait a tick */
+
+/* Local actions a rule triggers while exceeded */
+#define THR_ACT_VENTILATE 0x1u
+
+typedef struct {
+    int group;        /* dense index into the per-group value vectors */
+    double min;       /* -INFINITY when unset */
+    double max;       /* INFINITY when unset */
+    unsigned action;  /* THR_ACT_* */
+    int cooldown_sec;
+    time_t last_alert;
+    int water_low;    /* water_level_low: min is the low-frequency cutoff */
+    const char *severity;
+    char alert_type[THRESHOLD_METRIC_LEN + 16];
+    char metric[THRESHOLD_METRIC_LEN];
+    char id[THRESHOLD_ID_LEN];
+} threshold_rule_t;
+
+/* One exceeded rule whose cooldown has elapsed */
+typedef struct {
+    int rule;
+    double value; /* offending reading (lowest below min, highest above max) */
+} threshold_hit_t;
+
+/* Replace the active rules with the enabled rows whose metric is registered.
+ * Cooldowns carry over for rows with the same id. Call after sensors_init().
+ * Returns the number of compiled rules, -1 on allocation failure (old rules kept). */
+int thresholds_compile(const device_threshold_t *rows, int count);
+
+int thresholds_count(void);
+const threshold_rule_t *thresholds_rule(int idx);
+
+/* Compare live sensor values with every rule. ORs the actions of all exceeded
+ * rules into *actions and fills up to max_hits rules that are due an alert.
+ * Returns the number of hits. */
+int thresholds_evaluate(time_t now, unsigned *actions, threshold_hit_t *hits, int max_hits);
+
+/* Start the cooldown of a rule once its alert was handled */
+void thresholds_alerted(int idx, time_t now);
+
+void thresholds_cleanup(void);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <time.h>
+
+/*
+ * Hierarchical timer wheel for the main loop's timed work.
+ * Four levels of 64 one-second slots cover 64^4 s (about 194 days); longer
+ * timers park in the top level and are re-placed as it turns. Adding and
+ * cancelling a timer is O(1) whatever the number armed; each second of
+ * advance touches one slot, plus a slot of a higher level when it cascades.
+ *
+ * Timers are owned by the caller (embedded in its own structs) and must stay
+ * at the same address while pending. The wheel is not thread-safe: use it
+ * from the main loop only.
+ */
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+typedef struct wheel_timer {
+    struct wheel_timer *next;
+    struct wheel_timer **pprev; /* NULL while not pending */
+    time_t expires;
+    void (*fn)(struct wheel_timer *t); /* run on expiry, may re-add; NULL = just expire */
+    void *arg;
+} wheel_timer_t;
+
+/* Start the wheel at 'now' (drops nothing; call once before use) */
+void timer_wheel_init(time_t now);
+
+/* Arm t to expire at 'expires', replacing any pending expiry. A time already
+ * past expires on the next advance. */
+void timer_wheel_add(wheel_timer_t *t, time_t expires);
+
+/* Disarm t; harmless if it is not pending */
+void timer_wheel_cancel(wheel_timer_t *t);
+
+/* 1 if t is armed and has not expired yet */
+int timer_wheel_pending(const wheel_timer_t *t);
+
+/* Expire every timer due at or before 'now', running callbacks in expiry
+ * order. Returns the number expired. A clock that steps back only delays
+ * timers; one that jumps far ahead expires the overdue ones at once. */
+int timer_wheel_advance(time_t now);
+
+/* Earliest pending expiry, 0 if nothing is armed */
+time_t timer_wheel_next_expiry(void);
+
+#endif
@@ -5,6 +5,7 @@ Captures a still image, uploads to Supabase Storage, and creates ai_capture_jobs
 Run from Pi controller when capture_image command is received.
 Usage: capture_and_upload.py <device_id> [supabase_url] [anon_key]
 Environment: SUPABASE_URL, SUPABASE_ANON_KEY, SUPABASE_DEVICE_ID
+The capture/upload helpers are shared with capture_worker.py.
 """
 import os
 import sys
@@ -16,8 +17,8 @@ from pathlib import Path
 try:
     from supabase import create_client, Client
 except ImportError:
-    print("Install: pip install supabase", file=sys.stderr)
-    sys.exit(1)
+    create_client = None
+    Client = None
 
 
 def find_usb_camera():
@@ -87,7 +88,34 @@ def capture_with_usb_camera(out_path: Path) -> bool:
     return r.returncode == 0 and out_path.exists()
 
 
+def capture_frame(out_path: Path) -> bool:
+    """Try the MJPEG stream (camera container on same Docker network), then direct Pi/USB camera access."""
+    return (capture_from_mjpeg_stream(out_path)
+            or capture_with_pi_camera(out_path)
+            or capture_with_usb_camera(out_path))
+
+
+def upload_capture(supabase, device_id: str, ts: int, data: bytes) -> str:
+    """Upload a JPEG to device-images and queue an ai_capture_jobs row. Returns the storage path."""
+    storage_path = f"{device_id}/{ts}.jpg"
+    supabase.storage.from_("device-images").upload(
+        storage_path,
+        data,
+        file_options={"content-type": "image/jpeg"},
+    )
+    supabase.table("ai_capture_jobs").insert({
+        "device_id": device_id,
+        "image_url": storage_path,
+        "status": "pending",
+    }).execute()
+    return storage_path
+
+
 def main():
+    if create_client is None:
+        print("Install: pip install supabase", file=sys.stderr)
+        sys.exit(1)
+
     device_id = sys.argv[1] if len(sys.argv) > 1 else os.environ.get("SUPABASE_DEVICE_ID")
     url = sys.argv[2] if len(sys.argv) > 2 else os.environ.get("SUPABASE_URL")
     # Prefer service role key (bypasses RLS) when available; fall back to anon key
@@ -106,15 +134,7 @@ def main():
     ts = int(time.time())
     out_path = Path(f"/tmp/phytopi_capture_{ts}.jpg")
 
-    # Try MJPEG stream first (camera container on same Docker network),
-    # then fall back to direct Pi/USB camera access
-    if capture_from_mjpeg_stream(out_path):
-        pass  # success
-    elif capture_with_pi_camera(out_path):
-        pass  # success
-    elif capture_with_usb_camera(out_path):
-        pass  # success
-    else:
+    if not capture_frame(out_path):
         print("Capture failed: MJPEG stream, Pi camera, and USB camera (ffmpeg) all unavailable", file=sys.stderr)
         sys.exit(2)
 
@@ -124,21 +144,7 @@ def main():
 
     try:
         supabase: Client = create_client(url, key)
-        storage_path = f"{device_id}/{ts}.jpg"
-
-        with open(out_path, "rb") as f:
-            supabase.storage.from_("device-images").upload(
-                storage_path,
-                f.read(),
-                file_options={"content-type": "image/jpeg"},
-            )
-
-        supabase.table("ai_capture_jobs").insert({
-            "device_id": device_id,
-            "image_url": storage_path,
-            "status": "pending",
-        }).execute()
-
+        storage_path = upload_capture(supabase, device_id, ts, out_path.read_bytes())
         print(f"Uploaded {storage_path}, job created")
     except Exception as e:
         print(f"Upload failed: {e}", file=sys.stderr)
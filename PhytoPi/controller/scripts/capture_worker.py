@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+"""
+PhytoPi Capture Worker
+Long-lived process that keeps the camera and Supabase client warm and serves
+capture requests from the controller over a Unix socket, so a capture_image
+command costs a frame grab plus upload instead of a python3 cold start.
+
+Protocol: one JSON object per line in each direction.
+    -> {"id": "<command id>", "op": "capture", "device_id": "<uuid>"}
+    <- {"id": "<command id>", "ok": true, "storage_path": "...", "capture_ms": 12, "upload_ms": 480}
+    <- {"id": "<command id>", "ok": false, "error": "..."}
+    -> {"id": "x", "op": "ping"}   <- {"id": "x", "ok": true}
+
+Usage:
+    python3 scripts/capture_worker.py [--socket PATH] [--fake-camera] [--dry-run]
+
+Environment:
+    CAPTURE_WORKER_SOCKET   socket path (default /tmp/phytopi_capture.sock)
+    CAPTURE_FAKE_CAMERA=1   serve generated test frames instead of a camera
+    CAPTURE_DRY_RUN=1       write frames to CAPTURE_DRY_RUN_DIR (default /tmp/phytopi_captures)
+                            instead of uploading
+    SUPABASE_URL, SUPABASE_SERVICE_ROLE_KEY (or SUPABASE_ANON_KEY), CAMERA_STREAM_URL
+"""
+import argparse
+import base64
+import io
+import json
+import os
+import socketserver
+import sys
+import threading
+import time
+import urllib.request
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent))
+import capture_and_upload as cau  # noqa: E402
+
+DEFAULT_SOCKET = "/tmp/phytopi_capture.sock"
+
+# 1x1 baseline JPEG used by the fake camera when Pillow is not installed
+FAKE_JPEG = base64.b64decode(
+    "/9j/4AAQSkZJRgABAQEASABIAAD/2wBDAP//////////////////////////////////////////////"
+    "////////////////////////////////////////wgALCAABAAEBAREA/8QAFBABAAAAAAAAAAAAAAAA"
+    "AAAAAP/aAAgBAQABPxA="
+)
+
+
+class FakeCamera:
+    """Generated frames for tests; no hardware or network needed."""
+
+    def __init__(self):
+        self.count = 0
+        try:
+            from PIL import Image, ImageDraw
+            self._pil = (Image, ImageDraw)
+        except ImportError:
+            self._pil = None
+
+    def grab(self) -> bytes:
+        self.count += 1
+        if not self._pil:
+            return FAKE_JPEG
+        Image, ImageDraw = self._pil
+        img = Image.new("RGB", (320, 240), (30, 90 + (self.count * 7) % 120, 40))
+        ImageDraw.Draw(img).text((10, 10), f"PhytoPi fake #{self.count} {time.strftime('%H:%M:%S')}", fill=(255, 255, 255))
+        buf = io.BytesIO()
+        img.save(buf, "JPEG", quality=80)
+        return buf.getvalue()
+
+
+class StreamCamera:
+    """
+    Keeps one connection to the phytopi-camera MJPEG stream open and holds the
+    latest complete frame, so a grab is a memory copy. Reconnects on error.
+    """
+
+    def __init__(self, url: str):
+        self.url = url
+        self.frame = None
+        self.frame_at = 0.0
+        self.cond = threading.Condition()
+        threading.Thread(target=self._run, daemon=True).start()
+
+    def _run(self):
+        while True:
+            try:
+                with urllib.request.urlopen(self.url, timeout=10) as resp:
+                    data = b""
+                    while True:
+                        chunk = resp.read(4096)
+                        if not chunk:
+                            break
+                        data += chunk
+                        start = data.find(b"\xff\xd8")
+                        if start == -1:
+                            data = data[-2:]
+                            continue
+                        end = data.find(b"\xff\xd9", start)
+                        if end == -1:
+                            data = data[start:]
+                            continue
+                        with self.cond:
+                            self.frame = data[start:end + 2]
+                            self.frame_at = time.time()
+                            self.cond.notify_all()
+                        data = data[end + 2:]
+            except Exception as e:
+                print(f"Stream {self.url} unavailable: {e}", file=sys.stderr)
+            time.sleep(2)
+
+    def grab(self, max_age: float = 2.0, wait: float = 5.0):
+        """Return a frame no older than max_age seconds, waiting up to `wait` for one."""
+        deadline = time.time() + wait
+        with self.cond:
+            while self.frame is None or time.time() - self.frame_at > max_age:
+                remaining = deadline - time.time()
+                if remaining <= 0:
+                    return None
+                self.cond.wait(remaining)
+            return self.frame
+
+
+class PiCamera:
+    """Picamera2 kept running between captures; None if the library or camera is missing."""
+
+    def __init__(self):
+        from picamera2 import Picamera2
+        self.cam = Picamera2()
+        self.cam.configure(self.cam.create_still_configuration())
+        self.cam.start()
+
+    def grab(self):
+        buf = io.BytesIO()
+        self.cam.capture_file(buf, format="jpeg")
+        return buf.getvalue()
+
+
+class Worker:
+    def __init__(self, fake_camera: bool, dry_run: bool):
+        self.lock = threading.Lock()  # one capture at a time: single camera
+        self.dry_run = dry_run
+        self.dry_dir = Path(os.environ.get("CAPTURE_DRY_RUN_DIR", "/tmp/phytopi_captures"))
+        self.supabase = None
+        self.sources = []
+
+        if fake_camera:
+            self.sources.append(("fake", FakeCamera().grab))
+        else:
+            self.sources.append(("stream", StreamCamera(
+                os.environ.get("CAMERA_STREAM_URL", "http://phytopi-camera:8000/stream.mjpg")).grab))
+            try:
+                self.sources.append(("picamera2", PiCamera().grab))
+            except Exception as e:
+                print(f"Picamera2 unavailable ({e}), using rpicam/ffmpeg fallback", file=sys.stderr)
+            self.sources.append(("subprocess", self._grab_subprocess))
+
+        if not dry_run:
+            url = os.environ.get("SUPABASE_URL")
+            key = os.environ.get("SUPABASE_SERVICE_ROLE_KEY") or os.environ.get("SUPABASE_ANON_KEY")
+            if cau.create_client is None or not url or not key:
+                raise SystemExit("Supabase client or credentials missing (use --dry-run for local tests)")
+            self.supabase = cau.create_client(url, key)
+
+    @staticmethod
+    def _grab_subprocess():
+        out = Path(f"/tmp/phytopi_worker_{os.getpid()}.jpg")
+        try:
+            if cau.capture_with_pi_camera(out) or cau.capture_with_usb_camera(out):
+                return out.read_bytes()
+            return None
+        finally:
+            out.unlink(missing_ok=True)
+
+    def capture(self, device_id: str) -> dict:
+        with self.lock:
+            t0 = time.monotonic()
+            data, source = None, None
+            for name, grab in self.sources:
+                try:
+                    data = grab()
+                except Exception as e:
+                    print(f"{name} capture failed: {e}", file=sys.stderr)
+                    data = None
+                if data:
+                    source = name
+                    break
+            if not data:
+                return {"ok": False, "error": "no camera source produced a frame"}
+            t1 = time.monotonic()
+
+            ts = int(time.time())
+            if self.dry_run:
+                self.dry_dir.mkdir(parents=True, exist_ok=True)
+                path = self.dry_dir / f"{device_id}_{ts}.jpg"
+                path.write_bytes(data)
+                storage_path = str(path)
+            else:
+                storage_path = cau.upload_capture(self.supabase, device_id, ts, data)
+            t2 = time.monotonic()
+            return {
+                "ok": True,
+                "storage_path": storage_path,
+                "source": source,
+                "capture_ms": int((t1 - t0) * 1000),
+                "upload_ms": int((t2 - t1) * 1000),
+            }
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        for line in self.rfile:
+            try:
+                req = json.loads(line)
+            except ValueError:
+                continue
+            rid = req.get("id")
+            op = req.get("op")
+            if op == "ping":
+                resp = {"ok": True}
+            elif op == "capture" and req.get("device_id"):
+                try:
+                    resp = self.server.worker.capture(req["device_id"])
+                except Exception as e:
+                    resp = {"ok": False, "error": str(e)}
+            else:
+                resp = {"ok": False, "error": f"bad request: {op}"}
+            resp["id"] = rid
+            print(f"{op} {rid}: {resp}", flush=True)
+            self.wfile.write((json.dumps(resp) + "\n").encode())
+            self.wfile.flush()
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+
+def main():
+    ap = argparse.ArgumentParser(description="PhytoPi capture worker")
+    ap.add_argument("--socket", default=os.environ.get("CAPTURE_WORKER_SOCKET", DEFAULT_SOCKET))
+    ap.add_argument("--fake-camera", action="store_true", default=os.environ.get("CAPTURE_FAKE_CAMERA") == "1")
+    ap.add_argument("--dry-run", action="store_true", default=os.environ.get("CAPTURE_DRY_RUN") == "1")
+    args = ap.parse_args()
+
+    worker = Worker(args.fake_camera, args.dry_run)
+    sock = Path(args.socket)
+    sock.unlink(missing_ok=True)
+    server = Server(str(sock), Handler)
+    server.worker = worker
+    os.chmod(sock, 0o660)
+    print(f"Capture worker listening on {sock} (sources: {[n for n, _ in worker.sources]}, "
+          f"dry_run={args.dry_run})", flush=True)
+    try:
+        server.serve_forever()
+    finally:
+        sock.unlink(missing_ok=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""
+PhytoPi Realtime Stand-in
+Minimal local replacement for the Supabase Realtime websocket, for testing the
+controller's command subscription without a Supabase stack. Accepts Phoenix
+joins and heartbeats and pushes a postgres_changes INSERT for device_commands
+to every joined channel when a line is typed on stdin (or every --every
+seconds). The controller still fetches the command itself over REST, so pair
+it with a local PostgREST/Supabase or watch the fetch attempts in its log.
+
+Usage:
+    python3 scripts/realtime_standin.py [--port 4000] [--every SECONDS]
+    SUPABASE_REALTIME_URL=ws://127.0.0.1:4000/socket ./bin/phytopi
+
+Type a command_type (default toggle_light) and Enter to push an INSERT.
+"""
+import argparse
+import base64
+import hashlib
+import json
+import socketserver
+import struct
+import sys
+import threading
+import time
+import uuid
+
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+clients = []
+clients_lock = threading.Lock()
+
+
+def send_frame(wfile, text: str):
+    data = text.encode()
+    header = bytes([0x81])  # FIN + text
+    if len(data) < 126:
+        header += bytes([len(data)])
+    elif len(data) < 65536:
+        header += bytes([126]) + struct.pack("!H", len(data))
+    else:
+        header += bytes([127]) + struct.pack("!Q", len(data))
+    wfile.write(header + data)
+    wfile.flush()
+
+
+def read_frame(rfile):
+    """Return (opcode, payload) or (None, None) on EOF. Client frames are masked."""
+    head = rfile.read(2)
+    if len(head) < 2:
+        return None, None
+    opcode = head[0] & 0x0F
+    length = head[1] & 0x7F
+    if length == 126:
+        length = struct.unpack("!H", rfile.read(2))[0]
+    elif length == 127:
+        length = struct.unpack("!Q", rfile.read(8))[0]
+    mask = rfile.read(4) if head[1] & 0x80 else b"\0\0\0\0"
+    payload = bytearray(rfile.read(length))
+    for i in range(len(payload)):
+        payload[i] ^= mask[i % 4]
+    return opcode, bytes(payload)
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        request = self.rfile.readline().decode(errors="replace").strip()
+        headers = {}
+        for line in iter(self.rfile.readline, b"\r\n"):
+            if not line:
+                return
+            k, _, v = line.decode(errors="replace").partition(":")
+            headers[k.strip().lower()] = v.strip()
+        key = headers.get("sec-websocket-key")
+        if not key:
+            self.wfile.write(b"HTTP/1.1 400 Bad Request\r\n\r\n")
+            return
+        accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+        self.wfile.write(("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          f"Sec-WebSocket-Accept: {accept}\r\n\r\n").encode())
+        self.wfile.flush()
+        print(f"connect {self.client_address or 'local'}: {request}", flush=True)
+
+        self.lock = threading.Lock()
+        self.topics = {}  # topic -> device_id filter value
+        with clients_lock:
+            clients.append(self)
+        try:
+            while True:
+                opcode, payload = read_frame(self.rfile)
+                if opcode is None or opcode == 0x8:
+                    break
+                if opcode == 0x9:  # ping -> pong
+                    with self.lock:
+                        self.wfile.write(bytes([0x8A, len(payload)]) + payload)
+                        self.wfile.flush()
+                    continue
+                if opcode != 0x1:
+                    continue
+                try:
+                    self.on_message(json.loads(payload))
+                except ValueError:
+                    continue
+        finally:
+            with clients_lock:
+                clients.remove(self)
+            print("disconnect", flush=True)
+
+    def send(self, msg: dict):
+        with self.lock:
+            send_frame(self.wfile, json.dumps(msg))
+
+    def on_message(self, msg: dict):
+        topic, event, ref = msg.get("topic"), msg.get("event"), msg.get("ref")
+        reply = {"topic": topic, "event": "phx_reply", "ref": ref, "payload": {"status": "ok", "response": {}}}
+        if event == "phx_join":
+            changes = msg.get("payload", {}).get("config", {}).get("postgres_changes", [])
+            device = next((c.get("filter", "").partition("eq.")[2] for c in changes
+                           if c.get("table") == "device_commands"), "")
+            self.topics[topic] = device
+            reply["payload"]["response"] = {"postgres_changes": [dict(c, id=i + 1) for i, c in enumerate(changes)]}
+            print(f"join {topic} device_id={device or '*'}", flush=True)
+        elif event == "phx_leave":
+            self.topics.pop(topic, None)
+        elif event != "heartbeat":
+            return
+        self.send(reply)
+
+
+def push_insert(command_type: str):
+    with clients_lock:
+        targets = list(clients)
+    sent = 0
+    for c in targets:
+        for topic, device in list(c.topics.items()):
+            record = {
+                "id": str(uuid.uuid4()),
+                "device_id": device,
+                "command_type": command_type,
+                "payload": {},
+                "status": "pending",
+                "created_at": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            }
+            c.send({"topic": topic, "event": "postgres_changes", "ref": None, "payload": {
+                "ids": [1],
+                "data": {"type": "INSERT", "schema": "public", "table": "device_commands",
+                         "commit_timestamp": record["created_at"], "record": record, "errors": None},
+            }})
+            sent += 1
+    print(f"pushed {command_type} to {sent} channel(s)", flush=True)
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Local Supabase Realtime stand-in for device_commands")
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=4000)
+    ap.add_argument("--every", type=float, default=0, help="push an INSERT every N seconds")
+    args = ap.parse_args()
+
+    server = Server((args.host, args.port), Handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print(f"Realtime stand-in on ws://{args.host}:{args.port}/socket", flush=True)
+
+    if args.every > 0:
+        def ticker():
+            while True:
+                time.sleep(args.every)
+                push_insert("toggle_light")
+        threading.Thread(target=ticker, daemon=True).start()
+
+    try:
+        for line in sys.stdin:
+            push_insert(line.strip() or "toggle_light")
+        while True:
+            time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
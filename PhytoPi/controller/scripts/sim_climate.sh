@@ -0,0 +1,37 @@
+#!/bin/bash
+# PhytoPi fan control simulation - run the controller against the simulated
+# plant once per fan mode and print the climate and actuator statistics.
+# Usage: ./sim_climate.sh [virtual_seconds] [temp_setpoint]
+# Builds with SIM=1 (the simulator replaces all hardware) in a temporary copy of
+# the sources, so an existing Pi build in this tree is left alone. Supabase is not used.
+
+set -e
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+DURATION="${1:-14400}"
+SETPOINT="${2:-24}"
+WORK_DIR="$(mktemp -d /tmp/phytopi_sim_climate.XXXXXX)"
+
+mkdir -p "$WORK_DIR/build"
+cp -r "$PROJECT_ROOT/Makefile" "$PROJECT_ROOT/lib" "$PROJECT_ROOT/src" "$WORK_DIR/build/"
+find "$WORK_DIR/build" -name '*.o' -delete
+make -C "$WORK_DIR/build" SIM=1 > /dev/null
+SIM_BIN="$WORK_DIR/build/bin/phytopi"
+
+# Warm room on a 2-hour cycle so the fans have something to regulate
+export SIM_SPEED=0
+export SIM_DURATION="$DURATION"
+export SIM_WAVE_TEMP="${SIM_WAVE_TEMP:-25:2:7200:0.15}"
+unset SUPABASE_URL SUPABASE_ANON_KEY SUPABASE_DEVICE_ID
+
+for MODE in off hysteresis pid; do
+    echo "== PHYTOPI_FAN_MODE=$MODE, temp setpoint $SETPOINT C, $DURATION virtual s"
+    PHYTOPI_DB_PATH="$WORK_DIR/$MODE.db" \
+    PHYTOPI_FAN_MODE="$MODE" \
+    PHYTOPI_FAN_TEMP_SETPOINT="$SETPOINT" \
+        "$SIM_BIN" > "$WORK_DIR/$MODE.log" 2>&1
+    # Final report only (the hourly ones repeat it)
+    tail -n 8 "$WORK_DIR/$MODE.log" | grep -E "^(Fan control|Sim):" || true
+done
+
+echo "Logs: $WORK_DIR"
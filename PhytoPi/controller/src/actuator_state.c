@@ -0,0 +1,39 @@
+/**
+ * Coalesced device_actuator_state publishing for PhytoPi
+ */
+#include "../lib/actuator_state.h"
+
+static int current[ASTATE_COUNT];
+static int published[ASTATE_COUNT] = {-1, -1, -1, -1, -1}; /* -1 = never acknowledged */
+static unsigned int dirty = 0;
+
+void actuator_state_mark(actuator_state_field_t field, int value)
+{
+    if (field < 0 || field >= ASTATE_COUNT || value < 0)
+        return;
+    current[field] = value;
+    if (value != published[field])
+        dirty |= 1u << field;
+    else
+        dirty &= ~(1u << field); /* toggled back before the flush */
+}
+
+int actuator_state_flush(supabase_config_t *cfg)
+{
+    if (!dirty)
+        return 0;
+
+    int v[ASTATE_COUNT];
+    for (int f = 0; f < ASTATE_COUNT; f++)
+        v[f] = (dirty & (1u << f)) ? current[f] : -1;
+
+    if (supabase_update_actuator_state(cfg, v[ASTATE_LIGHTS], v[ASTATE_PUMP], v[ASTATE_FAN_DUTY],
+                                       v[ASTATE_BME_OK], v[ASTATE_SOIL_OK]) != 0)
+        return -1;
+
+    for (int f = 0; f < ASTATE_COUNT; f++)
+        if (v[f] >= 0)
+            published[f] = v[f];
+    dirty = 0;
+    return 0;
+}
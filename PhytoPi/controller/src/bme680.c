@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <time.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
 
@@ -19,6 +20,9 @@
 static int           i2c_fd         = -1;
 static struct bme68x_dev bme_dev;
 static int           bme_initialized = 0;
+static int           bme_triggered  = 0;
+static struct timespec bme_trigger_ts;
+static uint32_t      bme_meas_dur_us = 0;
 
 /* ── Bosch API I2C callbacks ── */
 
@@ -124,9 +128,17 @@ int bme680_init(void)
 
 int bme680_read(bme680_data_t *data)
 {
-    if (!data) return -1;
-    memset(data, 0, sizeof(*data));
+    if (bme680_trigger() != 0)
+    {
+        if (data) memset(data, 0, sizeof(*data));
+        return -1;
+    }
+    return bme680_collect(data);
+}
 
+int bme680_trigger(void)
+{
+    bme_triggered = 0;
     if (!bme_initialized || i2c_fd < 0) return -1;
 
     struct bme68x_conf conf;
@@ -134,8 +146,27 @@ int bme680_read(bme680_data_t *data)
 
     if (bme68x_set_op_mode(BME68X_FORCED_MODE, &bme_dev) != BME68X_OK) return -1;
 
-    uint32_t del_period = bme68x_get_meas_dur(BME68X_FORCED_MODE, &conf, &bme_dev);
-    bme_dev.delay_us(del_period, bme_dev.intf_ptr);
+    bme_meas_dur_us = bme68x_get_meas_dur(BME68X_FORCED_MODE, &conf, &bme_dev);
+    clock_gettime(CLOCK_MONOTONIC, &bme_trigger_ts);
+    bme_triggered = 1;
+    return 0;
+}
+
+int bme680_collect(bme680_data_t *data)
+{
+    if (!data) return -1;
+    memset(data, 0, sizeof(*data));
+
+    if (!bme_initialized || i2c_fd < 0 || !bme_triggered) return -1;
+    bme_triggered = 0;
+
+    /* Wait out the rest of the conversion started by bme680_trigger() */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed_us = (now.tv_sec - bme_trigger_ts.tv_sec) * 1000000L +
+                      (now.tv_nsec - bme_trigger_ts.tv_nsec) / 1000L;
+    if (elapsed_us < (long)bme_meas_dur_us)
+        bme_dev.delay_us((uint32_t)(bme_meas_dur_us - elapsed_us), bme_dev.intf_ptr);
 
     struct bme68x_data bme_data;
     uint8_t n_fields;
@@ -167,4 +198,5 @@ void bme680_cleanup(void)
         i2c_fd = -1;
     }
     bme_initialized = 0;
+    bme_triggered = 0;
 }
\ No newline at end of file
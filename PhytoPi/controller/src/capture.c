@@ -0,0 +1,447 @@
+/**
+ * Asynchronous capture job supervision for PhytoPi
+ * capture_image commands go to the persistent capture worker over a Unix
+ * socket when it is reachable, otherwise they run the capture script as a
+ * child process watched through a pidfd. Either way the main loop keeps
+ * sampling and actuating while the camera works.
+ */
+#include "../lib/capture.h"
+
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define CAPTURE_FALLBACK_POLL_MS 200 /* reap interval when pidfd_open is unavailable (< 5.3 kernels) */
+#define CAPTURE_WORKER_SOCKET_DEFAULT "/tmp/phytopi_capture.sock"
+#define CAPTURE_WORKER_RESPAWN 30    /* min seconds between worker autostarts */
+#define CAPTURE_WORKER_RX_LEN 2048
+
+typedef struct {
+    char command_id[CMD_ID_LEN];
+    int active;
+    int via_worker; /* 1 = request sent to the worker, no child process */
+    pid_t pid;
+    int pidfd;      /* -1 = reaped by waitpid polling only */
+    time_t started;
+    time_t term_at; /* when SIGTERM was sent, 0 = not yet */
+} capture_job_t;
+
+static capture_job_t jobs[CAPTURE_MAX_JOBS];
+static int job_count = 0;
+static capture_done_fn done_cb = NULL;
+static void *done_ctx = NULL;
+static int timeout_sec = CAPTURE_TIMEOUT_DEFAULT;
+
+/* Persistent worker connection */
+static int worker_fd = -1;
+static pid_t worker_pid = 0;    /* autostarted worker, 0 = none */
+static time_t worker_spawned_at = 0;
+static char worker_rx[CAPTURE_WORKER_RX_LEN];
+static size_t worker_rx_len = 0;
+
+static time_t mono_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static const char *worker_socket_path(void)
+{
+    const char *path = getenv("CAPTURE_WORKER_SOCKET");
+    return (path && path[0]) ? path : CAPTURE_WORKER_SOCKET_DEFAULT;
+}
+
+void capture_init(capture_done_fn on_done, void *ctx)
+{
+    done_cb = on_done;
+    done_ctx = ctx;
+    const char *env = getenv("CAPTURE_TIMEOUT_SEC");
+    if (env && atoi(env) > 0)
+        timeout_sec = atoi(env);
+    memset(jobs, 0, sizeof(jobs));
+    job_count = 0;
+}
+
+static void finish_job(capture_job_t *job, int ok)
+{
+    if (job->pidfd >= 0)
+        close(job->pidfd);
+    char command_id[CMD_ID_LEN];
+    snprintf(command_id, sizeof(command_id), "%s", job->command_id);
+    memset(job, 0, sizeof(*job));
+    job_count--;
+    if (done_cb)
+        done_cb(command_id, ok, done_ctx);
+}
+
+static capture_job_t *alloc_job(const char *command_id)
+{
+    for (int i = 0; i < CAPTURE_MAX_JOBS; i++)
+        if (!jobs[i].active)
+        {
+            capture_job_t *job = &jobs[i];
+            memset(job, 0, sizeof(*job));
+            snprintf(job->command_id, sizeof(job->command_id), "%s", command_id);
+            job->active = 1;
+            job->pidfd = -1;
+            job->started = mono_sec();
+            job_count++;
+            return job;
+        }
+    return NULL;
+}
+
+/*
+ * -------------------------------
+ * PERSISTENT WORKER (scripts/capture_worker.py)
+ *-------------------------------
+ */
+static void worker_disconnect(void)
+{
+    if (worker_fd >= 0)
+        close(worker_fd);
+    worker_fd = -1;
+    worker_rx_len = 0;
+    /* Requests in flight on the old connection will never be answered */
+    for (int i = 0; i < CAPTURE_MAX_JOBS; i++)
+        if (jobs[i].active && jobs[i].via_worker)
+            finish_job(&jobs[i], 0);
+}
+
+/*
+ * Helper: start the worker in the background unless CAPTURE_WORKER_AUTOSTART=0.
+ * It needs a moment to bind, so the request that triggered this uses the script.
+ */
+static void worker_autostart(void)
+{
+    const char *autostart = getenv("CAPTURE_WORKER_AUTOSTART");
+    if (autostart && strcmp(autostart, "0") == 0)
+        return;
+    if (worker_pid > 0 || (worker_spawned_at && mono_sec() - worker_spawned_at < CAPTURE_WORKER_RESPAWN))
+        return;
+    const char *script = getenv("CAPTURE_WORKER_PATH");
+    if (!script)
+        script = "scripts/capture_worker.py";
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return;
+    if (pid == 0)
+    {
+        setpgid(0, 0);
+        execl("/usr/bin/python3", "python3", script, "--socket", worker_socket_path(), (char *)NULL);
+        _exit(127);
+    }
+    worker_pid = pid;
+    worker_spawned_at = mono_sec();
+    printf("  -> capture worker started (pid %d)\n", (int)pid);
+}
+
+static int worker_connect(void)
+{
+    if (worker_fd >= 0)
+        return 0;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", worker_socket_path());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        worker_autostart();
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    worker_fd = fd;
+    worker_rx_len = 0;
+    printf("  -> connected to capture worker at %s\n", addr.sun_path);
+    return 0;
+}
+
+static int worker_send(const char *command_id, const char *device_id)
+{
+    json_object *req = json_object_new_object();
+    json_object_object_add(req, "id", json_object_new_string(command_id));
+    json_object_object_add(req, "op", json_object_new_string("capture"));
+    json_object_object_add(req, "device_id", json_object_new_string(device_id));
+    char line[512];
+    int len = snprintf(line, sizeof(line), "%s\n", json_object_to_json_string_ext(req, JSON_C_TO_STRING_PLAIN));
+    json_object_put(req);
+    if (len <= 0 || len >= (int)sizeof(line))
+        return -1;
+    /* One short line always fits in an idle socket buffer */
+    if (send(worker_fd, line, len, MSG_NOSIGNAL) != len)
+    {
+        fprintf(stderr, "capture: worker send failed: %s\n", strerror(errno));
+        worker_disconnect();
+        return -1;
+    }
+    return 0;
+}
+
+static void worker_handle_line(const char *line)
+{
+    json_object *resp = json_tokener_parse(line);
+    if (!resp)
+        return;
+    json_object *id = NULL, *ok = NULL, *err = NULL, *path = NULL;
+    json_object_object_get_ex(resp, "id", &id);
+    json_object_object_get_ex(resp, "ok", &ok);
+    const char *id_str = id ? json_object_get_string(id) : NULL;
+    int success = ok ? json_object_get_boolean(ok) : 0;
+
+    for (int i = 0; id_str && i < CAPTURE_MAX_JOBS; i++)
+    {
+        if (!jobs[i].active || !jobs[i].via_worker || strcmp(jobs[i].command_id, id_str) != 0)
+            continue;
+        if (success && json_object_object_get_ex(resp, "storage_path", &path))
+            printf("  -> capture %s uploaded %s\n", id_str, json_object_get_string(path));
+        else if (!success && json_object_object_get_ex(resp, "error", &err))
+            fprintf(stderr, "capture: worker failed %s: %s\n", id_str, json_object_get_string(err));
+        finish_job(&jobs[i], success);
+        break;
+    }
+    json_object_put(resp);
+}
+
+static void worker_read(void)
+{
+    while (worker_fd >= 0)
+    {
+        ssize_t n = read(worker_fd, worker_rx + worker_rx_len, sizeof(worker_rx) - 1 - worker_rx_len);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+        if (n <= 0)
+        {
+            fprintf(stderr, "capture: worker connection closed\n");
+            worker_disconnect();
+            return;
+        }
+        worker_rx_len += (size_t)n;
+        worker_rx[worker_rx_len] = '\0';
+
+        char *start = worker_rx;
+        char *nl;
+        while ((nl = strchr(start, '\n')) != NULL)
+        {
+            *nl = '\0';
+            worker_handle_line(start);
+            start = nl + 1;
+        }
+        worker_rx_len -= (size_t)(start - worker_rx);
+        memmove(worker_rx, start, worker_rx_len);
+        if (worker_rx_len >= sizeof(worker_rx) - 1)
+            worker_rx_len = 0; /* oversized line, drop it */
+    }
+}
+
+/*
+ * -------------------------------
+ * ONE-SHOT SCRIPT FALLBACK
+ *-------------------------------
+ */
+static int spawn_script(capture_job_t *job, const char *device_id)
+{
+    const char *script = getenv("CAPTURE_SCRIPT_PATH");
+    if (!script)
+        script = "scripts/capture_and_upload.py";
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "capture: fork failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (pid == 0)
+    {
+        /* Own process group so a timeout also kills ffmpeg/rpicam children */
+        setpgid(0, 0);
+        execl("/usr/bin/python3", "python3", script, device_id, (char *)NULL);
+        _exit(127);
+    }
+    setpgid(pid, pid);
+    job->pid = pid;
+    job->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    printf("  -> capture started (pid %d, timeout %ds)\n", (int)pid, timeout_sec);
+    return 0;
+}
+
+int capture_start(const char *command_id, const char *device_id)
+{
+    if (!command_id || !device_id)
+        return -1;
+    capture_job_t *job = alloc_job(command_id);
+    if (!job)
+    {
+        fprintf(stderr, "capture: %d jobs already running, rejecting %s\n", CAPTURE_MAX_JOBS, command_id);
+        return -1;
+    }
+
+    if (worker_connect() == 0 && worker_send(command_id, device_id) == 0)
+    {
+        job->via_worker = 1;
+        printf("  -> capture %s sent to worker\n", command_id);
+        return 0;
+    }
+    if (spawn_script(job, device_id) == 0)
+        return 0;
+
+    memset(job, 0, sizeof(*job));
+    job_count--;
+    return -1;
+}
+
+int capture_active(void)
+{
+    return job_count;
+}
+
+/*
+ * Helper: worker jobs fail past the timeout; child jobs get SIGTERM, then SIGKILL
+ * after the grace period. Returns ms until this job's next step, -1 if none pending.
+ */
+static int enforce_timeout(capture_job_t *job, time_t now)
+{
+    if (job->via_worker)
+    {
+        if (now - job->started >= timeout_sec)
+        {
+            /* A worker that stops answering is dropped and reconnected on the next capture */
+            fprintf(stderr, "capture: worker did not answer %s within %ds\n", job->command_id, timeout_sec);
+            worker_disconnect();
+            return -1;
+        }
+        return (int)(job->started + timeout_sec - now) * 1000;
+    }
+    if (!job->term_at)
+    {
+        if (now - job->started >= timeout_sec)
+        {
+            fprintf(stderr, "capture: pid %d timed out after %ds, terminating\n", (int)job->pid, timeout_sec);
+            kill(-job->pid, SIGTERM);
+            job->term_at = now;
+            return CAPTURE_KILL_GRACE * 1000;
+        }
+        return (int)(job->started + timeout_sec - now) * 1000;
+    }
+    if (now - job->term_at >= CAPTURE_KILL_GRACE)
+    {
+        kill(-job->pid, SIGKILL);
+        return -1;
+    }
+    return (int)(job->term_at + CAPTURE_KILL_GRACE - now) * 1000;
+}
+
+void capture_poll(int timeout_ms)
+{
+    /* Reap an autostarted worker that exited so it can be restarted */
+    if (worker_pid > 0 && waitpid(worker_pid, NULL, WNOHANG) == worker_pid)
+    {
+        fprintf(stderr, "capture: worker pid %d exited\n", (int)worker_pid);
+        worker_pid = 0;
+    }
+    if (job_count == 0)
+        return;
+
+    struct pollfd pfd[CAPTURE_MAX_JOBS + 1];
+    int n = 0, need_fallback = 0, worker_jobs = 0;
+    time_t now = mono_sec();
+    for (int i = 0; i < CAPTURE_MAX_JOBS; i++)
+    {
+        if (!jobs[i].active)
+            continue;
+        int next_in = enforce_timeout(&jobs[i], now);
+        if (next_in >= 0 && next_in < timeout_ms)
+            timeout_ms = next_in;
+        if (!jobs[i].active)
+            continue;
+        if (jobs[i].via_worker)
+            worker_jobs++;
+        else if (jobs[i].pidfd >= 0)
+        {
+            pfd[n].fd = jobs[i].pidfd;
+            pfd[n].events = POLLIN;
+            n++;
+        }
+        else
+            need_fallback = 1;
+    }
+    if (worker_jobs && worker_fd >= 0)
+    {
+        pfd[n].fd = worker_fd;
+        pfd[n].events = POLLIN;
+        n++;
+    }
+    if (need_fallback && timeout_ms > CAPTURE_FALLBACK_POLL_MS)
+        timeout_ms = CAPTURE_FALLBACK_POLL_MS;
+
+    if (timeout_ms > 0 && job_count > 0)
+    {
+        if (n > 0)
+            poll(pfd, n, timeout_ms);
+        else
+            usleep((useconds_t)timeout_ms * 1000);
+    }
+
+    if (worker_jobs && worker_fd >= 0)
+        worker_read();
+
+    /* A readable pidfd means exited; waitpid(WNOHANG) covers both paths */
+    for (int i = 0; i < CAPTURE_MAX_JOBS; i++)
+    {
+        if (!jobs[i].active || jobs[i].via_worker)
+            continue;
+        int status = 0;
+        pid_t r = waitpid(jobs[i].pid, &status, WNOHANG);
+        if (r == jobs[i].pid)
+        {
+            if (WIFSIGNALED(status))
+                printf("  -> capture pid %d killed by signal %d\n", (int)jobs[i].pid, WTERMSIG(status));
+            else
+                printf("  -> capture pid %d exited with %d\n", (int)jobs[i].pid, WEXITSTATUS(status));
+            finish_job(&jobs[i], WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+        else if (r < 0 && errno == ECHILD)
+            finish_job(&jobs[i], 0); /* lost track of the child */
+    }
+}
+
+void capture_cleanup(void)
+{
+    for (int i = 0; i < CAPTURE_MAX_JOBS; i++)
+    {
+        if (!jobs[i].active || jobs[i].via_worker)
+            continue;
+        kill(-jobs[i].pid, SIGKILL);
+        waitpid(jobs[i].pid, NULL, 0);
+        finish_job(&jobs[i], 0);
+    }
+    worker_disconnect();
+    if (worker_pid > 0)
+    {
+        kill(-worker_pid, SIGTERM);
+        waitpid(worker_pid, NULL, 0);
+        worker_pid = 0;
+    }
+}
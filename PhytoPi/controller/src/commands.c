@@ -2,6 +2,7 @@
 #include <curl/curl.h>
 #include <json-c/json.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
@@ -27,6 +28,129 @@ static size_t write_memory_callback(void *contents, size_t size, size_t nmemb, v
     return realsize;
 }
 
+/* Handler table: open addressing on the FNV-1a hash of command_type */
+static command_handler_t handlers[COMMAND_TABLE_SIZE];
+static int handler_count = 0;
+
+static unsigned int type_hash(const char *type)
+{
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)type; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int command_register(const char *type, command_decode_fn decode, command_run_fn run)
+{
+    if (!type || !run || handler_count >= COMMAND_TABLE_SIZE - 1)
+        return -1;
+    unsigned int h = type_hash(type);
+    unsigned int i = h & (COMMAND_TABLE_SIZE - 1);
+    while (handlers[i].type)
+    {
+        if (handlers[i].hash == h && strcmp(handlers[i].type, type) == 0)
+            return -1;
+        i = (i + 1) & (COMMAND_TABLE_SIZE - 1);
+    }
+    handlers[i].type = type;
+    handlers[i].hash = h;
+    handlers[i].decode = decode;
+    handlers[i].run = run;
+    handler_count++;
+    return 0;
+}
+
+const command_handler_t *command_lookup(const char *type)
+{
+    if (!type)
+        return NULL;
+    unsigned int h = type_hash(type);
+    unsigned int i = h & (COMMAND_TABLE_SIZE - 1);
+    while (handlers[i].type)
+    {
+        if (handlers[i].hash == h && strcmp(handlers[i].type, type) == 0)
+            return &handlers[i];
+        i = (i + 1) & (COMMAND_TABLE_SIZE - 1);
+    }
+    return NULL;
+}
+
+command_result_t command_dispatch(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    if (!cmd->handler)
+    {
+        snprintf(err, err_len, "%s", cmd->error[0] ? cmd->error : "unknown command_type");
+        return CMD_FAILED;
+    }
+    err[0] = '\0';
+    command_result_t r = cmd->handler->run(cmd, ctx, err, err_len);
+    if (r == CMD_FAILED && !err[0])
+        snprintf(err, err_len, "%s failed", cmd->command_type);
+    return r;
+}
+
+/*
+ * Helper: read an optional integer field into *out, checking type and range.
+ * A missing field keeps the default already in *out.
+ */
+static int get_int_field(json_object *payload, const char *key, int min, int max, int *out, char *err, size_t err_len)
+{
+    json_object *v = NULL;
+    if (!payload || !json_object_object_get_ex(payload, key, &v) || json_object_is_type(v, json_type_null))
+        return 0;
+    if (!json_object_is_type(v, json_type_int))
+    {
+        snprintf(err, err_len, "%s must be an integer", key);
+        return -1;
+    }
+    int64_t n = json_object_get_int64(v);
+    if (n < min || n > max)
+    {
+        snprintf(err, err_len, "%s must be between %d and %d", key, min, max);
+        return -1;
+    }
+    *out = (int)n;
+    return 0;
+}
+
+int command_decode_switch(json_object *payload, command_args_t *args, char *err, size_t err_len)
+{
+    args->sw.state = 0;
+    args->sw.duration_sec = 0;
+    json_object *s = NULL;
+    if (payload && json_object_object_get_ex(payload, "state", &s))
+    {
+        if (!json_object_is_type(s, json_type_boolean) && !json_object_is_type(s, json_type_int))
+        {
+            snprintf(err, err_len, "state must be a boolean");
+            return -1;
+        }
+        args->sw.state = json_object_get_boolean(s) ? 1 : 0;
+    }
+    return get_int_field(payload, "duration_sec", 0, COMMAND_MAX_DURATION_SEC, &args->sw.duration_sec, err, err_len);
+}
+
+int command_decode_ventilation(json_object *payload, command_args_t *args, char *err, size_t err_len)
+{
+    args->vent.duration_sec = 300;
+    args->vent.duty_percent = 0; /* 0 = caller's default duty */
+    if (get_int_field(payload, "duration_sec", 1, COMMAND_MAX_DURATION_SEC, &args->vent.duration_sec, err, err_len) != 0)
+        return -1;
+    return get_int_field(payload, "duty_percent", 0, 100, &args->vent.duty_percent, err, err_len);
+}
+
+int command_decode_fan_speed(json_object *payload, command_args_t *args, char *err, size_t err_len)
+{
+    args->fan.fan_id = 1;
+    args->fan.duty_percent = 0;
+    if (get_int_field(payload, "fan_id", 1, 2, &args->fan.fan_id, err, err_len) != 0)
+        return -1;
+    return get_int_field(payload, "duty_percent", 0, 100, &args->fan.duty_percent, err, err_len);
+}
+
 int fetch_next_light_command(const supabase_config_t *cfg, int *desired_state, char *command_id_buf, int command_id_buf_len)
 {
     if (!cfg || !cfg->api_url || !cfg->api_key || !cfg->device_id || !desired_state || !command_id_buf || command_id_buf_len <= 0)
@@ -143,20 +267,17 @@ int fetch_next_light_command(const supabase_config_t *cfg, int *desired_state, c
     return 1;
 }
 
-int fetch_next_command(const supabase_config_t *cfg, device_command_t *cmd)
+/*
+ * Helper: GET a device_commands query and return the parsed JSON array.
+ * Returns 0 on success (*out may be NULL when the body is empty), -1 on error.
+ */
+static int get_commands_json(const supabase_config_t *cfg, const char *url, json_object **out)
 {
-    if (!cfg || !cfg->api_url || !cfg->api_key || !cfg->device_id || !cmd)
-        return -1;
-
+    *out = NULL;
     CURL *curl = curl_easy_init();
     if (!curl)
         return -1;
 
-    char url[512];
-    snprintf(url, sizeof(url),
-             "%s/rest/v1/device_commands?device_id=eq.%s&status=eq.pending&order=created_at.asc&limit=1",
-             cfg->api_url, cfg->device_id);
-
     struct curl_slist *headers = NULL;
     char apikey_header[256];
     char auth_header[256];
@@ -192,55 +313,147 @@ int fetch_next_command(const supabase_config_t *cfg, device_command_t *cmd)
 
     json_object *root = json_tokener_parse(chunk.data);
     free(chunk.data);
-    if (!root || !json_object_is_type(root, json_type_array))
+    if (root && !json_object_is_type(root, json_type_array))
     {
-        if (root) json_object_put(root);
+        json_object_put(root);
+        root = NULL;
+    }
+    *out = root;
+    return 0;
+}
+
+/*
+ * Helper: copy one device_commands row into cmd and decode its payload with the
+ * registered handler. Returns -1 only if the row itself is malformed; an
+ * unknown type or invalid payload leaves cmd->handler NULL with cmd->error set.
+ */
+static int parse_command(json_object *c, device_command_t *cmd)
+{
+    json_object *id_obj = NULL, *type_obj = NULL, *payload_obj = NULL;
+    if (!json_object_object_get_ex(c, "id", &id_obj) || !json_object_object_get_ex(c, "command_type", &type_obj))
+        return -1;
+    json_object_object_get_ex(c, "payload", &payload_obj);
+
+    const char *id_str = json_object_get_string(id_obj);
+    const char *type_str = json_object_get_string(type_obj);
+    if (!id_str || !type_str)
+        return -1;
+
+    snprintf(cmd->id, sizeof(cmd->id), "%s", id_str);
+    snprintf(cmd->command_type, sizeof(cmd->command_type), "%s", type_str);
+    cmd->handler = NULL;
+    cmd->error[0] = '\0';
+    memset(&cmd->args, 0, sizeof(cmd->args));
+
+    const command_handler_t *h = command_lookup(type_str);
+    if (!h)
+    {
+        snprintf(cmd->error, sizeof(cmd->error), "unknown command_type '%s'", type_str);
         return 0;
     }
-    if (json_object_array_length(root) == 0)
+    if (payload_obj && !json_object_is_type(payload_obj, json_type_object) &&
+        !json_object_is_type(payload_obj, json_type_null))
     {
-        json_object_put(root);
+        snprintf(cmd->error, sizeof(cmd->error), "payload must be a JSON object");
         return 0;
     }
+    if (h->decode && h->decode(payload_obj, &cmd->args, cmd->error, sizeof(cmd->error)) != 0)
+    {
+        if (!cmd->error[0])
+            snprintf(cmd->error, sizeof(cmd->error), "invalid payload");
+        return 0;
+    }
+    cmd->handler = h;
+    return 0;
+}
 
-    json_object *c = json_object_array_get_idx(root, 0);
-    json_object *id_obj = NULL, *type_obj = NULL, *payload_obj = NULL;
-    if (!json_object_object_get_ex(c, "id", &id_obj) || !json_object_object_get_ex(c, "command_type", &type_obj) ||
-        !json_object_object_get_ex(c, "payload", &payload_obj))
+int fetch_next_command(const supabase_config_t *cfg, device_command_t *cmd)
+{
+    if (!cfg || !cfg->api_url || !cfg->api_key || !cfg->device_id || !cmd)
+        return -1;
+
+    char url[512];
+    snprintf(url, sizeof(url),
+             "%s/rest/v1/device_commands?device_id=eq.%s&status=eq.pending&order=created_at.asc&limit=1",
+             cfg->api_url, cfg->device_id);
+
+    json_object *root = NULL;
+    if (get_commands_json(cfg, url, &root) != 0)
+        return -1;
+    if (!root || json_object_array_length(root) == 0)
     {
-        json_object_put(root);
+        if (root) json_object_put(root);
+        return 0;
+    }
+
+    int ret = (parse_command(json_object_array_get_idx(root, 0), cmd) == 0) ? 1 : -1;
+    json_object_put(root);
+    return ret;
+}
+
+int fetch_pending_commands(const supabase_config_t *cfg, device_command_t **cmds, int *count)
+{
+    if (!cfg || !cfg->api_url || !cfg->api_key || !cfg->device_id || !cmds || !count)
         return -1;
+    *cmds = NULL;
+    *count = 0;
+
+    char url[512];
+    snprintf(url, sizeof(url),
+             "%s/rest/v1/device_commands?device_id=eq.%s&status=eq.pending&order=created_at.asc&limit=%d"
+             "&select=id,command_type,payload",
+             cfg->api_url, cfg->device_id, COMMAND_FETCH_MAX);
+
+    json_object *root = NULL;
+    if (get_commands_json(cfg, url, &root) != 0)
+        return -1;
+    int n = root ? (int)json_object_array_length(root) : 0;
+    if (n == 0)
+    {
+        if (root) json_object_put(root);
+        return 0;
     }
 
-    const char *id_str = json_object_get_string(id_obj);
-    const char *type_str = json_object_get_string(type_obj);
-    const char *payload_str = json_object_to_json_string(payload_obj);
-    if (!id_str || !type_str || !payload_str)
+    device_command_t *out = (device_command_t *)calloc((size_t)n, sizeof(device_command_t));
+    if (!out)
     {
         json_object_put(root);
         return -1;
     }
-
-    snprintf(cmd->id, sizeof(cmd->id), "%s", id_str);
-    snprintf(cmd->command_type, sizeof(cmd->command_type), "%s", type_str);
-    snprintf(cmd->payload_json, sizeof(cmd->payload_json), "%s", payload_str);
+    int parsed = 0;
+    for (int i = 0; i < n; i++)
+        if (parse_command(json_object_array_get_idx(root, i), &out[parsed]) == 0)
+            parsed++;
     json_object_put(root);
-    return 1;
+
+    *cmds = out;
+    *count = parsed;
+    return parsed;
 }
 
-int mark_command_processed(const supabase_config_t *cfg, const char *command_id, const char *status)
+/*
+ * Helper: PATCH the status of every command matching filter (a PostgREST
+ * condition such as "id=eq.<uuid>" or "id=in.(<uuid>,<uuid>)"),
+ * stamping executed_at for final states and recording error when given.
+ */
+static int patch_command_status(const supabase_config_t *cfg, const char *filter, const char *status,
+                                int set_executed_at, const char *error)
 {
-    if (!cfg || !cfg->api_url || !cfg->api_key || !command_id || !status)
+    if (!cfg || !cfg->api_url || !cfg->api_key || !filter || !status)
         return -1;
 
+    size_t url_len = strlen(cfg->api_url) + strlen(filter) + 64;
+    char *url = (char *)malloc(url_len);
+    if (!url)
+        return -1;
+    snprintf(url, url_len, "%s/rest/v1/device_commands?%s", cfg->api_url, filter);
+
     CURL *curl = curl_easy_init();
     if (!curl)
+    {
+        free(url);
         return -1;
-
-    char url[512];
-    snprintf(url, sizeof(url),
-             "%s/rest/v1/device_commands?id=eq.%s",
-             cfg->api_url, command_id);
+    }
 
     struct curl_slist *headers = NULL;
     char apikey_header[256];
@@ -252,15 +465,19 @@ int mark_command_processed(const supabase_config_t *cfg, const char *command_id,
     headers = curl_slist_append(headers, "Content-Type: application/json");
     headers = curl_slist_append(headers, "Prefer: return=minimal");
 
-    time_t now_sec = time(NULL);
-    struct tm tm_buf;
-    gmtime_r(&now_sec, &tm_buf);
-    char iso_buf[32];
-    strftime(iso_buf, sizeof(iso_buf), "%Y-%m-%dT%H:%M:%SZ", &tm_buf);
-
     json_object *body = json_object_new_object();
     json_object_object_add(body, "status", json_object_new_string(status));
-    json_object_object_add(body, "executed_at", json_object_new_string(iso_buf));
+    if (set_executed_at)
+    {
+        time_t now_sec = time(NULL);
+        struct tm tm_buf;
+        gmtime_r(&now_sec, &tm_buf);
+        char iso_buf[32];
+        strftime(iso_buf, sizeof(iso_buf), "%Y-%m-%dT%H:%M:%SZ", &tm_buf);
+        json_object_object_add(body, "executed_at", json_object_new_string(iso_buf));
+    }
+    if (error)
+        json_object_object_add(body, "error", json_object_new_string(error));
 
     const char *body_str = json_object_to_json_string(body);
 
@@ -277,6 +494,7 @@ int mark_command_processed(const supabase_config_t *cfg, const char *command_id,
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
     json_object_put(body);
+    free(url);
 
     if (res != CURLE_OK || response_code < 200 || response_code >= 300)
     {
@@ -285,3 +503,56 @@ int mark_command_processed(const supabase_config_t *cfg, const char *command_id,
 
     return 0;
 }
+
+static int is_final_status(const char *status)
+{
+    return strcmp(status, "running") != 0 && strcmp(status, "pending") != 0;
+}
+
+int mark_command_processed(const supabase_config_t *cfg, const char *command_id, const char *status)
+{
+    if (!command_id)
+        return -1;
+    char filter[CMD_ID_LEN + 8];
+    snprintf(filter, sizeof(filter), "id=eq.%s", command_id);
+    return patch_command_status(cfg, filter, status, 1, NULL);
+}
+
+int mark_command_failed(const supabase_config_t *cfg, const char *command_id, const char *reason)
+{
+    if (!command_id)
+        return -1;
+    char filter[CMD_ID_LEN + 8];
+    snprintf(filter, sizeof(filter), "id=eq.%s", command_id);
+    return patch_command_status(cfg, filter, "failed", 1, reason);
+}
+
+int mark_command_running(const supabase_config_t *cfg, const char *command_id)
+{
+    if (!command_id)
+        return -1;
+    char filter[CMD_ID_LEN + 8];
+    snprintf(filter, sizeof(filter), "id=eq.%s", command_id);
+    return patch_command_status(cfg, filter, "running", 0, NULL);
+}
+
+int mark_commands_status(const supabase_config_t *cfg, const char *const *command_ids, int n, const char *status)
+{
+    if (!command_ids || !status || n < 0)
+        return -1;
+    if (n == 0)
+        return 0;
+
+    size_t len = 16 + (size_t)n * (CMD_ID_LEN + 1);
+    char *filter = (char *)malloc(len);
+    if (!filter)
+        return -1;
+    size_t off = (size_t)snprintf(filter, len, "id=in.(");
+    for (int i = 0; i < n; i++)
+        off += (size_t)snprintf(filter + off, len - off, "%s%s", i ? "," : "", command_ids[i]);
+    snprintf(filter + off, len - off, ")");
+
+    int ret = patch_command_status(cfg, filter, status, is_final_status(status), NULL);
+    free(filter);
+    return ret;
+}
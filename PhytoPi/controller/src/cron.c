@@ -0,0 +1,227 @@
+/**
+ * Cron expression parsing and next-fire computation for PhytoPi schedules
+ */
+#include "../lib/cron.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define CRON_SEARCH_DAYS (5 * 366)
+
+static const char *const month_names[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                          "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+static const char *const wday_names[] = {"SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
+
+/*
+ * Helper: read a number or (for months/weekdays) a three-letter name.
+ * Returns the value or -1, advancing *p past it.
+ */
+static int parse_value(const char **p, const char *const *names, int n_names, int name_base)
+{
+    if (isdigit((unsigned char)**p))
+    {
+        char *end;
+        long v = strtol(*p, &end, 10);
+        *p = end;
+        return v > 1000 ? -1 : (int)v;
+    }
+    for (int i = 0; names && i < n_names; i++)
+    {
+        if (strncasecmp(*p, names[i], 3) == 0)
+        {
+            *p += 3;
+            return i + name_base;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Helper: compile one field ("*", "5", "1-5", "*\/10", "MON-FRI", "0,30")
+ * into bits lo..hi. Returns 0 on success, -1 if malformed or out of range.
+ */
+static int parse_field(const char *field, int lo, int hi, const char *const *names, int n_names, int name_base,
+                       uint64_t *bits, uint8_t *any)
+{
+    *bits = 0;
+    *any = (strcmp(field, "*") == 0);
+    const char *p = field;
+    for (;;)
+    {
+        int from, to;
+        if (*p == '*')
+        {
+            from = lo;
+            to = hi;
+            p++;
+        }
+        else
+        {
+            from = parse_value(&p, names, n_names, name_base);
+            to = from;
+            if (*p == '-')
+            {
+                p++;
+                to = parse_value(&p, names, n_names, name_base);
+            }
+        }
+        int step = 1;
+        if (*p == '/')
+        {
+            p++;
+            step = parse_value(&p, NULL, 0, 0);
+            if (step <= 0)
+                return -1;
+            if (from == to)
+                to = hi; /* "5/15" means 5, 20, 35, ... */
+        }
+        if (from < lo || to > hi || from > to)
+            return -1;
+        for (int v = from; v <= to; v += step)
+            *bits |= 1ULL << v;
+        if (*p == ',')
+        {
+            p++;
+            continue;
+        }
+        return *p == '\0' ? 0 : -1;
+    }
+}
+
+int cron_parse(const char *expr, cron_expr_t *out)
+{
+    if (!expr || !out)
+        return -1;
+    while (isspace((unsigned char)*expr))
+        expr++;
+
+    if (expr[0] == '@')
+    {
+        if (strcasecmp(expr, "@hourly") == 0)
+            expr = "0 * * * *";
+        else if (strcasecmp(expr, "@daily") == 0 || strcasecmp(expr, "@midnight") == 0)
+            expr = "0 0 * * *";
+        else if (strcasecmp(expr, "@weekly") == 0)
+            expr = "0 0 * * 0";
+        else if (strcasecmp(expr, "@monthly") == 0)
+            expr = "0 0 1 * *";
+        else if (strcasecmp(expr, "@yearly") == 0 || strcasecmp(expr, "@annually") == 0)
+            expr = "0 0 1 1 *";
+        else
+            return -1;
+    }
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", expr);
+    char *fields[5] = {"*", "*", "*", "*", "*"};
+    int n = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(buf, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save))
+    {
+        if (n == 5)
+            return -1;
+        fields[n++] = tok;
+    }
+    if (n == 0)
+        return -1;
+
+    uint64_t bits;
+    uint8_t any;
+    memset(out, 0, sizeof(*out));
+    if (parse_field(fields[0], 0, 59, NULL, 0, 0, &bits, &any) != 0)
+        return -1;
+    out->minute = bits;
+    if (parse_field(fields[1], 0, 23, NULL, 0, 0, &bits, &any) != 0)
+        return -1;
+    out->hour = (uint32_t)bits;
+    if (parse_field(fields[2], 1, 31, NULL, 0, 0, &bits, &any) != 0)
+        return -1;
+    out->mday = (uint32_t)bits;
+    out->mday_any = any;
+    if (parse_field(fields[3], 1, 12, month_names, 12, 1, &bits, &any) != 0)
+        return -1;
+    out->month = (uint16_t)bits;
+    if (parse_field(fields[4], 0, 7, wday_names, 7, 0, &bits, &any) != 0)
+        return -1;
+    if (bits & (1ULL << 7))
+        bits |= 1; /* 7 is Sunday too */
+    out->wday = (uint8_t)(bits & 0x7F);
+    out->wday_any = any;
+    return 0;
+}
+
+/*
+ * Helper: does the calendar day of tm match the day-of-month/weekday fields
+ */
+static int day_matches(const cron_expr_t *c, const struct tm *tm)
+{
+    int md = (c->mday >> tm->tm_mday) & 1;
+    int wd = (c->wday >> tm->tm_wday) & 1;
+    if (c->mday_any || c->wday_any)
+        return md && wd;
+    return md || wd;
+}
+
+time_t cron_next(const cron_expr_t *c, time_t after)
+{
+    /* Walk the local wall clock as if it were UTC so DST never shifts the
+     * fields under the search; only the match is converted back with mktime */
+    struct tm tm;
+    if (!localtime_r(&after, &tm))
+        return -1;
+    time_t wall = timegm(&tm);
+    wall = wall - (wall % 60) + 60;
+    time_t limit = wall + (time_t)CRON_SEARCH_DAYS * 86400;
+
+    while (wall <= limit)
+    {
+        gmtime_r(&wall, &tm);
+        if (!((c->month >> (tm.tm_mon + 1)) & 1))
+        {
+            tm.tm_mon++;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        }
+        else if (!day_matches(c, &tm))
+        {
+            tm.tm_mday++;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        }
+        else if (!((c->hour >> tm.tm_hour) & 1))
+        {
+            tm.tm_hour++;
+            tm.tm_min = 0;
+        }
+        else if (!((c->minute >> tm.tm_min) & 1))
+        {
+            tm.tm_min++;
+        }
+        else
+        {
+            /* A time skipped by the spring DST change fires when the clock
+             * resumes (02:30 -> 03:30); one repeated in autumn fires once, at
+             * its first occurrence (mktime may return either) */
+            struct tm local = tm;
+            local.tm_isdst = -1;
+            time_t t = mktime(&local);
+            if (t != (time_t)-1)
+            {
+                struct tm earlier;
+                time_t e = t - 3600;
+                if (localtime_r(&e, &earlier) && earlier.tm_mday == tm.tm_mday &&
+                    earlier.tm_hour == tm.tm_hour && earlier.tm_min == tm.tm_min)
+                    t = e;
+                if (t > after)
+                    return t;
+            }
+            tm.tm_min++;
+        }
+        tm.tm_sec = 0;
+        wall = timegm(&tm);
+    }
+    return -1;
+}
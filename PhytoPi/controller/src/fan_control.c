@@ -0,0 +1,236 @@
+/**
+ * Closed-loop fan control for PhytoPi
+ */
+#include "../lib/fan_control.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { FAN_MODE_OFF, FAN_MODE_PID, FAN_MODE_HYSTERESIS };
+enum { LOOP_TEMP, LOOP_HUMIDITY, LOOP_COUNT };
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    double setpoint;   /* NAN = not controlled */
+    double kp, ki, kd;
+    double band;
+    double integral;   /* duty %, kept within 0..FAN_CTRL_MAX_DUTY */
+    double pv_filt;    /* smoothed measurement for the derivative */
+    int primed;        /* pv_filt holds a sample */
+    int bang_on;       /* hysteresis state */
+    long samples;
+    double err_sq;     /* over the setpoint only */
+    double err_max;
+} fan_loop_t;
+
+static fan_loop_t loops[LOOP_COUNT] = {
+    [LOOP_TEMP] = {.name = "temp", .unit = "C"},
+    [LOOP_HUMIDITY] = {.name = "humidity", .unit = "%RH"},
+};
+static int mode = FAN_MODE_OFF;
+static int min_duty = FAN_CTRL_MIN_DUTY;
+static double rate = FAN_CTRL_RATE;
+
+static double duty = 0.0;    /* rate-limited controller output */
+static int running = 0;      /* output above the off threshold */
+static int held = 1;         /* restart from the applied duty on the next update */
+static time_t last_update = 0;
+static long writes = 0;
+
+/*
+ * Helper: parse "a:b:c" into up to n doubles, keeping defaults for missing fields
+ */
+static void parse_triplet(const char *s, double *v, int n)
+{
+    double t[3] = {v[0], n > 1 ? v[1] : 0, n > 2 ? v[2] : 0};
+    if (sscanf(s, "%lf:%lf:%lf", &t[0], &t[1], &t[2]) <= 0)
+    {
+        fprintf(stderr, "Fan control: ignoring malformed value '%s'\n", s);
+        return;
+    }
+    memcpy(v, t, (size_t)n * sizeof(double));
+}
+
+static double env_double(const char *name, double def)
+{
+    const char *env = getenv(name);
+    return (env && env[0]) ? atof(env) : def;
+}
+
+int fan_control_init(void)
+{
+    const char *env = getenv("PHYTOPI_FAN_MODE");
+    mode = FAN_MODE_OFF;
+    if (env && strcmp(env, "pid") == 0)
+        mode = FAN_MODE_PID;
+    else if (env && strcmp(env, "hysteresis") == 0)
+        mode = FAN_MODE_HYSTERESIS;
+
+    loops[LOOP_TEMP].setpoint = env_double("PHYTOPI_FAN_TEMP_SETPOINT", NAN);
+    loops[LOOP_HUMIDITY].setpoint = env_double("PHYTOPI_FAN_HUMIDITY_SETPOINT", NAN);
+
+    const char *pid_env[LOOP_COUNT] = {"PHYTOPI_FAN_TEMP_PID", "PHYTOPI_FAN_HUMIDITY_PID"};
+    const char *pid_def[LOOP_COUNT] = {FAN_CTRL_TEMP_PID_DEFAULT, FAN_CTRL_HUMIDITY_PID_DEFAULT};
+    double band[2] = {0, 0};
+    parse_triplet(FAN_CTRL_BAND_DEFAULT, band, 2);
+    env = getenv("PHYTOPI_FAN_BAND");
+    if (env && env[0])
+        parse_triplet(env, band, 2);
+    for (int i = 0; i < LOOP_COUNT; i++)
+    {
+        double k[3] = {0, 0, 0};
+        parse_triplet(pid_def[i], k, 3);
+        env = getenv(pid_env[i]);
+        if (env && env[0])
+            parse_triplet(env, k, 3);
+        loops[i].kp = k[0];
+        loops[i].ki = k[1];
+        loops[i].kd = k[2];
+        loops[i].band = fabs(band[i]);
+    }
+
+    min_duty = (int)env_double("PHYTOPI_FAN_MIN_DUTY", FAN_CTRL_MIN_DUTY);
+    if (min_duty < 1 || min_duty > FAN_CTRL_MAX_DUTY)
+        min_duty = FAN_CTRL_MIN_DUTY;
+    rate = env_double("PHYTOPI_FAN_RATE", FAN_CTRL_RATE);
+    if (rate <= 0)
+        rate = FAN_CTRL_RATE;
+
+    if (mode != FAN_MODE_OFF && isnan(loops[LOOP_TEMP].setpoint) && isnan(loops[LOOP_HUMIDITY].setpoint))
+    {
+        fprintf(stderr, "Fan control: PHYTOPI_FAN_MODE set without a setpoint, disabled\n");
+        mode = FAN_MODE_OFF;
+    }
+    if (mode != FAN_MODE_OFF)
+        printf("Fan control: %s, temp setpoint %.1f, humidity setpoint %.1f, min duty %d%%, %.1f%%/s\n",
+               mode == FAN_MODE_PID ? "pid" : "hysteresis", loops[LOOP_TEMP].setpoint,
+               loops[LOOP_HUMIDITY].setpoint, min_duty, rate);
+    held = 1;
+    return mode != FAN_MODE_OFF;
+}
+
+int fan_control_enabled(void)
+{
+    return mode != FAN_MODE_OFF;
+}
+
+/*
+ * Helper: one loop's duty demand for measurement pv over dt seconds,
+ * NAN if the loop has no setpoint or no reading
+ */
+static double loop_demand(fan_loop_t *l, double pv, double dt)
+{
+    if (isnan(l->setpoint) || isnan(pv))
+        return NAN;
+    double e = pv - l->setpoint; /* positive = too warm / too humid */
+    double excess = fmax(e, 0.0); /* fans can only pull the value down */
+    l->samples++;
+    l->err_sq += excess * excess;
+    if (excess > l->err_max)
+        l->err_max = excess;
+
+    if (mode == FAN_MODE_HYSTERESIS)
+    {
+        if (e > l->band)
+            l->bang_on = 1;
+        else if (e < -l->band)
+            l->bang_on = 0;
+        return l->bang_on ? FAN_CTRL_MAX_DUTY : 0.0;
+    }
+
+    double prev = l->pv_filt;
+    l->pv_filt = l->primed ? l->pv_filt + 0.5 * (pv - l->pv_filt) : pv;
+    double slope = (l->primed && dt > 0) ? (l->pv_filt - prev) / dt : 0.0;
+    l->primed = 1;
+
+    /* Proportional and derivative act on the smoothed value so sensor noise
+     * does not reach the PWM; the integral takes the raw error */
+    double p = l->kp * (l->pv_filt - l->setpoint);
+    double d = l->kd * slope;
+    double integral = l->integral + l->ki * e * dt;
+    double u = p + integral + d;
+    /* Anti-windup: do not integrate further into a saturated output */
+    if ((u > FAN_CTRL_MAX_DUTY && e > 0) || (u < 0 && e < 0))
+        integral = l->integral;
+    l->integral = fmin(fmax(integral, 0.0), FAN_CTRL_MAX_DUTY);
+
+    u = p + l->integral + d;
+    return fmin(fmax(u, 0.0), FAN_CTRL_MAX_DUTY);
+}
+
+int fan_control_update(time_t now, double temp_c, double humidity, int applied)
+{
+    if (mode == FAN_MODE_OFF)
+        return -1;
+
+    double dt = (double)(now - last_update);
+    if (held || dt > FAN_CTRL_MAX_DT)
+    {
+        /* Bumpless (re)start: continue from whatever the fans run at now */
+        for (int i = 0; i < LOOP_COUNT; i++)
+        {
+            loops[i].integral = applied;
+            loops[i].primed = 0;
+            loops[i].bang_on = applied > 0;
+        }
+        duty = applied;
+        running = applied > 0;
+        held = 0;
+        dt = 0;
+    }
+    else if (dt <= 0)
+    {
+        return -1;
+    }
+    last_update = now;
+
+    double pv[LOOP_COUNT] = {temp_c, humidity};
+    double demand = NAN;
+    for (int i = 0; i < LOOP_COUNT; i++)
+    {
+        double u = loop_demand(&loops[i], pv[i], dt);
+        if (!isnan(u) && (isnan(demand) || u > demand))
+            demand = u;
+    }
+    if (isnan(demand))
+        return -1; /* nothing measured: keep the fans as they are */
+
+    double step = rate * dt;
+    duty += fmin(fmax(demand - duty, -step), step);
+
+    /* Fans stall below min_duty: switch off under half of it, back on at it */
+    if (!running && duty >= min_duty)
+        running = 1;
+    else if (running && duty < min_duty / 2.0)
+        running = 0;
+    int target = running ? (int)lround(fmax(duty, min_duty)) : 0;
+
+    if (target == applied)
+        return -1;
+    if (abs(target - applied) < FAN_CTRL_WRITE_STEP && target != 0 && target != FAN_CTRL_MAX_DUTY)
+        return -1;
+    writes++;
+    return target;
+}
+
+void fan_control_hold(void)
+{
+    held = 1;
+}
+
+void fan_control_report(void)
+{
+    if (mode == FAN_MODE_OFF)
+        return;
+    printf("Fan control: %ld duty writes\n", writes);
+    for (int i = 0; i < LOOP_COUNT; i++)
+    {
+        const fan_loop_t *l = &loops[i];
+        if (isnan(l->setpoint) || l->samples == 0)
+            continue;
+        printf("Fan control: %s %ld samples, rms excess %.2f %s, max %.2f %s over setpoint %.1f\n",
+               l->name, l->samples, sqrt(l->err_sq / l->samples), l->unit, l->err_max, l->unit, l->setpoint);
+    }
+}
@@ -2,6 +2,8 @@
 #include <stdint.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -9,18 +11,46 @@
 
 static struct gpiod_chip *chip = NULL;
 static struct gpiod_line_request *req_generic = NULL;
-static struct gpiod_line_request *req_lights = NULL;
-static struct gpiod_line_request *req_pump = NULL;
+static struct gpiod_line_request *req_outputs = NULL;
 static struct gpiod_line_request *req_water_level = NULL;
+static int generic_pin = -1;
+static int generic_output = -1;
 static int gpio_initialized = 0;
-static int lights_initialized = 0;
-static int pump_initialized = 0;
+static int actuators_initialized = 0;
+static unsigned int actuator_values = 0; /* ACT_* bits currently driven high */
 static int water_level_initialized = 0;
+static struct gpiod_edge_event_buffer *water_edges = NULL; /* set while the line reports edges */
+static int pump_locked = 0; /* dry-run interlock: the pump may not be switched on */
 static int pwm_initialized = 0;
 
+/* Digital actuator outputs, one bit each in ACT_* order */
+static const unsigned int actuator_pins[ACT_COUNT] = {LIGHTS_PIN, PUMP_PIN};
+
 #define PWM_CHIP "/sys/class/pwm/pwmchip0"
 #define PWM_PERIOD_NS 40000 /* 25kHz = 40us period */
 
+static void pwm_close(int channel);
+
+/* Serialises output changes between the main loop and the safety thread.
+ * Priority inheritance keeps the real-time thread from waiting behind a preempted holder. */
+static pthread_mutex_t out_lock;
+static pthread_once_t out_lock_once = PTHREAD_ONCE_INIT;
+
+static void out_lock_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&out_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void out_lock_acquire(void)
+{
+    pthread_once(&out_lock_once, out_lock_init);
+    pthread_mutex_lock(&out_lock);
+}
+
 /*
  * Helper: open chip if not already open
  */
@@ -36,20 +66,19 @@ static int ensure_chip(void)
 }
 
 /*
- * Helper: create a line request for a single pin as output
+ * Helper: create one line request covering several pins as outputs
  */
-static struct gpiod_line_request *request_output(int pin, const char *consumer, int initial)
+static struct gpiod_line_request *request_outputs(const unsigned int *pins, int n, const char *consumer)
 {
     struct gpiod_line_settings *settings = gpiod_line_settings_new();
     if (!settings) return NULL;
     gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
-    gpiod_line_settings_set_output_value(settings, initial ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+    gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE);
 
     struct gpiod_line_config *config = gpiod_line_config_new();
     if (!config) { gpiod_line_settings_free(settings); return NULL; }
 
-    unsigned int offset = (unsigned int)pin;
-    if (gpiod_line_config_add_line_settings(config, &offset, 1, settings) != 0)
+    if (gpiod_line_config_add_line_settings(config, pins, n, settings) != 0)
     {
         gpiod_line_settings_free(settings);
         gpiod_line_config_free(config);
@@ -75,13 +104,23 @@ static struct gpiod_line_request *request_output(int pin, const char *consumer,
 }
 
 /*
- * Helper: create a line request for a single pin as input
+ * Helper: create a line request for a single pin as output, driven low
  */
-static struct gpiod_line_request *request_input(int pin, const char *consumer)
+static struct gpiod_line_request *request_output(int pin, const char *consumer)
+{
+    unsigned int offset = (unsigned int)pin;
+    return request_outputs(&offset, 1, consumer);
+}
+
+/*
+ * Helper: create a line request for a single pin as input, with optional edge detection
+ */
+static struct gpiod_line_request *request_input_edge(int pin, const char *consumer, enum gpiod_line_edge edge)
 {
     struct gpiod_line_settings *settings = gpiod_line_settings_new();
     if (!settings) return NULL;
     gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+    gpiod_line_settings_set_edge_detection(settings, edge);
 
     struct gpiod_line_config *config = gpiod_line_config_new();
     if (!config) { gpiod_line_settings_free(settings); return NULL; }
@@ -112,21 +151,41 @@ static struct gpiod_line_request *request_input(int pin, const char *consumer)
     return req;
 }
 
+static struct gpiod_line_request *request_input(int pin, const char *consumer)
+{
+    return request_input_edge(pin, consumer, GPIOD_LINE_EDGE_NONE);
+}
+
 /*
- * Initialize GPIO library (opens chip, gets line for given pin)
+ * Helper: (re)request the generic line, skipped when pin and direction are unchanged
  */
-int gpio_init(int pin)
+static int request_generic(int pin, int output)
 {
     if (ensure_chip() != 0)
         return -1;
+    if (req_generic && generic_pin == pin && generic_output == output)
+        return 0;
     if (req_generic)
     {
         gpiod_line_request_release(req_generic);
         req_generic = NULL;
     }
-    req_generic = request_output(pin, "gpio_app", 0);
+    generic_pin = -1;
+    req_generic = output ? request_output(pin, "gpio_app") : request_input(pin, "gpio_app");
     if (!req_generic)
         return -1;
+    generic_pin = pin;
+    generic_output = output;
+    return 0;
+}
+
+/*
+ * Initialize GPIO library (opens chip, gets line for given pin)
+ */
+int gpio_init(int pin)
+{
+    if (request_generic(pin, 1) != 0)
+        return -1;
     gpio_initialized = 1;
     return 0;
 }
@@ -136,15 +195,7 @@ int gpio_init(int pin)
  */
 int gpio_config_input(int pin)
 {
-    if (ensure_chip() != 0)
-        return -1;
-    if (req_generic)
-    {
-        gpiod_line_request_release(req_generic);
-        req_generic = NULL;
-    }
-    req_generic = request_input(pin, "gpio_app");
-    return req_generic ? 0 : -1;
+    return request_generic(pin, 0);
 }
 
 /*
@@ -152,15 +203,7 @@ int gpio_config_input(int pin)
  */
 int gpio_config_output(int pin)
 {
-    if (ensure_chip() != 0)
-        return -1;
-    if (req_generic)
-    {
-        gpiod_line_request_release(req_generic);
-        req_generic = NULL;
-    }
-    req_generic = request_output(pin, "gpio_app", 0);
-    return req_generic ? 0 : -1;
+    return request_generic(pin, 1);
 }
 
 /*
@@ -169,8 +212,7 @@ int gpio_config_output(int pin)
 int gpio_write(int value)
 {
     if (!req_generic) return -1;
-    /* We don't track the offset here — use index 0 since single-line request */
-    return gpiod_line_request_set_value(req_generic, 0,
+    return gpiod_line_request_set_value(req_generic, generic_pin,
         value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
 }
 
@@ -180,7 +222,7 @@ int gpio_write(int value)
 int gpio_read(void)
 {
     if (!req_generic) return -1;
-    enum gpiod_line_value val = gpiod_line_request_get_value(req_generic, 0);
+    enum gpiod_line_value val = gpiod_line_request_get_value(req_generic, generic_pin);
     if (val == GPIOD_LINE_VALUE_ERROR) return -1;
     return (val == GPIOD_LINE_VALUE_ACTIVE) ? 1 : 0;
 }
@@ -190,77 +232,148 @@ int gpio_read(void)
  */
 int gpio_cleanup(void)
 {
-    if (req_lights)   { gpiod_line_request_release(req_lights);      req_lights = NULL; }
-    if (req_pump)     { gpiod_line_request_release(req_pump);        req_pump = NULL; }
+    if (req_outputs)  { gpiod_line_request_release(req_outputs);     req_outputs = NULL; }
     if (req_water_level) { gpiod_line_request_release(req_water_level); req_water_level = NULL; }
+    if (water_edges)  { gpiod_edge_event_buffer_free(water_edges);   water_edges = NULL; }
     if (req_generic)  { gpiod_line_request_release(req_generic);     req_generic = NULL; }
     if (chip)         { gpiod_chip_close(chip);                      chip = NULL; }
+    pwm_close(0);
+    pwm_close(1);
+    generic_pin = -1;
     gpio_initialized = 0;
-    lights_initialized = 0;
-    pump_initialized = 0;
+    actuators_initialized = 0;
+    actuator_values = 0;
     water_level_initialized = 0;
+    pump_locked = 0;
     pwm_initialized = 0;
     return 0;
 }
 
 /*
  * -------------------------------
- * LIGHT CONTROL (24V MOSFET ON GPIO17)
+ * DIGITAL ACTUATORS (lights GPIO17, pump GPIO22)
+ * All outputs share one line request; changes are one set_values_subset ioctl.
  *-------------------------------
  */
-int lights_init(void)
+int actuators_init(void)
 {
-    if (lights_initialized)
+    if (actuators_initialized)
         return 0;
     if (ensure_chip() != 0)
         return -1;
-    req_lights = request_output(LIGHTS_PIN, "phytopi_lights", 0);
-    if (!req_lights)
+    req_outputs = request_outputs(actuator_pins, ACT_COUNT, "phytopi_actuators");
+    if (!req_outputs)
         return -1;
-    lights_initialized = 1;
+    actuator_values = 0;
+    actuators_initialized = 1;
     return 0;
 }
 
-int lights_set(int on)
+int actuators_set(unsigned int mask, unsigned int values)
 {
-    if (!lights_initialized && lights_init() != 0)
+    if (!actuators_initialized && actuators_init() != 0)
         return -1;
-    return gpiod_line_request_set_value(req_lights, LIGHTS_PIN,
-        on ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+
+    out_lock_acquire();
+    /* Interlocked pump: drive it off instead and report the refusal */
+    int refused = pump_locked && (mask & values & ACT_PUMP);
+    if (refused)
+        values &= ~ACT_PUMP;
+
+    unsigned int offsets[ACT_COUNT];
+    enum gpiod_line_value levels[ACT_COUNT];
+    int n = 0;
+    for (int i = 0; i < ACT_COUNT; i++)
+    {
+        unsigned int bit = 1u << i;
+        if (!(mask & bit))
+            continue;
+        offsets[n] = actuator_pins[i];
+        levels[n] = (values & bit) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+        n++;
+    }
+    int ret = n ? gpiod_line_request_set_values_subset(req_outputs, n, offsets, levels) : 0;
+    if (ret == 0)
+        actuator_values = (actuator_values & ~mask) | (values & mask);
+    pthread_mutex_unlock(&out_lock);
+    return (ret == 0 && !refused) ? 0 : -1;
+}
+
+unsigned int actuators_get(void)
+{
+    return actuator_values;
+}
+
+int lights_init(void)
+{
+    return actuators_init();
+}
+
+int lights_set(int on)
+{
+    return actuators_set(ACT_LIGHTS, on ? ACT_LIGHTS : 0);
 }
 
-/*
- * -------------------------------
- * PUMP CONTROL (MOSFET ON GPIO22)
- *-------------------------------
- */
 int pump_init(void)
 {
-    if (pump_initialized)
-        return 0;
-    if (ensure_chip() != 0)
-        return -1;
-    req_pump = request_output(PUMP_PIN, "phytopi_pump", 0);
-    if (!req_pump)
-        return -1;
-    pump_initialized = 1;
-    return 0;
+    return actuators_init();
 }
 
 int pump_set(int on)
 {
-    if (!pump_initialized && pump_init() != 0)
-        return -1;
-    return gpiod_line_request_set_value(req_pump, PUMP_PIN,
-        on ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+    return actuators_set(ACT_PUMP, on ? ACT_PUMP : 0);
+}
+
+int pump_lockout(int on)
+{
+    int cut = 0;
+    out_lock_acquire();
+    pump_locked = on ? 1 : 0;
+    if (pump_locked && (actuator_values & ACT_PUMP))
+    {
+        unsigned int offset = PUMP_PIN;
+        enum gpiod_line_value level = GPIOD_LINE_VALUE_INACTIVE;
+        if (gpiod_line_request_set_values_subset(req_outputs, 1, &offset, &level) == 0)
+        {
+            actuator_values &= ~ACT_PUMP;
+            cut = 1;
+        }
+        else
+            cut = -1;
+    }
+    pthread_mutex_unlock(&out_lock);
+    return cut;
+}
+
+int pump_locked_out(void)
+{
+    out_lock_acquire();
+    int locked = pump_locked;
+    pthread_mutex_unlock(&out_lock);
+    return locked;
 }
 
 /*
  * -------------------------------
  * PWM FAN CONTROL (GPIO12, GPIO13 via sysfs)
- * PWM uses sysfs, no libgpiod needed — unchanged from v1
+ * PWM uses sysfs, no libgpiod needed. Attribute fds stay open after export.
  *-------------------------------
  */
+/* Per-channel sysfs handles, kept open after export. Cached values of -1 force a write. */
+typedef struct {
+    int period_fd;
+    int duty_fd;
+    int enable_fd;
+    int period_ns;
+    int duty_ns;
+    int enabled;
+} pwm_channel_t;
+
+static pwm_channel_t pwm_ch[2] = {
+    {-1, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1},
+};
+
 static int pwm_export(int channel)
 {
     char path[128];
@@ -270,48 +383,117 @@ static int pwm_export(int channel)
         return -1;
     char buf[8];
     snprintf(buf, sizeof(buf), "%d", channel);
-    int ret = (write(fd, buf, strlen(buf)) > 0) ? 0 : -1;
+    int ret = (write(fd, buf, strlen(buf)) > 0 || errno == EBUSY) ? 0 : -1; /* EBUSY = already exported */
     close(fd);
     return ret;
 }
 
-static int pwm_set(int channel, int period_ns, int duty_ns)
+static int pwm_open_attr(int channel, const char *attr)
 {
     char path[128];
-    snprintf(path, sizeof(path), "%s/pwm%d/period", PWM_CHIP, channel);
-    int fd = open(path, O_WRONLY);
+    snprintf(path, sizeof(path), "%s/pwm%d/%s", PWM_CHIP, channel, attr);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
     if (fd < 0)
-        return -1;
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%d", period_ns);
-    write(fd, buf, strlen(buf));
-    close(fd);
+        fprintf(stderr, "PWM: open %s failed: %s\n", path, strerror(errno));
+    return fd;
+}
 
-    snprintf(path, sizeof(path), "%s/pwm%d/duty_cycle", PWM_CHIP, channel);
-    fd = open(path, O_WRONLY);
-    if (fd < 0)
-        return -1;
-    snprintf(buf, sizeof(buf), "%d", duty_ns);
-    write(fd, buf, strlen(buf));
-    close(fd);
+static void pwm_close(int channel)
+{
+    pwm_channel_t *c = &pwm_ch[channel];
+    if (c->period_fd >= 0) close(c->period_fd);
+    if (c->duty_fd >= 0) close(c->duty_fd);
+    if (c->enable_fd >= 0) close(c->enable_fd);
+    c->period_fd = c->duty_fd = c->enable_fd = -1;
+    c->period_ns = c->duty_ns = c->enabled = -1;
+}
+
+/*
+ * Helper: open the channel's attribute files once. The pwmN directory can
+ * appear a moment after export while udev fixes permissions, so retry briefly.
+ */
+static int pwm_open(int channel)
+{
+    pwm_channel_t *c = &pwm_ch[channel];
+    if (c->period_fd >= 0 && c->duty_fd >= 0 && c->enable_fd >= 0)
+        return 0;
+    pwm_close(channel);
 
+    char path[128];
     snprintf(path, sizeof(path), "%s/pwm%d/enable", PWM_CHIP, channel);
-    fd = open(path, O_WRONLY);
-    if (fd < 0)
+    for (int tries = 0; tries < 10 && access(path, W_OK) != 0; tries++)
+        usleep(10000);
+
+    c->period_fd = pwm_open_attr(channel, "period");
+    c->duty_fd = pwm_open_attr(channel, "duty_cycle");
+    c->enable_fd = pwm_open_attr(channel, "enable");
+    if (c->period_fd < 0 || c->duty_fd < 0 || c->enable_fd < 0)
+    {
+        pwm_close(channel);
         return -1;
-    write(fd, duty_ns > 0 ? "1" : "0", 1);
-    close(fd);
+    }
     return 0;
 }
 
+/*
+ * Helper: write an integer to a sysfs attribute at offset 0.
+ * On failure the cached value is dropped so the next call writes again.
+ */
+static int pwm_write_attr(int fd, int value, int *cached, int channel, const char *attr)
+{
+    if (*cached == value)
+        return 0;
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%d", value);
+    if (pwrite(fd, buf, len, 0) != len)
+    {
+        fprintf(stderr, "PWM: write pwm%d/%s=%d failed: %s\n", channel, attr, value, strerror(errno));
+        *cached = -1;
+        return -1;
+    }
+    *cached = value;
+    return 0;
+}
+
+/*
+ * Only attributes that changed are written: usually just duty_cycle.
+ * duty_cycle must never exceed period, so order the writes accordingly.
+ */
+static int pwm_set(int channel, int period_ns, int duty_ns)
+{
+    if (pwm_open(channel) != 0)
+        return -1;
+    pwm_channel_t *c = &pwm_ch[channel];
+    int ret = 0;
+
+    if (c->period_ns >= 0 && period_ns < c->period_ns)
+    {
+        ret |= pwm_write_attr(c->duty_fd, duty_ns, &c->duty_ns, channel, "duty_cycle");
+        ret |= pwm_write_attr(c->period_fd, period_ns, &c->period_ns, channel, "period");
+    }
+    else
+    {
+        ret |= pwm_write_attr(c->period_fd, period_ns, &c->period_ns, channel, "period");
+        ret |= pwm_write_attr(c->duty_fd, duty_ns, &c->duty_ns, channel, "duty_cycle");
+    }
+    ret |= pwm_write_attr(c->enable_fd, duty_ns > 0, &c->enabled, channel, "enable");
+    return ret ? -1 : 0;
+}
+
 int fans_init(void)
 {
     if (pwm_initialized)
         return 0;
-    if (pwm_export(0) != 0 && pwm_export(0) != 0)
-        ;
-    if (pwm_export(1) != 0 && pwm_export(1) != 0)
-        ;
+    int ok = 0;
+    for (int ch = 0; ch < 2; ch++)
+    {
+        if (pwm_export(ch) != 0 && pwm_export(ch) != 0)
+            fprintf(stderr, "PWM: export of channel %d failed\n", ch);
+        if (pwm_open(ch) == 0)
+            ok++;
+    }
+    if (ok == 0)
+        return -1;
     pwm_initialized = 1;
     return 0;
 }
@@ -326,7 +508,10 @@ int fans_set_speed(int fan_id, int duty_percent)
     if (duty_percent > 100) duty_percent = 100;
     int ch = (fan_id == 1) ? 0 : 1;
     int duty_ns = (PWM_PERIOD_NS * duty_percent) / 100;
-    return pwm_set(ch, PWM_PERIOD_NS, duty_ns);
+    out_lock_acquire();
+    int ret = pwm_set(ch, PWM_PERIOD_NS, duty_ns);
+    pthread_mutex_unlock(&out_lock);
+    return ret;
 }
 
 int fans_set_both(int duty_percent)
@@ -385,12 +570,63 @@ int read_photoelectric_water_level(int *frequency_hz)
     return 0;
 }
 
+int water_level_watch(void)
+{
+    if (ensure_chip() != 0)
+        return -1;
+    if (!water_edges)
+    {
+        water_edges = gpiod_edge_event_buffer_new(WATER_EDGE_BUFFER);
+        if (!water_edges)
+            return -1;
+        /* Replace the plain input request with one that reports rising edges */
+        if (req_water_level)
+            gpiod_line_request_release(req_water_level);
+        req_water_level = request_input_edge(WATER_LEVEL_PIN, "phytopi_water", GPIOD_LINE_EDGE_RISING);
+        if (!req_water_level)
+        {
+            gpiod_edge_event_buffer_free(water_edges);
+            water_edges = NULL;
+            return -1;
+        }
+        water_level_initialized = 1;
+    }
+    return gpiod_line_request_get_fd(req_water_level);
+}
+
+int water_level_read_edges(void)
+{
+    if (!req_water_level || !water_edges)
+        return -1;
+    int total = 0;
+    /* Drain everything queued so far; a full buffer means more may be waiting */
+    while (gpiod_line_request_wait_edge_events(req_water_level, 0) > 0)
+    {
+        int n = gpiod_line_request_read_edge_events(req_water_level, water_edges, WATER_EDGE_BUFFER);
+        if (n < 0)
+            return -1;
+        total += n;
+        if (n < WATER_EDGE_BUFFER)
+            break;
+    }
+    return total;
+}
+
 /*
  * -------------------------------
  * I2C / PCF8591 ADC
  *-------------------------------
  */
 int i2c_init(const char *i2c_bus)
+{
+    return i2c_init_addr(i2c_bus, PCF8591_ADDR);
+}
+
+/*
+ * Opens an I2C bus handle bound to the given 7-bit slave address.
+ * Returns the file descriptor on success, -1 on failure.
+ */
+int i2c_init_addr(const char *i2c_bus, int addr)
 {
     int fd = open(i2c_bus, O_RDWR);
     if (fd < 0)
@@ -399,7 +635,7 @@ int i2c_init(const char *i2c_bus)
         return -1;
     }
 
-    if (ioctl(fd, I2C_SLAVE, PCF8591_ADDR) < 0)
+    if (ioctl(fd, I2C_SLAVE, addr) < 0)
     {
         perror("Failed to acquire bus access and/or talk to slave");
         close(fd);
@@ -433,4 +669,30 @@ int read_pcf8591_channel(int fd, int channel)
         return -1;
 
     return data;
-}
\ No newline at end of file
+}
+
+/*
+ * Scans all four PCF8591 channels with a single control write and a single
+ * 5-byte read. With the auto-increment bit set the chip advances to the next
+ * channel after every byte; the first byte is the stale previous conversion.
+ * Returns 0 on success, -1 on failure.
+ */
+int read_pcf8591_scan(int fd, int values[PCF8591_CHANNELS])
+{
+    if (fd < 0 || !values)
+        return -1;
+
+    unsigned char cmd = 0x40 | 0x04; /* analog output enable | auto-increment, start at AIN0 */
+    unsigned char data[PCF8591_CHANNELS + 1];
+
+    if (write(fd, &cmd, 1) != 1)
+        return -1;
+
+    if (read(fd, data, sizeof(data)) != (ssize_t)sizeof(data))
+        return -1;
+
+    for (int ch = 0; ch < PCF8591_CHANNELS; ch++)
+        values[ch] = data[ch + 1];
+
+    return 0;
+}
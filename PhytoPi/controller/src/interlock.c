@@ -0,0 +1,246 @@
+/**
+ * Pump dry-run interlock for PhytoPi
+ * Water state is evaluated on every edge-stream measurement window and the
+ * pump is locked out the moment the reservoir reads Empty.
+ */
+#include "../lib/interlock.h"
+#include "../lib/gpio.h"
+#include "../lib/sensor_drivers.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+
+static const char *event_names[] = {"engaged", "released", "cut", "refused"};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int water_state = -1;
+static int last_hz = -1;
+static int engaged = 0;
+
+/* Event queue for the main loop (ring buffer, written under lock) */
+static interlock_event_t events[INTERLOCK_EVENT_QUEUE];
+static int ev_head = 0;
+static int ev_count = 0;
+
+static pthread_t thread;
+static int edge_fd = -1;
+static int running = 0;
+static volatile int stop_requested = 0;
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Helper: queue an event, dropping the oldest when full. Caller holds lock.
+ */
+static void push_event_locked(interlock_event_type_t type)
+{
+    if (ev_count == INTERLOCK_EVENT_QUEUE)
+    {
+        ev_head = (ev_head + 1) % INTERLOCK_EVENT_QUEUE;
+        ev_count--;
+    }
+    interlock_event_t *ev = &events[(ev_head + ev_count) % INTERLOCK_EVENT_QUEUE];
+    ev->type = type;
+    ev->water_hz = last_hz;
+    ev->timestamp = time(NULL);
+    ev_count++;
+}
+
+/*
+ * Helper: step the water state with one measurement and engage or release
+ * the lockout on a transition into or out of Empty. Caller holds lock.
+ */
+static void evaluate_locked(int hz)
+{
+    water_state = frequency_to_water_state(hz, water_state);
+    last_hz = hz;
+    if (water_state == WATER_STATE_EMPTY && !engaged)
+    {
+        engaged = 1;
+        int cut = pump_lockout(1);
+        push_event_locked(INTERLOCK_ENGAGED);
+        if (cut > 0)
+            push_event_locked(INTERLOCK_CUT);
+        else if (cut < 0)
+            fprintf(stderr, "Interlock: reservoir empty but switching the pump off failed\n");
+    }
+    else if (water_state != WATER_STATE_EMPTY && engaged)
+    {
+        engaged = 0;
+        pump_lockout(0);
+        push_event_locked(INTERLOCK_RELEASED);
+    }
+}
+
+/*
+ * Helper: count rising edges for one window. Returns the frequency in Hz,
+ * -1 on a stream error.
+ */
+static int measure_window(void)
+{
+    int64_t end = now_ms() + INTERLOCK_WINDOW_MS;
+    int edges = 0;
+    int64_t left;
+    while ((left = end - now_ms()) > 0)
+    {
+        struct pollfd pfd = {.fd = edge_fd, .events = POLLIN};
+        int r = poll(&pfd, 1, (int)left);
+        if (r < 0 && errno != EINTR)
+            return -1;
+        if (r > 0 && (pfd.revents & POLLIN))
+        {
+            int n = water_level_read_edges();
+            if (n < 0)
+                return -1;
+            edges += n;
+        }
+    }
+    return edges * (1000 / INTERLOCK_WINDOW_MS);
+}
+
+static void *interlock_thread(void *arg)
+{
+    int failed = 0;
+    while (!stop_requested)
+    {
+        int hz = measure_window();
+        if (hz < 0)
+        {
+            /* Keep the last state; a disconnected sensor reads 0 Hz (Empty) anyway */
+            if (!failed)
+                fprintf(stderr, "Interlock: edge stream read failed: %s\n", strerror(errno));
+            failed = 1;
+            usleep(INTERLOCK_WINDOW_MS * 1000);
+            continue;
+        }
+        failed = 0;
+        pthread_mutex_lock(&lock);
+        evaluate_locked(hz);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+int interlock_start(void)
+{
+    if (running)
+        return 0;
+
+    edge_fd = water_level_watch();
+    if (edge_fd < 0)
+    {
+        /* Judge the reservoir once now so a restored pump state is checked */
+        int hz = -1;
+        if (read_photoelectric_water_level(&hz) == 0)
+            interlock_feed(hz);
+        printf("Interlock: no water level edge stream, checking every water reading instead\n");
+        return -1;
+    }
+
+    /* First window before the thread starts, so the pump is never switched on unchecked */
+    water_level_read_edges();
+    int hz = measure_window();
+    if (hz >= 0)
+        interlock_feed(hz);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    struct sched_param sp = {.sched_priority = INTERLOCK_RT_PRIORITY};
+    pthread_attr_setschedparam(&attr, &sp);
+
+    stop_requested = 0;
+    int rc = pthread_create(&thread, &attr, interlock_thread, NULL);
+    if (rc == EPERM)
+    {
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        rc = pthread_create(&thread, &attr, interlock_thread, NULL);
+    }
+    pthread_attr_destroy(&attr);
+    if (rc != 0)
+    {
+        fprintf(stderr, "Interlock: thread start failed (%s), checking every water reading instead\n",
+                strerror(rc));
+        edge_fd = -1;
+        return -1;
+    }
+    running = 1;
+    printf("Interlock: watching water level every %d ms (%d Hz, pump %s)\n", INTERLOCK_WINDOW_MS,
+           last_hz, engaged ? "locked out" : "allowed");
+    return 0;
+}
+
+void interlock_feed(int hz)
+{
+    if (hz < 0)
+        return;
+    pthread_mutex_lock(&lock);
+    evaluate_locked(hz);
+    pthread_mutex_unlock(&lock);
+}
+
+int interlock_water_hz(int *hz)
+{
+    if (!running || !hz)
+        return -1;
+    pthread_mutex_lock(&lock);
+    *hz = last_hz;
+    pthread_mutex_unlock(&lock);
+    return *hz >= 0 ? 0 : -1;
+}
+
+int interlock_engaged(void)
+{
+    pthread_mutex_lock(&lock);
+    int e = engaged;
+    pthread_mutex_unlock(&lock);
+    return e;
+}
+
+void interlock_refused(void)
+{
+    pthread_mutex_lock(&lock);
+    push_event_locked(INTERLOCK_REFUSED);
+    pthread_mutex_unlock(&lock);
+}
+
+int interlock_take_event(interlock_event_t *ev)
+{
+    pthread_mutex_lock(&lock);
+    int have = ev_count > 0;
+    if (have)
+    {
+        *ev = events[ev_head];
+        ev_head = (ev_head + 1) % INTERLOCK_EVENT_QUEUE;
+        ev_count--;
+    }
+    pthread_mutex_unlock(&lock);
+    return have;
+}
+
+const char *interlock_event_name(interlock_event_type_t type)
+{
+    if ((int)type < 0 || (int)type >= (int)(sizeof(event_names) / sizeof(event_names[0])))
+        return "unknown";
+    return event_names[type];
+}
+
+void interlock_stop(void)
+{
+    if (running)
+    {
+        stop_requested = 1;
+        pthread_join(thread, NULL);
+        running = 0;
+    }
+    edge_fd = -1;
+}
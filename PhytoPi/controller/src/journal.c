@@ -0,0 +1,438 @@
+/**
+ * Command journal for PhytoPi
+ * Exactly-once command execution: ids are looked up in an in-memory hash
+ * index backed by the SQLite table command_journal, and outcomes are
+ * acknowledged to Supabase from a retrying background thread.
+ */
+#include "../lib/journal.h"
+#include "../lib/commands.h"
+#include "../lib/sql.h"
+
+#include <sqlite3.h>
+#include <pthread.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define JOURNAL_STATUS_LEN 12
+#define JOURNAL_PRUNE_INTERVAL 3600
+
+typedef struct {
+    char id[CMD_ID_LEN];
+    char status[JOURNAL_STATUS_LEN];
+    char error[CMD_ERROR_LEN];
+    int64_t updated_at;
+    unsigned int seq; /* bumped on every change, so a stale ack is not applied */
+    int acked;
+} journal_entry_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake;
+static pthread_t thread;
+static int running = 0;
+static int stop_requested = 0;
+static int kicked = 0;
+
+static sqlite3 *jdb = NULL;
+static const supabase_config_t *ack_cfg = NULL;
+
+static journal_entry_t *entries = NULL;
+static int entry_count = 0;
+static int entry_cap = 0;
+static int *index_slots = NULL; /* entry index or -1, open addressing */
+static int index_size = 0;
+
+static unsigned int id_hash(const char *id)
+{
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)id; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Helper: position of id in the index (its slot, or the empty slot it would take) */
+static int index_probe(const char *id)
+{
+    int i = (int)(id_hash(id) & (unsigned int)(index_size - 1));
+    while (index_slots[i] >= 0 && strcmp(entries[index_slots[i]].id, id) != 0)
+        i = (i + 1) & (index_size - 1);
+    return i;
+}
+
+static int index_rebuild(int min_size)
+{
+    int size = 64;
+    while (size < min_size * 2)
+        size *= 2;
+    int *slots = (int *)malloc((size_t)size * sizeof(int));
+    if (!slots)
+        return -1;
+    free(index_slots);
+    index_slots = slots;
+    index_size = size;
+    for (int i = 0; i < size; i++)
+        index_slots[i] = -1;
+    for (int e = 0; e < entry_count; e++)
+        index_slots[index_probe(entries[e].id)] = e;
+    return 0;
+}
+
+static journal_entry_t *find_entry(const char *id)
+{
+    if (!index_slots)
+        return NULL;
+    int slot = index_slots[index_probe(id)];
+    return slot >= 0 ? &entries[slot] : NULL;
+}
+
+static journal_entry_t *add_entry(const char *id)
+{
+    if (entry_count == entry_cap)
+    {
+        int cap = entry_cap ? entry_cap * 2 : 64;
+        journal_entry_t *grown = (journal_entry_t *)realloc(entries, (size_t)cap * sizeof(journal_entry_t));
+        if (!grown)
+            return NULL;
+        entries = grown;
+        entry_cap = cap;
+    }
+    if ((entry_count + 1) * 2 > index_size && index_rebuild(entry_count + 1) != 0)
+        return NULL;
+    journal_entry_t *e = &entries[entry_count];
+    memset(e, 0, sizeof(*e));
+    snprintf(e->id, sizeof(e->id), "%s", id);
+    index_slots[index_probe(id)] = entry_count++;
+    return e;
+}
+
+static int is_final(const char *status)
+{
+    return strcmp(status, "executed") == 0 || strcmp(status, "failed") == 0;
+}
+
+/* Helper: write one entry through to SQLite. Caller holds lock. */
+static int persist(const journal_entry_t *e)
+{
+    const char *sql = "INSERT OR REPLACE INTO command_journal (id, status, error, updated_at, acked) "
+                      "VALUES (?, ?, ?, ?, ?);";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(jdb, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    sqlite3_bind_text(stmt, 1, e->id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, e->status, -1, SQLITE_STATIC);
+    if (e->error[0])
+        sqlite3_bind_text(stmt, 3, e->error, -1, SQLITE_STATIC);
+    else
+        sqlite3_bind_null(stmt, 3);
+    sqlite3_bind_int64(stmt, 4, e->updated_at);
+    sqlite3_bind_int(stmt, 5, e->acked);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Journal: write failed for %s: %s\n", e->id, sqlite3_errmsg(jdb));
+        return -1;
+    }
+    return 0;
+}
+
+/* Helper: drop acknowledged entries past the retention window. Caller holds lock. */
+static void prune_locked(void)
+{
+    int64_t cutoff = (int64_t)time(NULL) - JOURNAL_RETENTION_SEC;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(jdb, "DELETE FROM command_journal WHERE acked = 1 AND updated_at < ?;", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt, 1, cutoff);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+    int kept = 0;
+    for (int e = 0; e < entry_count; e++)
+    {
+        if (entries[e].acked && entries[e].updated_at < cutoff)
+            continue;
+        if (kept != e)
+            entries[kept] = entries[e];
+        kept++;
+    }
+    if (kept != entry_count)
+    {
+        entry_count = kept;
+        index_rebuild(entry_count);
+    }
+}
+
+static int load_locked(void)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(jdb, "SELECT id, status, error, updated_at, acked FROM command_journal;", -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char *id = (const char *)sqlite3_column_text(stmt, 0);
+        if (!id || find_entry(id))
+            continue;
+        journal_entry_t *e = add_entry(id);
+        if (!e)
+            break;
+        const char *status = (const char *)sqlite3_column_text(stmt, 1);
+        const char *error = (const char *)sqlite3_column_text(stmt, 2);
+        snprintf(e->status, sizeof(e->status), "%s", status ? status : "failed");
+        snprintf(e->error, sizeof(e->error), "%s", error ? error : "");
+        e->updated_at = sqlite3_column_int64(stmt, 3);
+        e->acked = sqlite3_column_int(stmt, 4);
+    }
+    sqlite3_finalize(stmt);
+
+    /* Anything still started/running was cut off by a restart: its effect is
+     * unknown, so report it failed rather than run it again */
+    for (int i = 0; i < entry_count; i++)
+    {
+        journal_entry_t *e = &entries[i];
+        if (is_final(e->status))
+            continue;
+        snprintf(e->error, sizeof(e->error), "controller restarted while command was %s", e->status);
+        snprintf(e->status, sizeof(e->status), "failed");
+        e->updated_at = (int64_t)time(NULL);
+        e->acked = 0;
+        persist(e);
+    }
+    return 0;
+}
+
+/*
+ * Helper: send every unacknowledged outcome once. Executed and running
+ * commands go out in one PATCH per status, failures individually with their
+ * reason. Returns 0 when done, 1 if a full batch went out and more may be
+ * waiting, -1 if some acknowledgements failed.
+ */
+static int ack_pass(void)
+{
+    journal_entry_t batch[JOURNAL_ACK_BATCH];
+    int n = 0;
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < entry_count && n < JOURNAL_ACK_BATCH; i++)
+        if (!entries[i].acked && strcmp(entries[i].status, "started") != 0)
+            batch[n++] = entries[i];
+    pthread_mutex_unlock(&lock);
+    if (n == 0)
+        return 0;
+
+    int ok[JOURNAL_ACK_BATCH] = {0};
+    const char *ids[JOURNAL_ACK_BATCH];
+    static const char *grouped[] = {"executed", "running"};
+    for (int g = 0; g < 2; g++)
+    {
+        int m = 0;
+        for (int i = 0; i < n; i++)
+            if (strcmp(batch[i].status, grouped[g]) == 0)
+                ids[m++] = batch[i].id;
+        if (m == 0 || mark_commands_status(ack_cfg, ids, m, grouped[g]) != 0)
+            continue;
+        for (int i = 0; i < n; i++)
+            if (strcmp(batch[i].status, grouped[g]) == 0)
+                ok[i] = 1;
+    }
+    for (int i = 0; i < n; i++)
+        if (strcmp(batch[i].status, "failed") == 0)
+            ok[i] = mark_command_failed(ack_cfg, batch[i].id, batch[i].error[0] ? batch[i].error : NULL) == 0;
+
+    int remaining = 0;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < n; i++)
+    {
+        journal_entry_t *e = find_entry(batch[i].id);
+        if (!ok[i] || !e || e->seq != batch[i].seq)
+        {
+            remaining++;
+            continue;
+        }
+        e->acked = 1; /* a running command is re-queued when its outcome is recorded */
+        persist(e);
+    }
+    pthread_mutex_unlock(&lock);
+    if (remaining)
+        fprintf(stderr, "Journal: %d acknowledgement(s) failed, retrying\n", remaining);
+    if (remaining)
+        return -1;
+    return n == JOURNAL_ACK_BATCH ? 1 : 0;
+}
+
+static void *ack_thread(void *arg)
+{
+    int backoff = JOURNAL_RETRY_MIN_SEC;
+    time_t last_prune = 0;
+
+    pthread_mutex_lock(&lock);
+    while (!stop_requested)
+    {
+        kicked = 0;
+        pthread_mutex_unlock(&lock);
+        int r = ack_pass();
+        pthread_mutex_lock(&lock);
+
+        if (time(NULL) - last_prune >= JOURNAL_PRUNE_INTERVAL)
+        {
+            last_prune = time(NULL);
+            prune_locked();
+        }
+
+        if (r > 0 || stop_requested)
+            continue;
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        if (r < 0)
+        {
+            /* Supabase unreachable: new outcomes wait for the backoff too */
+            until.tv_sec += backoff;
+            if (backoff < JOURNAL_RETRY_MAX_SEC)
+                backoff *= 2;
+            while (!stop_requested && pthread_cond_timedwait(&wake, &lock, &until) != ETIMEDOUT)
+                ;
+            continue;
+        }
+        backoff = JOURNAL_RETRY_MIN_SEC;
+        if (kicked)
+            continue;
+        until.tv_sec += JOURNAL_PRUNE_INTERVAL;
+        pthread_cond_timedwait(&wake, &lock, &until);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int journal_init(const char *db_path, const supabase_config_t *cfg)
+{
+    if (!db_path || !db_path[0] || !cfg)
+        return -1;
+    if (sqlite3_open(db_path, &jdb) != SQLITE_OK)
+    {
+        fprintf(stderr, "Journal: can't open %s: %s\n", db_path, sqlite3_errmsg(jdb));
+        sqlite3_close(jdb);
+        jdb = NULL;
+        return -1;
+    }
+    sqlite3_busy_timeout(jdb, SQL_BUSY_TIMEOUT_MS);
+    char *errmsg = NULL;
+    if (sqlite3_exec(jdb, "CREATE TABLE IF NOT EXISTS command_journal (id TEXT PRIMARY KEY, status TEXT NOT NULL, "
+                          "error TEXT, updated_at INTEGER NOT NULL, acked INTEGER NOT NULL DEFAULT 0);",
+                     NULL, NULL, &errmsg) != SQLITE_OK)
+    {
+        fprintf(stderr, "Journal: %s\n", errmsg ? errmsg : "create failed");
+        sqlite3_free(errmsg);
+        sqlite3_close(jdb);
+        jdb = NULL;
+        return -1;
+    }
+
+    ack_cfg = cfg;
+    pthread_mutex_lock(&lock);
+    index_rebuild(0);
+    load_locked();
+    int loaded = entry_count;
+    pthread_mutex_unlock(&lock);
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake, &ca);
+    pthread_condattr_destroy(&ca);
+
+    stop_requested = 0;
+    if (pthread_create(&thread, NULL, ack_thread, NULL) != 0)
+    {
+        fprintf(stderr, "Journal: ack thread failed to start\n");
+        pthread_cond_destroy(&wake);
+        pthread_mutex_lock(&lock);
+        sqlite3_close(jdb);
+        jdb = NULL;
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    running = 1;
+    printf("Journal: %d command(s) on record\n", loaded);
+    return 0;
+}
+
+int journal_seen(const char *command_id)
+{
+    if (!command_id)
+        return 0;
+    pthread_mutex_lock(&lock);
+    int seen = find_entry(command_id) != NULL;
+    pthread_mutex_unlock(&lock);
+    return seen;
+}
+
+int journal_record(const char *command_id, const char *status, const char *error)
+{
+    if (!command_id || !status)
+        return -1;
+    pthread_mutex_lock(&lock);
+    if (!jdb)
+    {
+        /* Nothing indexed without a journal, so journal_seen never hides a command */
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    journal_entry_t *e = find_entry(command_id);
+    if (!e)
+        e = add_entry(command_id);
+    if (!e)
+    {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    snprintf(e->status, sizeof(e->status), "%s", status);
+    snprintf(e->error, sizeof(e->error), "%s", error ? error : "");
+    e->updated_at = (int64_t)time(NULL);
+    e->seq++;
+    e->acked = 0;
+    int ret = persist(e);
+    if (strcmp(status, "started") != 0)
+    {
+        kicked = 1;
+        pthread_cond_signal(&wake);
+    }
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+void journal_kick(void)
+{
+    if (!running)
+        return;
+    pthread_mutex_lock(&lock);
+    kicked = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}
+
+void journal_stop(void)
+{
+    if (running)
+    {
+        pthread_mutex_lock(&lock);
+        stop_requested = 1;
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&lock);
+        pthread_join(thread, NULL);
+        pthread_cond_destroy(&wake);
+        running = 0;
+    }
+    if (jdb)
+        sqlite3_close(jdb);
+    jdb = NULL;
+    free(entries);
+    free(index_slots);
+    entries = NULL;
+    index_slots = NULL;
+    entry_count = entry_cap = index_size = 0;
+}
@@ -2,98 +2,47 @@
 #include "../lib/sql.h"
 #include "../lib/supabase.h"
 #include "../lib/commands.h"
-#include "../lib/bme680.h"
 #include "../lib/state.h"
+#include "../lib/sensors.h"
+#include "../lib/sensor_drivers.h"
+#include "../lib/safety.h"
+#include "../lib/capture.h"
+#include "../lib/realtime.h"
+#include "../lib/journal.h"
+#include "../lib/actuator_state.h"
+#include "../lib/thresholds.h"
+#include "../lib/scheduler.h"
+#include "../lib/timer_wheel.h"
+#include "../lib/rules.h"
+#include "../lib/fan_control.h"
+#include "../lib/interlock.h"
 #include <json-c/json.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
-#include <sys/wait.h>
 #include <sys/stat.h>
 
 #define SYNC_INTERVAL 5      // Sync to Supabase every 5 seconds
 #define BATCH_SIZE 50        // Maximum readings per batch
+#define ALERT_BATCH_SIZE 100 // Maximum alerts per POST
+#define ALERT_RETRY_MAX 300  // Longest wait between alert delivery attempts
 #define DATA_READ_INTERVAL 2 // Read sensors every 2 seconds
 #define STATE_PATH "/var/lib/phytopi/device_state.txt"
 
-// Deadband Thresholds
-#define THRESH_TEMP 1                 // 1 degree C
-#define THRESH_HUM 2                  // 2 percent
-#define THRESH_SOIL 2                 // 2 percent points (soil stored as 0–100%)
-#define THRESH_LIGHT 10               // 10 raw units
-#define THRESH_PRESSURE 2             // 2 hPa
-#define THRESH_GAS 5                  // 5 kOhm
-#define THRESH_PHOTO_WATER 5          // 5 Hz
-#define WATER_LEVEL_LOW_HZ_DEFAULT 50 // Default low-water cutoff (Hz) if threshold row has no value
-/* 5-state frequency bands (Hz): 20=empty, 50=DP1, 100=DP2, 200=DP3, 400=DP4. Hysteresis 8 Hz. */
-#define WATER_BAND_0_MAX 35 /* <35 Hz = Empty (0) */
-#define WATER_BAND_1_MIN 27 /* 35-75 = Low (1), hysteresis: exit at 27 */
-#define WATER_BAND_1_MAX 83
-#define WATER_BAND_2_MIN 67
-#define WATER_BAND_2_MAX 158
-#define WATER_BAND_3_MIN 142
-#define WATER_BAND_3_MAX 308
-#define WATER_BAND_4_MIN 292         /* >300 = Full (4), hysteresis: enter at 292 */
-#define WATER_ALERT_COOLDOWN 1800    // 30 min cooldown between water-low alerts
-#define THRESHOLD_ALERT_COOLDOWN 900 // 15 min cooldown per metric
 #define SENSOR_FAIL_ALERT_AFTER 5    // Alert after N consecutive failures
 #define SENSOR_ALERT_COOLDOWN 3600   // 1 hour cooldown between sensor-fail alerts
 #define FAN_MIN_DUTY_WHEN_ON 80      // Minimum duty when "on" requested (avoid 0%)
-
-// Heartbeat
-// Force a recording every X seconds even if values haven't changed
-#define HEARTBEAT_INTERVAL 300 // 5 minutes
-
-// Sensor ID mapping - these should match your Supabase sensors table
-// Set via environment variables: SUPABASE_HUMIDITY_SENSOR_ID, etc.
-static char *humidity_sensor_id = NULL;
-static char *temperature_sensor_id = NULL;
-static char *soil_moisture_sensor_id = NULL;
-static char *pressure_sensor_id = NULL;
-static char *gas_sensor_id = NULL;
-static char *water_level_photoelectric_sensor_id = NULL;
-
-/*
- * Map photoelectric frequency (Hz) to 5-state water level (0-4) with hysteresis.
- * 0=Empty, 1=Low, 2=Mid, 3=High, 4=Full
- */
-/* Map soil ADC (0..adc_max) to 0–100 percent. adc_max from SOIL_ADC_MAX env, default 150. */
-static int soil_raw_to_percent(int raw, int adc_max)
-{
-    if (raw < 0 || adc_max < 1)
-        return -1;
-    double p = 100.0 * (double)raw / (double)adc_max;
-    if (p < 0.0)
-        p = 0.0;
-    if (p > 100.0)
-        p = 100.0;
-    return (int)(p + 0.5);
-}
-
-static int frequency_to_water_state(int hz, int last_state)
-{
-    if (hz < 0)
-        return last_state >= 0 ? last_state : 0;
-    if (hz < WATER_BAND_0_MAX)
-        return 0;
-    if (hz < WATER_BAND_1_MIN)
-        return (last_state == 0) ? 0 : 1;
-    if (hz < WATER_BAND_1_MAX)
-        return 1;
-    if (hz < WATER_BAND_2_MIN)
-        return (last_state == 1) ? 1 : 2;
-    if (hz < WATER_BAND_2_MAX)
-        return 2;
-    if (hz < WATER_BAND_3_MIN)
-        return (last_state == 2) ? 2 : 3;
-    if (hz < WATER_BAND_3_MAX)
-        return 3;
-    if (hz < WATER_BAND_4_MIN)
-        return (last_state == 3) ? 3 : 4;
-    return 4;
-}
+#define CLIMATE_VENT_SEC 300         // Ventilate this long past the last out-of-range reading
+#define SCHED_ALERT_COOLDOWN 120     // At most one alert per schedule every 2 min
+#define SAFETY_REPORT_INTERVAL 3600  // Print auto-off overshoot histogram hourly
+#define COMMAND_POLL_INTERVAL 2      // Poll device_commands every 2s without Realtime
+#define COMMAND_POLL_FALLBACK 60     // Safety-net poll while Realtime pushes commands
+#define WAIT_SLICE_MS 250            // Capture reaping granularity while waiting on Realtime
+#define CONFIG_REFRESH_DEFAULT 60    // Check thresholds/schedules/rules for changes every 60s (PHYTOPI_CONFIG_REFRESH_SEC)
+#define CONFIG_REFRESH_MIN 2         // Shortest allowed change-check interval
+#define CONFIG_FULL_REFRESH 3600     // Refetch in full at least hourly even if the probe shows no change
 
 /*
  * Sync unsynced readings to Supabase
@@ -118,12 +67,8 @@ void sync_to_supabase(sqlite3 *db, supabase_config_t *supabase_cfg)
 
     printf("Found %d unsynced readings, syncing to Supabase...\n", count);
 
-    // First, count how many Supabase readings we'll need
-    // temp_hum_data: 2, bme680_data: 4, others: 1 each
-    int max_supabase_count = count * 4;
-
     // Convert SQLite readings to Supabase readings
-    supabase_reading_t *supabase_readings = (supabase_reading_t *)malloc(max_supabase_count * sizeof(supabase_reading_t));
+    supabase_reading_t *supabase_readings = (supabase_reading_t *)malloc(count * sizeof(supabase_reading_t));
     if (!supabase_readings)
     {
         fprintf(stderr, "Failed to allocate memory for Supabase readings\n");
@@ -134,138 +79,585 @@ void sync_to_supabase(sqlite3 *db, supabase_config_t *supabase_cfg)
     int supabase_count = 0;
     for (int i = 0; i < count; i++)
     {
-        // Safety check to prevent buffer overflow
-        if (supabase_count >= max_supabase_count)
+        // Map metric -> Supabase sensor through the registry; unmapped metrics stay local
+        sensor_metric_t *sm = sensors_metric(sensors_metric_find(readings[i].metric));
+        if (!sm || !sm->desc->sensor_id || !sm->desc->sensor_id[0])
+            continue;
+        supabase_readings[supabase_count].sensor_id = (char *)sm->desc->sensor_id;
+        supabase_readings[supabase_count].value = readings[i].value;
+        supabase_readings[supabase_count].unit = (char *)sm->desc->unit;
+        supabase_readings[supabase_count].timestamp = readings[i].timestamp;
+        supabase_readings[supabase_count].metadata = NULL;
+        supabase_count++;
+    }
+
+    // Send in batches
+    int sent = 0;
+    int all_sent = 1;
+
+    while (sent < supabase_count)
+    {
+        int batch_size = (supabase_count - sent > BATCH_SIZE) ? BATCH_SIZE : (supabase_count - sent);
+
+        if (supabase_send_batch(supabase_cfg, &supabase_readings[sent], batch_size) == 0)
         {
-            fprintf(stderr, "Warning: Reached maximum Supabase readings limit, some readings may be skipped\n");
+            sent += batch_size;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to sync batch, will retry later\n");
+            all_sent = 0;
             break;
         }
+    }
 
-        // Map based on table name
-        if (strcmp(readings[i].table_name, "temp_hum_data") == 0)
+    // Mark all readings as synced only if all were successfully sent
+    if (all_sent)
+    {
+        for (int i = 0; i < count; i++)
         {
-            // Humidity reading
-            if (humidity_sensor_id && supabase_count < max_supabase_count)
-            {
-                supabase_readings[supabase_count].sensor_id = humidity_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value1;
-                supabase_readings[supabase_count].unit = "percent";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
-
-                // Temperature reading
-                if (temperature_sensor_id && supabase_count < max_supabase_count)
-                {
-                    supabase_readings[supabase_count].sensor_id = temperature_sensor_id;
-                    supabase_readings[supabase_count].value = readings[i].value2;
-                    supabase_readings[supabase_count].unit = "celsius";
-                    supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                    supabase_readings[supabase_count].metadata = NULL;
-                    supabase_count++;
-                }
-            }
+            sql_mark_as_synced(db, "sensor_readings", readings[i].id);
+        }
+        printf("Marked %d readings as synced\n", count);
+    }
+
+    free(supabase_readings);
+    free(readings);
+}
+
+/*
+ * Queue an alert in the SQLite outbox; sync_alerts() delivers it.
+ * Returns 0 once the alert is stored.
+ */
+static int queue_alert(sqlite3 *db, const char *type, const char *message, const char *severity,
+                       const char *source)
+{
+    return sql_alert_enqueue(db, type, message, severity, source, (int64_t)time(NULL)) == SQLITE_OK ? 0 : -1;
+}
+
+/*
+ * Deliver queued alerts oldest first in batched POSTs. A failed batch stays
+ * queued and is retried with backoff; a rejected batch is resent one alert at
+ * a time so a single bad row cannot block the queue.
+ */
+static void sync_alerts(sqlite3 *db, supabase_config_t *cfg)
+{
+    static wheel_timer_t retry;
+    static int backoff = SYNC_INTERVAL;
+    if (!cfg->device_id || timer_wheel_pending(&retry))
+        return;
+
+    for (;;)
+    {
+        sqlite_alert_t *queued = NULL;
+        int count = 0;
+        if (sql_get_queued_alerts(db, &queued, &count, ALERT_BATCH_SIZE) != 0 || count == 0)
+        {
+            free(queued);
+            break;
         }
-        else if (strcmp(readings[i].table_name, "soil_moisture_data") == 0)
+        supabase_alert_t batch[ALERT_BATCH_SIZE];
+        for (int i = 0; i < count; i++)
         {
-            if (soil_moisture_sensor_id && supabase_count < max_supabase_count)
-            {
-                supabase_readings[supabase_count].sensor_id = soil_moisture_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value1;
-                supabase_readings[supabase_count].unit = "percent";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
-            }
+            batch[i].type = queued[i].type;
+            batch[i].message = queued[i].message;
+            batch[i].severity = queued[i].severity;
+            batch[i].source = queued[i].source;
+            batch[i].timestamp = queued[i].timestamp;
         }
-        else if (strcmp(readings[i].table_name, "bme680_data") == 0)
+
+        int rc = supabase_insert_alerts(cfg, cfg->device_id, batch, count);
+        if (rc == -2)
         {
-            if (temperature_sensor_id && supabase_count < max_supabase_count)
-            {
-                supabase_readings[supabase_count].sensor_id = temperature_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value1;
-                supabase_readings[supabase_count].unit = "celsius";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
-            }
-            if (humidity_sensor_id && supabase_count < max_supabase_count)
-            {
-                supabase_readings[supabase_count].sensor_id = humidity_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value2;
-                supabase_readings[supabase_count].unit = "percent";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
-            }
-            if (pressure_sensor_id && supabase_count < max_supabase_count)
-            {
-                supabase_readings[supabase_count].sensor_id = pressure_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value3;
-                supabase_readings[supabase_count].unit = "hPa";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
-            }
-            if (gas_sensor_id && supabase_count < max_supabase_count)
+            rc = 0;
+            for (int i = 0; i < count && rc == 0; i++)
             {
-                supabase_readings[supabase_count].sensor_id = gas_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value4;
-                supabase_readings[supabase_count].unit = "kOhm";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
+                int one = supabase_insert_alerts(cfg, cfg->device_id, &batch[i], 1);
+                if (one == -2)
+                    fprintf(stderr, "  [Alerts] Dropping rejected alert %s: %s\n", queued[i].type, queued[i].message);
+                if (one == -1)
+                    rc = -1;
+                else
+                    sql_delete_alerts_upto(db, queued[i].id);
             }
         }
-        else if (strcmp(readings[i].table_name, "water_level_photoelectric") == 0)
+        else if (rc == 0)
         {
-            if (water_level_photoelectric_sensor_id && supabase_count < max_supabase_count)
-            {
-                supabase_readings[supabase_count].sensor_id = water_level_photoelectric_sensor_id;
-                supabase_readings[supabase_count].value = readings[i].value1; /* 0-4 state */
-                supabase_readings[supabase_count].unit = "level";
-                supabase_readings[supabase_count].timestamp = readings[i].timestamp;
-                supabase_readings[supabase_count].metadata = NULL;
-                supabase_count++;
-            }
+            sql_delete_alerts_upto(db, queued[count - 1].id);
+            printf("  [Alerts] Delivered %d alert(s)\n", count);
         }
+        free(queued);
+
+        if (rc != 0)
+        {
+            fprintf(stderr, "  [Alerts] Delivery failed, retrying in %ds\n", backoff);
+            timer_wheel_add(&retry, time(NULL) + backoff);
+            if (backoff < ALERT_RETRY_MAX)
+                backoff *= 2;
+            return;
+        }
+        if (count < ALERT_BATCH_SIZE)
+            break;
     }
+    backoff = SYNC_INTERVAL;
+}
 
-    if (supabase_count > 0)
+/*
+ * Local reaction to an out-of-range climate metric: keep the fans running
+ * until CLIMATE_VENT_SEC after the last exceeded reading. Runs at sensor rate
+ * whether or not the alert gets queued or delivered.
+ */
+static void climate_ventilate(device_state_t *st)
+{
+    /* Fans already on without a deadline (command or schedule): leave them */
+    if (st->fan_duty >= FAN_MIN_DUTY_WHEN_ON && !safety_armed(SAFETY_FANS))
+        return;
+    safety_arm(SAFETY_FANS, CLIMATE_VENT_SEC);
+    if (st->fan_duty >= FAN_MIN_DUTY_WHEN_ON)
+        return;
+    if (fans_init() == 0 && fans_set_both(FAN_MIN_DUTY_WHEN_ON) == 0)
     {
-        // Send in batches
-        int sent = 0;
-        int all_sent = 1;
+        st->fan_duty = FAN_MIN_DUTY_WHEN_ON;
+        state_save(STATE_PATH, st);
+        actuator_state_mark(ASTATE_FAN_DUTY, st->fan_duty);
+        printf("  [Thresholds] Ventilation ON for climate\n");
+    }
+}
 
-        while (sent < supabase_count)
-        {
-            int batch_size = (supabase_count - sent > BATCH_SIZE) ? BATCH_SIZE : (supabase_count - sent);
+/* Helper: live value of a registry metric, NAN if unknown or invalid */
+static double metric_value(int idx)
+{
+    const sensor_metric_t *sm = idx >= 0 ? sensors_metric(idx) : NULL;
+    return (sm && sm->valid) ? sm->value : NAN;
+}
+
+/*
+ * Closed-loop fan step on a fresh BME680 sample. A timed run (command or
+ * schedule) keeps the fans until its deadline; the loop then resumes from the
+ * duty it left.
+ */
+static void fan_control_step(device_state_t *st, time_t sample_ts, int temp_metric, int humidity_metric)
+{
+    if (safety_armed(SAFETY_FANS))
+    {
+        fan_control_hold();
+        return;
+    }
+    int duty = fan_control_update(sample_ts, metric_value(temp_metric), metric_value(humidity_metric), st->fan_duty);
+    if (duty < 0)
+        return;
+    if (fans_init() != 0 || fans_set_both(duty) != 0)
+    {
+        fprintf(stderr, "  [Fan control] init or fans_set failed\n");
+        return;
+    }
+    st->fan_duty = duty;
+    state_save(STATE_PATH, st);
+    actuator_state_mark(ASTATE_FAN_DUTY, duty);
+}
+
+/*
+ * Acknowledge a capture_image command once its child process has exited
+ */
+static void on_capture_done(const char *command_id, int ok, void *ctx)
+{
+    /* The journal's ack thread reports the outcome to Supabase */
+    if (journal_record(command_id, ok ? "executed" : "failed", ok ? NULL : "capture failed or timed out") != 0)
+        fprintf(stderr, "capture: failed to journal command %s\n", command_id);
+}
+
+/* State the command handlers act on */
+typedef struct {
+    supabase_config_t *cfg;
+    device_state_t *state;
+    int *lights_on;
+    int *pump_on;
+} command_ctx_t;
+
+static command_result_t run_toggle_light(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    command_ctx_t *c = (command_ctx_t *)ctx;
+    int desired = cmd->args.sw.state;
+    int duration_sec = cmd->args.sw.duration_sec;
+    safety_arm(SAFETY_LIGHTS, desired ? duration_sec : 0);
+    if (lights_init() != 0 || lights_set(desired) != 0)
+    {
+        snprintf(err, err_len, "lights GPIO write failed");
+        return CMD_FAILED;
+    }
+    *c->lights_on = desired;
+    c->state->lights_on = desired;
+    state_save(STATE_PATH, c->state); // Persist state
+    printf("  -> Lights %s (duration=%ds, auto-off=%s)\n",
+           desired ? "ON" : "OFF", duration_sec,
+           safety_armed(SAFETY_LIGHTS) ? "yes" : "no");
+    actuator_state_mark(ASTATE_LIGHTS, desired);
+    return CMD_EXECUTED;
+}
+
+/*
+ * Helper: after a failed pump start, tell a dry-run interlock refusal from a
+ * GPIO failure. A refusal disarms the auto-off armed for the run and is logged.
+ */
+static int pump_refused(int on)
+{
+    if (!on || !pump_locked_out())
+        return 0;
+    safety_arm(SAFETY_PUMP, 0);
+    interlock_refused();
+    return 1;
+}
+
+static command_result_t run_toggle_pump(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    command_ctx_t *c = (command_ctx_t *)ctx;
+    int desired = cmd->args.sw.state;
+    int duration_sec = cmd->args.sw.duration_sec;
+    safety_arm(SAFETY_PUMP, desired ? duration_sec : 0);
+    if (pump_init() != 0)
+    {
+        snprintf(err, err_len, "pump_init() failed - check GPIO permissions and wiring");
+        return CMD_FAILED;
+    }
+    if (pump_set(desired) != 0)
+    {
+        if (pump_refused(desired))
+            snprintf(err, err_len, "pump interlocked: reservoir empty");
+        else
+            snprintf(err, err_len, "pump_set(%d) failed", desired);
+        return CMD_FAILED;
+    }
+    *c->pump_on = desired;
+    c->state->pump_on = desired;
+    state_save(STATE_PATH, c->state); // Persist state
+    printf("  -> Pump %s (duration=%ds, auto-off=%s)\n",
+           desired ? "ON" : "OFF", duration_sec,
+           safety_armed(SAFETY_PUMP) ? "yes" : "no");
+    actuator_state_mark(ASTATE_PUMP, desired);
+    return CMD_EXECUTED;
+}
+
+static command_result_t run_toggle_fans(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    command_ctx_t *c = (command_ctx_t *)ctx;
+    if (fans_init() != 0)
+    {
+        snprintf(err, err_len, "fans_init() failed");
+        return CMD_FAILED;
+    }
+    /* Avoid 0% when "on" requested - use minimum duty */
+    int duty = cmd->args.sw.state ? FAN_MIN_DUTY_WHEN_ON : 0;
+    if (fans_set_both(duty) != 0)
+    {
+        snprintf(err, err_len, "fan PWM write failed");
+        return CMD_FAILED;
+    }
+    c->state->fan_duty = duty;
+    state_save(STATE_PATH, c->state);
+    actuator_state_mark(ASTATE_FAN_DUTY, duty);
+    return CMD_EXECUTED;
+}
+
+static command_result_t run_ventilation(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    command_ctx_t *c = (command_ctx_t *)ctx;
+    int duty = cmd->args.vent.duty_percent > 0 ? cmd->args.vent.duty_percent : FAN_MIN_DUTY_WHEN_ON;
+    safety_arm(SAFETY_FANS, cmd->args.vent.duration_sec);
+    if (fans_init() != 0)
+    {
+        safety_arm(SAFETY_FANS, 0);
+        snprintf(err, err_len, "fans_init() failed");
+        return CMD_FAILED;
+    }
+    if (fans_set_both(duty) != 0)
+    {
+        /* The fans never started, so there is nothing to switch off later */
+        safety_arm(SAFETY_FANS, 0);
+        snprintf(err, err_len, "fan PWM write failed");
+        return CMD_FAILED;
+    }
+    c->state->fan_duty = duty;
+    state_save(STATE_PATH, c->state);
+    actuator_state_mark(ASTATE_FAN_DUTY, duty);
+    return CMD_EXECUTED;
+}
+
+static command_result_t run_set_fan_speed(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    command_ctx_t *c = (command_ctx_t *)ctx;
+    if (fans_init() != 0 || fans_set_speed(cmd->args.fan.fan_id, cmd->args.fan.duty_percent) != 0)
+    {
+        snprintf(err, err_len, "fan %d PWM write failed", cmd->args.fan.fan_id);
+        return CMD_FAILED;
+    }
+    c->state->fan_duty = cmd->args.fan.duty_percent; // approximation — both fans assumed same duty
+    state_save(STATE_PATH, c->state);
+    actuator_state_mark(ASTATE_FAN_DUTY, cmd->args.fan.duty_percent);
+    return CMD_EXECUTED;
+}
 
-            if (supabase_send_batch(supabase_cfg, &supabase_readings[sent], batch_size) == 0)
+static command_result_t run_capture_image(const device_command_t *cmd, void *ctx, char *err, size_t err_len)
+{
+    command_ctx_t *c = (command_ctx_t *)ctx;
+    if (!c->cfg->device_id)
+    {
+        snprintf(err, err_len, "SUPABASE_DEVICE_ID not set on the controller");
+        return CMD_FAILED;
+    }
+    /* Acknowledged by on_capture_done() when the job finishes */
+    if (capture_start(cmd->id, c->cfg->device_id) != 0)
+    {
+        snprintf(err, err_len, "capture could not be started");
+        return CMD_FAILED;
+    }
+    return CMD_RUNNING;
+}
+
+/* New command types only need a handler and a line here */
+static void register_commands(void)
+{
+    command_register("toggle_light", command_decode_switch, run_toggle_light);
+    command_register("toggle_pump", command_decode_switch, run_toggle_pump);
+    command_register("toggle_fans", command_decode_switch, run_toggle_fans);
+    command_register("run_ventilation", command_decode_ventilation, run_ventilation);
+    command_register("set_fan_speed", command_decode_fan_speed, run_set_fan_speed);
+    command_register("capture_image", NULL, run_capture_image);
+}
+
+/*
+ * Wait out the tick. Finished captures are reaped as they exit and, while the
+ * Realtime channel is joined, a pushed command ends the wait early.
+ */
+static void wait_tick(int seconds)
+{
+    realtime_poll(0); /* reconnects, join replies, heartbeats */
+#ifndef PHYTOPI_SIM
+    if (realtime_connected())
+    {
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (;;)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long left = seconds * 1000L - ((now.tv_sec - start.tv_sec) * 1000L + (now.tv_nsec - start.tv_nsec) / 1000000L);
+            if (left <= 0)
+                return;
+            if (capture_active())
             {
-                sent += batch_size;
+                capture_poll(0);
+                if (left > WAIT_SLICE_MS)
+                    left = WAIT_SLICE_MS;
             }
+            if (realtime_poll((int)left) != 0)
+                return;
+        }
+    }
+#endif
+    if (capture_active())
+        capture_poll(seconds * 1000);
+    else
+        sleep(seconds);
+}
+
+/* Version of a config table as of its last full fetch */
+typedef struct {
+    supabase_version_t seen;
+    supabase_version_t probed;
+    time_t last_full;
+} config_version_t;
+
+/*
+ * Probe a config table and decide whether it must be refetched: its newest
+ * updated_at or row count moved, or CONFIG_FULL_REFRESH passed since the last
+ * full fetch. Returns 1 to fetch, 0 if unchanged, -1 if the probe failed.
+ */
+static int config_changed(supabase_config_t *cfg, const char *table, config_version_t *ver, time_t now)
+{
+    if (supabase_fetch_version(cfg, table, &ver->probed) != 0)
+        return -1;
+    if (ver->last_full == 0 || now - ver->last_full >= CONFIG_FULL_REFRESH)
+        return 1;
+    return ver->probed.count != ver->seen.count || strcmp(ver->probed.updated_at, ver->seen.updated_at) != 0;
+}
+
+/* Record a successful full fetch at the version probed just before it */
+static void config_fetched(config_version_t *ver, time_t now)
+{
+    ver->seen = ver->probed;
+    ver->last_full = now;
+}
+
+/*
+ * Apply one due schedule. Each schedule keeps a timer on the loop's timer
+ * wheel armed at its next fire time and is handed here by scheduler_take_due()
+ * once that timer expires. The schedules come from the SQLite-backed cache, so
+ * they keep firing without a connection; alerts and last_run_at updates are
+ * only sent when online.
+ */
+static void run_schedule(sqlite3 *db, command_ctx_t *c, int online, const device_schedule_t *sched, time_t now)
+{
+    json_object *pl = json_tokener_parse(sched->payload_json);
+    int state = 1, duration = 0, duty = 80;
+    if (pl)
+    {
+        json_object *st = NULL, *du = NULL, *dt = NULL;
+        if (json_object_object_get_ex(pl, "state", &st))
+            state = json_object_get_boolean(st) ? 1 : 0;
+        if (json_object_object_get_ex(pl, "duration_sec", &du))
+            duration = json_object_get_int(du);
+        if (json_object_object_get_ex(pl, "duty_percent", &dt))
+            duty = json_object_get_int(dt);
+        json_object_put(pl);
+    }
+    int sched_applied = 0;
+    const char *alert_type = "schedule";
+    char alert_msg[192];
+
+    if (strcmp(sched->schedule_type, "lights") == 0)
+    {
+        safety_arm(SAFETY_LIGHTS, state ? duration : 0);
+        if (lights_init() == 0 && lights_set(state) == 0)
+        {
+            c->state->lights_on = state;
+            *c->lights_on = state;
+            if (safety_armed(SAFETY_LIGHTS))
+                printf("  -> Lights ON (auto-off in %ds) [schedule]\n", duration);
             else
+                printf("  -> Lights %s [schedule]\n", state ? "ON" : "OFF");
+            alert_type = "schedule_lights";
+            if (state)
             {
-                fprintf(stderr, "Failed to sync batch, will retry later\n");
-                all_sent = 0;
-                break;
+                if (safety_armed(SAFETY_LIGHTS))
+                    snprintf(alert_msg, sizeof(alert_msg),
+                             "Scheduled: Grow lights ON (auto-off in %d s)", duration);
+                else
+                    snprintf(alert_msg, sizeof(alert_msg),
+                             "Scheduled: Grow lights ON");
             }
+            else
+                snprintf(alert_msg, sizeof(alert_msg),
+                         "Scheduled: Grow lights OFF");
+            sched_applied = 1;
         }
+        else
+            fprintf(stderr, "  [Schedule] lights: init or GPIO failed\n");
+    }
+    else if (strcmp(sched->schedule_type, "pump") == 0)
+    {
+        safety_arm(SAFETY_PUMP, state ? duration : 0);
+        if (pump_init() == 0 && pump_set(state) == 0)
+        {
+            c->state->pump_on = state;
+            *c->pump_on = state;
+            printf("  -> Pump %s [schedule]\n", state ? "ON" : "OFF");
+            alert_type = "schedule_pump";
+            snprintf(alert_msg, sizeof(alert_msg), "Scheduled: Pump turned %s",
+                     state ? "ON" : "OFF");
+            sched_applied = 1;
+        }
+        else if (pump_refused(state))
+            fprintf(stderr, "  [Schedule] pump: refused, reservoir empty\n");
+        else
+            fprintf(stderr, "  [Schedule] pump: init or GPIO failed\n");
+    }
+    else if (strcmp(sched->schedule_type, "ventilation") == 0)
+    {
+        int fan_duty_target = state ? (duty > 0 ? duty : FAN_MIN_DUTY_WHEN_ON) : 0;
+        safety_arm(SAFETY_FANS, state ? duration : 0);
+        if (fans_init() == 0 && fans_set_both(fan_duty_target) == 0)
+        {
+            c->state->fan_duty = fan_duty_target;
+            printf("  -> Ventilation %s [schedule] (duty=%d%%)\n",
+                   state ? "ON" : "OFF", fan_duty_target);
+            alert_type = "schedule_ventilation";
+            if (state)
+                snprintf(alert_msg, sizeof(alert_msg),
+                         "Scheduled: Ventilation ON at %d%%",
+                         fan_duty_target);
+            else
+                snprintf(alert_msg, sizeof(alert_msg),
+                         "Scheduled: Ventilation OFF");
+            sched_applied = 1;
+        }
+        else
+            fprintf(stderr, "  [Schedule] ventilation: init or fans_set failed\n");
+    }
+
+    if (sched_applied)
+    {
+        state_save(STATE_PATH, c->state);
+        actuator_state_mark(ASTATE_LIGHTS, c->state->lights_on);
+        actuator_state_mark(ASTATE_PUMP, c->state->pump_on);
+        actuator_state_mark(ASTATE_FAN_DUTY, c->state->fan_duty);
+
+        /* At most one alert per schedule id per cooldown window */
+        if (online && scheduler_alert_due(sched->id, now, SCHED_ALERT_COOLDOWN))
+        {
+            if (queue_alert(db, alert_type, alert_msg, "low", "scheduled") == 0)
+                scheduler_alerted(sched->id, now);
+        }
+
+        if (online)
+            supabase_update_schedule_last_run(c->cfg, sched->id);
+    }
+}
+
+/*
+ * Apply an automation rule output that changed this tick. Switching on arms
+ * the rule's max_on_sec auto-off (none if 0); switching off disarms it.
+ * Returns 0 once applied, 1 if the pump interlock refused it, -1 on failure.
+ */
+static int apply_rule(command_ctx_t *c, rule_actuator_t act, const rule_output_t *out)
+{
+    const rule_t *r = rules_rule(out->rule);
+    const char *by = r ? r->id : "released";
+    int on = out->level != 0;
 
-        // Mark all readings as synced only if all were successfully sent
-        if (all_sent)
+    if (act == RULE_LIGHTS)
+    {
+        safety_arm(SAFETY_LIGHTS, on ? out->max_on_sec : 0);
+        if (lights_init() != 0 || lights_set(on) != 0)
+        {
+            fprintf(stderr, "  [Rules] lights: init or GPIO failed\n");
+            return -1;
+        }
+        c->state->lights_on = on;
+        *c->lights_on = on;
+        actuator_state_mark(ASTATE_LIGHTS, on);
+        printf("  -> Lights %s [rule %s]\n", on ? "ON" : "OFF", by);
+    }
+    else if (act == RULE_PUMP)
+    {
+        safety_arm(SAFETY_PUMP, on ? out->max_on_sec : 0);
+        if (pump_init() != 0 || pump_set(on) != 0)
         {
-            for (int i = 0; i < count; i++)
+            if (pump_refused(on))
             {
-                sql_mark_as_synced(db, readings[i].table_name, readings[i].id);
+                fprintf(stderr, "  [Rules] pump: refused for %s, reservoir empty\n", by);
+                return 1;
             }
-            printf("Marked %d readings as synced\n", count);
+            fprintf(stderr, "  [Rules] pump: init or GPIO failed\n");
+            return -1;
         }
+        c->state->pump_on = on;
+        *c->pump_on = on;
+        actuator_state_mark(ASTATE_PUMP, on);
+        printf("  -> Pump %s [rule %s]\n", on ? "ON" : "OFF", by);
     }
-
-    free(supabase_readings);
-    free(readings);
+    else
+    {
+        safety_arm(SAFETY_FANS, on ? out->max_on_sec : 0);
+        if (fans_init() != 0 || fans_set_both(out->level) != 0)
+        {
+            fprintf(stderr, "  [Rules] fans: init or fans_set failed\n");
+            return -1;
+        }
+        c->state->fan_duty = out->level;
+        actuator_state_mark(ASTATE_FAN_DUTY, out->level);
+        printf("  -> Fans %d%% [rule %s]\n", out->level, by);
+    }
+    state_save(STATE_PATH, c->state);
+    return 0;
 }
 
 int main()
@@ -273,25 +665,41 @@ int main()
     setvbuf(stdout, NULL, _IONBF, 0);
     setvbuf(stderr, NULL, _IONBF, 0);
 
-    /* I2C / hardware */
-    int fd = i2c_init("/dev/i2c-1");
-    if (fd < 0)
+    device_state_t dev_state;
+    state_load(STATE_PATH, &dev_state);
+
+    /* Sensors: every driver declares its metrics once in the registry */
+    sensor_drivers_register_builtin(&dev_state.fan_duty);
+    sensors_init();
+    sensor_driver_t *bme_drv = sensors_driver_find("bme680");
+    sensor_driver_t *soil_drv = sensors_driver_find("soil");
+    if (bme_drv && !bme_drv->init_ok)
+        fprintf(stderr, "Warning: BME680 init failed. Temp/humidity/pressure/gas disabled.\n");
+    if (soil_drv && !soil_drv->init_ok)
     {
-        fprintf(stderr, "Warning: I2C bus init failed. Soil moisture disabled.\n");
+        fprintf(stderr, "Warning: Soil probe setup failed. Soil moisture disabled.\n");
         fprintf(stderr, "Enable: sudo raspi-config -> Interface Options -> I2C\n");
     }
-    int bme680_ok = (bme680_init() == 0);
-    if (!bme680_ok)
-        fprintf(stderr, "Warning: BME680 init failed. Temp/humidity/pressure/gas disabled.\n");
 
-    device_state_t dev_state;
-    state_load(STATE_PATH, &dev_state);
-
-    /* Apply persisted state to hardware on startup */
-    if (dev_state.lights_on && lights_init() == 0)
-        lights_set(dev_state.lights_on);
-    if (dev_state.pump_on && pump_init() == 0)
-        pump_set(dev_state.pump_on);
+    /* Closed-loop fans (PHYTOPI_FAN_MODE) follow every BME680 sample */
+    fan_control_init();
+    int temp_metric = sensors_metric_find("temp_c");
+    int humidity_metric = sensors_metric_find("humidity");
+    time_t fan_sample_ts = 0;
+    int pump_rule_refused = 0;
+
+    /* The dry-run interlock judges the reservoir before the pump can be restored */
+    interlock_start();
+
+    /* Apply persisted state to hardware on startup (lights and pump in one request) */
+    if (actuators_init() == 0)
+        actuators_set(ACT_LIGHTS | ACT_PUMP,
+                      (dev_state.lights_on ? ACT_LIGHTS : 0) | (dev_state.pump_on ? ACT_PUMP : 0));
+    if (pump_refused(dev_state.pump_on))
+    {
+        dev_state.pump_on = 0;
+        state_save(STATE_PATH, &dev_state);
+    }
     if (dev_state.fan_duty > 0 && fans_init() == 0)
         fans_set_both(dev_state.fan_duty);
 
@@ -333,12 +741,6 @@ int main()
     supabase_cfg.api_url = getenv("SUPABASE_URL");
     supabase_cfg.api_key = getenv("SUPABASE_ANON_KEY");
     supabase_cfg.device_id = getenv("SUPABASE_DEVICE_ID");
-    humidity_sensor_id = getenv("SUPABASE_HUMIDITY_SENSOR_ID");
-    temperature_sensor_id = getenv("SUPABASE_TEMPERATURE_SENSOR_ID");
-    soil_moisture_sensor_id = getenv("SUPABASE_SOIL_MOISTURE_SENSOR_ID");
-    pressure_sensor_id = getenv("SUPABASE_PRESSURE_SENSOR_ID");
-    gas_sensor_id = getenv("SUPABASE_GAS_SENSOR_ID");
-    water_level_photoelectric_sensor_id = getenv("SUPABASE_WATER_LEVEL_PHOTOELECTRIC_SENSOR_ID");
 
     int supabase_enabled = 0;
     if (supabase_cfg.api_url && supabase_cfg.api_key)
@@ -354,760 +756,360 @@ int main()
     else
         printf("Supabase not configured, using local storage only\n");
 
-    /* SQL templates */
-    const char *sql_soil_moisture = "INSERT INTO soil_moisture_data (humidity, timestamp) VALUES (?, ?);";
-    const char *sql_water_photo = "INSERT INTO water_level_photoelectric (frequency_hz, timestamp) VALUES (?, ?);";
+    /* capture_image jobs run in the background and are acknowledged on exit */
+    capture_init(on_capture_done, &supabase_cfg);
+
+    register_commands();
+    if (supabase_enabled && journal_init(sqlite3_db_filename(db, "main"), &supabase_cfg) != 0)
+        fprintf(stderr, "Command journal unavailable, commands will be reported failed\n");
+    command_ctx_t cmd_ctx = {&supabase_cfg, &dev_state, &lights_on, &pump_on};
 
-    int soil_adc_max = 150;
-    const char *soil_max_env = getenv("SOIL_ADC_MAX");
-    if (soil_max_env && soil_max_env[0])
+    /* Commands are pushed over Realtime when available; polling stays as a fallback */
+    if (supabase_enabled)
+        realtime_init(&supabase_cfg);
+
+    /* Config changes propagate within config_refresh seconds; a check costs one tiny request per table */
+    int config_refresh = CONFIG_REFRESH_DEFAULT;
+    const char *refresh_env = getenv("PHYTOPI_CONFIG_REFRESH_SEC");
+    if (refresh_env && atoi(refresh_env) > 0)
+        config_refresh = atoi(refresh_env) < CONFIG_REFRESH_MIN ? CONFIG_REFRESH_MIN : atoi(refresh_env);
+    config_version_t thr_version = {0};
+    config_version_t sched_version = {0};
+    config_version_t rule_version = {0};
+
+    /* Start from the last fetched thresholds and schedules; Supabase refreshes them later */
+    device_threshold_t *stored_thr = NULL;
+    int stored_thr_count = 0;
+    if (sql_load_thresholds(db, &stored_thr, &stored_thr_count) == 0 && stored_thr_count > 0)
     {
-        int v = atoi(soil_max_env);
-        if (v >= 1 && v <= 255)
-            soil_adc_max = v;
+        thresholds_compile(stored_thr, stored_thr_count);
+        printf("  [Thresholds] Loaded %d cached threshold(s)\n", thresholds_count());
     }
-
-    /* Loop timing */
-    time_t last_sync = time(NULL);
-    time_t last_command_poll = time(NULL);
-    time_t last_threshold_fetch = 0;
-    time_t last_schedule_fetch = 0;
-    time_t last_bme_read = 0;
-
-    /* Actuator state */
-    time_t lights_off_at = 0;
-    time_t pump_off_at = 0;
-    time_t ventilation_off_at = 0;
-
-    /* BME680 live readings and deadband state */
-    float bme_temp = -999, bme_hum = -999;
-    float bme_pressure = -999, bme_gas = -999;
-    float last_bme_temp = -999, last_bme_hum = -999;
-    float last_bme_pressure = -999, last_bme_gas = -999;
-    time_t last_bme_ts = 0;
-
-    /* Soil moisture: raw ADC and stored/synced percent (0–100) */
-    int soil_raw = -1;
-    int soil_moisture_pct = -1;
-    int last_soil_moisture_pct = -999;
-    time_t last_soil_ts = 0;
-
-    /* Photoelectric water level deadband state */
-    int last_photo_freq = -999;
-    int last_water_state = -1;
-    time_t last_photo_ts = 0;
-
-    /* Sensor health */
-    int bme680_fail_count = 0;
-    int photoelectric_fail_count = 0;
-    time_t last_bme_alert = 0;
-    time_t last_photo_alert = 0;
-    int last_reported_bme_ok = -1;   /* -1 = not yet reported */
-    int last_reported_soil_ok = -1;
-    int initial_state_pushed = 0;
-
-    /* Threshold cache */
-    device_threshold_t *cached_thresholds = NULL;
-    int cached_thr_count = 0;
-    time_t last_thr_alert_temp = 0;
-    time_t last_thr_alert_hum = 0;
-    time_t last_thr_alert_pressure = 0;
-    time_t last_thr_alert_gas = 0;
-    time_t last_thr_alert_water = 0;
-    time_t last_thr_alert_soil = 0;
-    time_t last_thr_alert_fan = 0;
+    free(stored_thr);
+    device_rule_t *stored_rules = NULL;
+    int stored_rule_count = 0;
+    if (sql_load_rules(db, &stored_rules, &stored_rule_count) == 0 && stored_rule_count > 0)
+    {
+        rules_compile(stored_rules, stored_rule_count);
+        printf("  [Rules] Loaded %d cached rule(s)\n", rules_count());
+    }
+    free(stored_rules);
+    device_schedule_t *stored_sched = NULL;
+    int stored_sched_count = 0;
+    timer_wheel_init(time(NULL));
+    scheduler_init(db);
+    if (sql_load_schedules(db, &stored_sched, &stored_sched_count) == 0 && stored_sched_count > 0)
+        printf("  [Schedule] Loaded %d cached schedule(s)\n",
+               scheduler_load(stored_sched, stored_sched_count, time(NULL)));
+    free(stored_sched);
+
+    /* Loop timing: periodic jobs re-arm their wheel timer when they run, and
+     * the loop sleeps until the earliest one (or a schedule) is due */
+    wheel_timer_t sync_timer = {0};
+    wheel_timer_t command_timer = {0};
+    wheel_timer_t config_timer = {0};
+    wheel_timer_t report_timer = {0};
+    timer_wheel_add(&sync_timer, time(NULL) + SYNC_INTERVAL);
+    timer_wheel_add(&command_timer, time(NULL) + COMMAND_POLL_INTERVAL);
+    timer_wheel_add(&config_timer, time(NULL));
+
+    /* Timed auto-off is enforced by the safety thread; the loop only records the result */
+    safety_start();
+    timer_wheel_add(&report_timer, time(NULL) + SAFETY_REPORT_INTERVAL);
 
     while (1)
     {
-        soil_raw = (fd >= 0) ? read_pcf8591_channel(fd, 0) : -1; /* pcf8591 A0 */
-        soil_moisture_pct = (soil_raw >= 0) ? soil_raw_to_percent(soil_raw, soil_adc_max) : -1;
-
         time_t now = time(NULL);
+        timer_wheel_advance(now);
 
-        /* Auto-off actuators when their timer expires */
-        if (lights_off_at && now >= lights_off_at)
+        /* Pick up actuators the safety thread switched off */
+        if (safety_take_fired(SAFETY_LIGHTS))
         {
-            lights_set(0);
             lights_on = 0;
             dev_state.lights_on = 0;
-            lights_off_at = 0;
             state_save(STATE_PATH, &dev_state);
-            if (supabase_enabled)
-                supabase_update_actuator_state(&supabase_cfg, 0, -1, -1, -1, -1);
+            actuator_state_mark(ASTATE_LIGHTS, 0);
         }
-        if (pump_off_at && now >= pump_off_at)
+        if (safety_take_fired(SAFETY_PUMP))
         {
-            pump_set(0);
             pump_on = 0;
             dev_state.pump_on = 0;
-            pump_off_at = 0;
             state_save(STATE_PATH, &dev_state);
-            if (supabase_enabled)
-                supabase_update_actuator_state(&supabase_cfg, -1, 0, -1, -1, -1);
+            actuator_state_mark(ASTATE_PUMP, 0);
         }
-        if (ventilation_off_at && now >= ventilation_off_at)
+        if (safety_take_fired(SAFETY_FANS))
         {
-            fans_set_both(0);
             dev_state.fan_duty = 0;
-            ventilation_off_at = 0;
             state_save(STATE_PATH, &dev_state);
-            if (supabase_enabled)
-                supabase_update_actuator_state(&supabase_cfg, -1, -1, 0, -1, -1);
+            actuator_state_mark(ASTATE_FAN_DUTY, 0);
         }
 
-        // BME680 read (every 3s for stability)
-        if (now - last_bme_read >= 3)
+        /* Record dry-run interlock events; a pump it cut is off in the state too */
+        interlock_event_t iev;
+        while (interlock_take_event(&iev))
         {
-            bme680_data_t bme_data;
-            if (bme680_read(&bme_data) == 0 && bme_data.valid)
-            {
-                bme_temp = bme_data.temperature;
-                bme_hum = bme_data.humidity;
-                bme_pressure = bme_data.pressure;
-                bme_gas = bme_data.gas_resistance;
-                last_bme_read = now;
-                bme680_fail_count = 0;
-            }
-            else
-            {
-                bme680_fail_count++;
-                if (bme680_fail_count % 10 == 0)
-                    fprintf(stderr, "Warning: BME680 read failed (consecutive: %d)\n", bme680_fail_count);
-                /* Invalidate stale readings after 5 consecutive failures so threshold
-                 * evaluation skips them rather than using an outdated cached value. */
-                if (bme680_fail_count >= 5)
-                {
-                    bme_temp = -999;
-                    bme_hum = -999;
-                    bme_pressure = -999;
-                    bme_gas = -999;
-                }
-                if (bme680_fail_count >= SENSOR_FAIL_ALERT_AFTER && supabase_enabled && supabase_cfg.device_id &&
-                    (now - last_bme_alert) >= SENSOR_ALERT_COOLDOWN)
-                {
-                    if (supabase_insert_alert(&supabase_cfg, supabase_cfg.device_id,
-                                              "sensor_failure_bme680", "BME680 sensor unreachable after repeated failures",
-                                              "high", "automated") == 0)
-                        last_bme_alert = now;
-                }
-            }
+            const char *event = interlock_event_name(iev.type);
+            printf("  [Interlock] Pump %s (water %d Hz)\n", event, iev.water_hz);
+            if (sql_log_interlock(db, event, iev.water_hz, (int64_t)iev.timestamp) != SQLITE_OK)
+                fprintf(stderr, "  [Interlock] Failed to record '%s'\n", event);
+            if (iev.type != INTERLOCK_CUT)
+                continue;
+            safety_arm(SAFETY_PUMP, 0);
+            rules_applied(RULE_PUMP, 0); /* a latched pump rule restarts it once the lock releases */
+            pump_on = 0;
+            dev_state.pump_on = 0;
+            state_save(STATE_PATH, &dev_state);
+            actuator_state_mark(ASTATE_PUMP, 0);
+            if (supabase_enabled && supabase_cfg.device_id)
+                queue_alert(db, "pump_interlock", "Pump stopped: reservoir empty - refill before watering",
+                            "high", "automated");
         }
 
-        /* Photoelectric water level — read every 2s on its own timer */
-        int photo_freq = last_photo_freq > 0 ? last_photo_freq : -1;
-        if (now - last_photo_ts >= 2)
+        if (!timer_wheel_pending(&report_timer))
         {
-            if (read_photoelectric_water_level(&photo_freq) != 0 || photo_freq < 0)
-            {
-                photoelectric_fail_count++;
-                if (photoelectric_fail_count >= SENSOR_FAIL_ALERT_AFTER && supabase_enabled &&
-                    supabase_cfg.device_id && (now - last_photo_alert) >= SENSOR_ALERT_COOLDOWN)
-                {
-                    if (supabase_insert_alert(&supabase_cfg, supabase_cfg.device_id,
-                                                "sensor_failure_photoelectric", "Photoelectric water level sensor unreachable",
-                                                "high", "automated") == 0)
-                        last_photo_alert = now;
-                }
-            }
-            else
-                photoelectric_fail_count = 0;
+            safety_report();
+            fan_control_report();
+            timer_wheel_add(&report_timer, now + SAFETY_REPORT_INTERVAL);
         }
 
-        printf("[%ld] L=%d Pump=%d T=%.1fC H=%.1f%% Press=%.1f hPa G=%.1f Soil=%d%% (raw=%d) Photo=%dHz\n",
-               now, lights_on, pump_on, bme_temp, bme_hum, bme_pressure, bme_gas,
-               soil_moisture_pct >= 0 ? soil_moisture_pct : -1, soil_raw, photo_freq);
+        /* Trigger/collect every due sensor driver, then store past-deadband metrics */
+        sensors_poll(now);
 
-        int timestamp = (int)now;
+        char status_prefix[64];
+        snprintf(status_prefix, sizeof(status_prefix), "L=%d Pump=%d", lights_on, pump_on);
+        sensors_print(now, status_prefix);
 
-        // --- Deadband Logic ---
+        sensors_store(db, now);
 
-        // 1. BME680 (temp, humidity, pressure, gas)
-        if (bme_temp > -900 && bme_hum > -900)
+        if (fan_control_enabled() && bme_drv && bme_drv->last_poll != fan_sample_ts)
         {
-            if (fabsf(bme_temp - last_bme_temp) >= THRESH_TEMP ||
-                fabsf(bme_hum - last_bme_hum) >= THRESH_HUM ||
-                fabsf(bme_pressure - last_bme_pressure) >= THRESH_PRESSURE ||
-                fabsf(bme_gas - last_bme_gas) >= THRESH_GAS ||
-                (now - last_bme_ts) >= HEARTBEAT_INTERVAL)
-            {
-                if (sql_execute_insert_bme680(db, bme_temp, bme_hum, bme_pressure, bme_gas, timestamp) == SQLITE_OK)
-                {
-                    printf("  -> Saved BME680 T=%.1f H=%.1f P=%.1f G=%.1f\n", bme_temp, bme_hum, bme_pressure, bme_gas);
-                    last_bme_temp = bme_temp;
-                    last_bme_hum = bme_hum;
-                    last_bme_pressure = bme_pressure;
-                    last_bme_gas = bme_gas;
-                    last_bme_ts = now;
-                }
-            }
+            fan_sample_ts = bme_drv->last_poll;
+            fan_control_step(&dev_state, fan_sample_ts, temp_metric, humidity_metric);
         }
 
-        // 2. Check Soil Moisture (stored as percent 0–100)
-        if (soil_moisture_pct >= 0)
+        /* Sensor failure alerts after repeated consecutive read failures */
+        for (int d = 0; d < sensors_driver_count(); d++)
         {
-            if (abs(soil_moisture_pct - last_soil_moisture_pct) >= THRESH_SOIL ||
-                (now - last_soil_ts) >= HEARTBEAT_INTERVAL)
+            sensor_driver_t *drv = sensors_driver(d);
+            if (drv->fail_alert_type && drv->fail_count >= SENSOR_FAIL_ALERT_AFTER &&
+                supabase_enabled && supabase_cfg.device_id &&
+                (now - drv->last_fail_alert) >= SENSOR_ALERT_COOLDOWN)
             {
-                if (sql_execute_insert(db, sql_soil_moisture, soil_moisture_pct, 0, timestamp) == SQLITE_OK)
-                {
-                    printf("  -> Saved Soil (%%: %d->%d, raw=%d)\n", last_soil_moisture_pct, soil_moisture_pct, soil_raw);
-                    last_soil_moisture_pct = soil_moisture_pct;
-                    last_soil_ts = now;
-                }
+                if (queue_alert(db, drv->fail_alert_type, drv->fail_alert_msg, "high", "automated") == 0)
+                    drv->last_fail_alert = now;
             }
         }
 
-        // 3. Photoelectric water level (5-state with hysteresis)
-        if (photo_freq >= 0)
+        /* Evaluate thresholds every tick, with or without a connection */
+        threshold_hit_t thr_hits[THRESHOLD_MAX_HITS];
+        unsigned thr_actions = 0;
+        int n_thr_hits = thresholds_evaluate(now, &thr_actions, thr_hits, THRESHOLD_MAX_HITS);
+        /* Local reaction first, independent of the alerts below. Closed-loop
+         * control or automation rules on the fans replace the built-in ventilation. */
+        if ((thr_actions & THR_ACT_VENTILATE) && !fan_control_enabled() && !rules_controls(RULE_FANS))
+            climate_ventilate(&dev_state);
+        for (int h = 0; h < n_thr_hits; h++)
         {
-            int water_state = frequency_to_water_state(photo_freq, last_water_state);
-            if (water_state != last_water_state ||
-                abs(photo_freq - last_photo_freq) >= THRESH_PHOTO_WATER ||
-                (now - last_photo_ts) >= HEARTBEAT_INTERVAL)
+            const threshold_rule_t *tr = thresholds_rule(thr_hits[h].rule);
+            double val = thr_hits[h].value;
+            char msg[128];
+            if (tr->water_low)
+                snprintf(msg, sizeof(msg), "Water level is low - refill reservoir (%.0fHz < %.0fHz)", val, tr->min);
+            else if (val < tr->min)
+                snprintf(msg, sizeof(msg), "%s %.1f below minimum %.1f", tr->metric, val, tr->min);
+            else
+                snprintf(msg, sizeof(msg), "%s %.1f above maximum %.1f", tr->metric, val, tr->max);
+            printf("  [Thresholds] EXCEEDED: %s\n", msg);
+            if (!supabase_enabled || !supabase_cfg.device_id)
+                thresholds_alerted(thr_hits[h].rule, now); /* nowhere to send it, just log once per cooldown */
+            else if (queue_alert(db, tr->alert_type, msg, tr->severity, "threshold") == 0)
             {
-                if (sql_execute_insert(db, sql_water_photo, water_state, 0, timestamp) == SQLITE_OK)
-                {
-                    printf("  -> Saved Photo Water state=%d (%dHz)\n", water_state, photo_freq);
-                    last_photo_freq = photo_freq;
-                    last_water_state = water_state;
-                    last_photo_ts = now;
-                }
+                thresholds_alerted(thr_hits[h].rule, now);
+                printf("  [Thresholds] Alert queued for %s\n", tr->metric);
             }
+            else
+            {
+                fprintf(stderr, "  [Thresholds] ERROR: Failed to queue alert for %s\n", tr->metric);
+            }
+        }
+
+        /* Automation rules: apply the actuators whose rule output is not applied yet.
+         * A failed apply is retried next tick; a refused pump start waits for the
+         * interlock to release instead of being refused again every tick. */
+        rule_output_t rule_out[RULE_ACTUATOR_COUNT];
+        unsigned rule_changed = rules_evaluate(now, rule_out);
+        for (int a = 0; a < RULE_ACTUATOR_COUNT; a++)
+        {
+            if (!(rule_changed & (1u << a)) || (a == RULE_FANS && fan_control_enabled()))
+                continue;
+            if (a == RULE_PUMP && pump_rule_refused && rule_out[a].level && pump_locked_out())
+                continue;
+            int applied = apply_rule(&cmd_ctx, (rule_actuator_t)a, &rule_out[a]);
+            if (a == RULE_PUMP)
+                pump_rule_refused = applied > 0;
+            if (applied == 0)
+                rules_applied((rule_actuator_t)a, rule_out[a].level);
         }
 
+        /* Run every schedule whose fire time has come, from the cached set */
+        device_schedule_t due;
+        while (scheduler_take_due(now, &due))
+            run_schedule(db, &cmd_ctx, supabase_enabled && supabase_cfg.device_id, &due, now);
+
         // Sync to Supabase periodically
         if (supabase_enabled)
         {
-            if (now - last_sync >= SYNC_INTERVAL)
+            if (!timer_wheel_pending(&sync_timer))
             {
                 sync_to_supabase(db, &supabase_cfg);
-                last_sync = now;
+                sync_alerts(db, &supabase_cfg);
+                timer_wheel_add(&sync_timer, now + SYNC_INTERVAL);
                 /* Heartbeat for offline detection */
                 if (supabase_cfg.device_id)
                     supabase_heartbeat(&supabase_cfg);
-                /* Push full actuator + sensor health state on first sync and on sensor transitions */
-                if (supabase_cfg.device_id)
-                {
-                    int cur_bme_ok  = (bme680_fail_count < SENSOR_FAIL_ALERT_AFTER) ? 1 : 0;
-                    int cur_soil_ok = (soil_moisture_pct >= 0) ? 1 : 0;
-                    int need_push   = !initial_state_pushed
-                                      || cur_bme_ok  != last_reported_bme_ok
-                                      || cur_soil_ok != last_reported_soil_ok;
-                    if (need_push)
-                    {
-                        if (supabase_update_actuator_state(&supabase_cfg,
-                                lights_on, pump_on, dev_state.fan_duty,
-                                cur_bme_ok, cur_soil_ok) == 0)
-                        {
-                            initial_state_pushed = 1;
-                            last_reported_bme_ok  = cur_bme_ok;
-                            last_reported_soil_ok = cur_soil_ok;
-                        }
-                    }
-                }
+                /* Sensor health is sampled at sync; only transitions (and the first sync) are sent */
+                actuator_state_mark(ASTATE_LIGHTS, lights_on);
+                actuator_state_mark(ASTATE_PUMP, pump_on);
+                actuator_state_mark(ASTATE_FAN_DUTY, dev_state.fan_duty);
+                actuator_state_mark(ASTATE_BME_OK, (bme_drv && bme_drv->fail_count < SENSOR_FAIL_ALERT_AFTER) ? 1 : 0);
+                actuator_state_mark(ASTATE_SOIL_OK, sensors_driver_all_valid(soil_drv));
             }
 
-            // Poll for pending commands
-            if (now - last_command_poll >= 2)
+            // Fetch pending commands when Realtime signals one, else on the poll interval
+            int command_poll_interval = realtime_connected() ? COMMAND_POLL_FALLBACK : COMMAND_POLL_INTERVAL;
+            /* Realtime dropped while the slow fallback poll was armed: poll on the short interval again */
+            if (timer_wheel_pending(&command_timer) && command_timer.expires > now + command_poll_interval)
+                timer_wheel_add(&command_timer, now + command_poll_interval);
+            if (realtime_take_pending() || !timer_wheel_pending(&command_timer))
             {
-                last_command_poll = now;
+                timer_wheel_add(&command_timer, now + command_poll_interval);
+
+                /* One GET drains the queue. Every command is journaled before it runs, so a
+                 * lost acknowledgement never runs it twice; acks go out from the journal thread. */
+                device_command_t *cmds = NULL;
+                int cmd_count = 0;
+                int already_done = 0;
+                fetch_pending_commands(&supabase_cfg, &cmds, &cmd_count);
 
-                device_command_t cmd = {0};
-                while (fetch_next_command(&supabase_cfg, &cmd) > 0)
+                for (int ci = 0; ci < cmd_count; ci++)
                 {
-                    int ok = 0;
-                    if (strcmp(cmd.command_type, "toggle_light") == 0)
+                    if (journal_seen(cmds[ci].id))
                     {
-                        int desired = 0;
-                        int duration_sec = 0;
-                        json_object *obj = json_tokener_parse(cmd.payload_json);
-                        if (obj)
-                        {
-                            json_object *s = NULL, *d = NULL;
-                            if (json_object_object_get_ex(obj, "state", &s))
-                                desired = json_object_get_boolean(s) ? 1 : 0;
-                            if (json_object_object_get_ex(obj, "duration_sec", &d))
-                                duration_sec = json_object_get_int(d);
-                            json_object_put(obj);
-                        }
-                        if (lights_init() == 0 && lights_set(desired) == 0)
-                        {
-                            lights_on = desired;
-                            dev_state.lights_on = desired;
-                            state_save(STATE_PATH, &dev_state); // Persist state
-                            lights_off_at = (desired && duration_sec > 0) ? (time(NULL) + duration_sec) : 0;
-                            ok = 1;
-                            printf("  -> Lights %s (duration=%ds, auto-off=%s)\n",
-                                   desired ? "ON" : "OFF", duration_sec,
-                                   lights_off_at ? "yes" : "no");
-                            supabase_update_actuator_state(&supabase_cfg, desired, -1, -1, -1, -1);
-                        }
-                    }
-                    else if (strcmp(cmd.command_type, "toggle_pump") == 0)
-                    {
-                        int desired = 0;
-                        int duration_sec = 0;
-                        json_object *obj = json_tokener_parse(cmd.payload_json);
-                        if (obj)
-                        {
-                            json_object *s = NULL, *d = NULL;
-                            if (json_object_object_get_ex(obj, "state", &s))
-                                desired = json_object_get_boolean(s) ? 1 : 0;
-                            if (json_object_object_get_ex(obj, "duration_sec", &d))
-                                duration_sec = json_object_get_int(d);
-                            json_object_put(obj);
-                        }
-                        if (pump_init() != 0)
-                        {
-                            fprintf(stderr, "toggle_pump: pump_init() failed - check GPIO permissions and wiring\n");
-                        }
-                        else if (pump_set(desired) != 0)
-                        {
-                            fprintf(stderr, "toggle_pump: pump_set(%d) failed\n", desired);
-                        }
-                        else
-                        {
-                            pump_on = desired;
-                            dev_state.pump_on = desired;
-                            state_save(STATE_PATH, &dev_state); // Persist state
-                            pump_off_at = (desired && duration_sec > 0) ? (time(NULL) + duration_sec) : 0;
-                            ok = 1;
-                            printf("  -> Pump %s (duration=%ds, auto-off=%s)\n",
-                                   desired ? "ON" : "OFF", duration_sec,
-                                   pump_off_at ? "yes" : "no");
-                            supabase_update_actuator_state(&supabase_cfg, -1, desired, -1, -1, -1);
-                        }
-                    }
-                    else if (strcmp(cmd.command_type, "toggle_fans") == 0)
-                    {
-                        int desired = 0;
-                        json_object *obj = json_tokener_parse(cmd.payload_json);
-                        if (obj)
-                        {
-                            json_object *s = NULL;
-                            if (json_object_object_get_ex(obj, "state", &s))
-                                desired = json_object_get_boolean(s) ? 1 : 0;
-                            json_object_put(obj);
-                        }
-                        if (fans_init() == 0)
-                        {
-                            /* Avoid 0% when "on" requested - use minimum duty */
-                            int duty = desired ? FAN_MIN_DUTY_WHEN_ON : 0;
-                            fans_set_both(duty);
-                            dev_state.fan_duty = duty;
-                            state_save(STATE_PATH, &dev_state);
-                            ok = 1;
-                            supabase_update_actuator_state(&supabase_cfg, -1, -1, duty, -1, -1);
-                        }
-                    }
-                    else if (strcmp(cmd.command_type, "run_ventilation") == 0)
-                    {
-                        int duration_sec = 300, duty = 80;
-                        json_object *obj = json_tokener_parse(cmd.payload_json);
-                        if (obj)
-                        {
-                            json_object *d = NULL, *p = NULL;
-                            if (json_object_object_get_ex(obj, "duration_sec", &d))
-                                duration_sec = json_object_get_int(d);
-                            if (json_object_object_get_ex(obj, "duty_percent", &p))
-                                duty = json_object_get_int(p);
-                            if (duty <= 0)
-                                duty = FAN_MIN_DUTY_WHEN_ON;
-                            if (duty > 100)
-                                duty = 100;
-                            json_object_put(obj);
-                        }
-                        if (fans_init() == 0)
-                        {
-                            fans_set_both(duty);
-                            dev_state.fan_duty = duty;
-                            state_save(STATE_PATH, &dev_state);
-                            ventilation_off_at = time(NULL) + duration_sec;
-                            ok = 1;
-                        }
-                    }
-                    else if (strcmp(cmd.command_type, "set_fan_speed") == 0)
-                    {
-                        int fan_id = 1, duty = 0;
-                        json_object *obj = json_tokener_parse(cmd.payload_json);
-                        if (obj)
-                        {
-                            json_object *f = NULL, *d = NULL;
-                            if (json_object_object_get_ex(obj, "fan_id", &f))
-                                fan_id = json_object_get_int(f);
-                            if (json_object_object_get_ex(obj, "duty_percent", &d))
-                                duty = json_object_get_int(d);
-                            json_object_put(obj);
-                        }
-                        if (duty < 0)
-                            duty = 0;
-                        if (duty > 100)
-                            duty = 100;
-                        if (fans_init() == 0 && fans_set_speed(fan_id, duty) == 0)
-                        {
-                            dev_state.fan_duty = duty; // approximation — both fans assumed same duty
-                            state_save(STATE_PATH, &dev_state);
-                            ok = 1;
-                        }
+                        already_done++;
+                        continue;
                     }
-                    else if (strcmp(cmd.command_type, "capture_image") == 0 && supabase_cfg.device_id)
+                    if (journal_record(cmds[ci].id, "started", NULL) != 0)
                     {
-                        const char *script = getenv("CAPTURE_SCRIPT_PATH");
-                        if (!script)
-                            script = "scripts/capture_and_upload.py";
-                        pid_t pid = fork();
-                        if (pid == 0)
-                        {
-                            execl("/usr/bin/python3", "python3", script,
-                                  supabase_cfg.device_id, (char *)NULL);
-                            _exit(127);
-                        }
-                        else if (pid > 0)
-                        {
-                            int status;
-                            waitpid(pid, &status, 0);
-                            ok = (WIFEXITED(status) && WEXITSTATUS(status) == 0);
-                        }
+                        /* Not run twice is only guaranteed with a journal: refuse it upstream */
+                        fprintf(stderr, "Command %s not run: journal write failed\n", cmds[ci].id);
+                        mark_command_failed(&supabase_cfg, cmds[ci].id, "command journal unavailable on device");
+                        continue;
                     }
-
-                    mark_command_processed(&supabase_cfg, cmd.id, ok ? "executed" : "failed");
+                    char reason[CMD_ERROR_LEN];
+                    command_result_t r = command_dispatch(&cmds[ci], &cmd_ctx, reason, sizeof(reason));
+                    if (r == CMD_FAILED)
+                        fprintf(stderr, "Command %s (%s) failed: %s\n", cmds[ci].id, cmds[ci].command_type, reason);
+                    journal_record(cmds[ci].id,
+                                   r == CMD_RUNNING ? "running" : (r == CMD_EXECUTED ? "executed" : "failed"),
+                                   r == CMD_FAILED ? reason : NULL);
                 }
+                /* Still pending upstream: their acknowledgement has not landed yet */
+                if (already_done > 0)
+                    journal_kick();
+                free(cmds);
             }
 
-            /* Refresh threshold cache from Supabase every 60s */
-            if (now - last_threshold_fetch >= 60)
+            /* Refetch thresholds, schedules and rules only when their version probe changed */
+            if (!timer_wheel_pending(&config_timer))
             {
-                last_threshold_fetch = now;
-                device_threshold_t *fetched = NULL;
-                int fetched_count = 0;
-                if (supabase_fetch_thresholds(&supabase_cfg, &fetched, &fetched_count) >= 0 && fetched)
-                {
-                    if (cached_thresholds)
-                        free(cached_thresholds);
-                    cached_thresholds = fetched;
-                    cached_thr_count = fetched_count;
-                    printf("  [Thresholds] Refreshed %d threshold(s) from Supabase\n", cached_thr_count);
-                }
-                else
-                {
-                    fprintf(stderr, "  [Thresholds] Failed to fetch from Supabase (using cached %d)\n", cached_thr_count);
-                }
-            }
-
-            /* Evaluate cached thresholds so spikes are never missed */
-            for (int t = 0; t < cached_thr_count; t++)
-            {
-                if (!cached_thresholds[t].enabled)
-                    continue;
-                double val = -999;
-                time_t *cooldown_ptr = NULL;
-                const char *metric = cached_thresholds[t].metric;
-                int cooldown_seconds = THRESHOLD_ALERT_COOLDOWN;
-                if (strcmp(metric, "temp_c") == 0)
-                {
-                    val = bme_temp;
-                    cooldown_ptr = &last_thr_alert_temp;
-                }
-                else if (strcmp(metric, "humidity") == 0)
-                {
-                    val = bme_hum;
-                    cooldown_ptr = &last_thr_alert_hum;
-                }
-                else if (strcmp(metric, "pressure") == 0)
-                {
-                    val = bme_pressure;
-                    cooldown_ptr = &last_thr_alert_pressure;
-                }
-                else if (strcmp(metric, "gas_resistance") == 0)
-                {
-                    val = bme_gas;
-                    cooldown_ptr = &last_thr_alert_gas;
-                }
-                else if (strcmp(metric, "soil_moisture") == 0)
-                {
-                    if (soil_moisture_pct < 0)
-                        continue;
-                    val = (double)soil_moisture_pct;
-                    cooldown_ptr = &last_thr_alert_soil;
-                }
-                else if (strcmp(metric, "water_level_low") == 0)
-                {
-                    val = (double)photo_freq;
-                    cooldown_ptr = &last_thr_alert_water;
-                    cooldown_seconds = WATER_ALERT_COOLDOWN;
-                }
-                else if (strcmp(metric, "fan_duty") == 0)
-                {
-                    val = (double)dev_state.fan_duty;
-                    cooldown_ptr = &last_thr_alert_fan;
-                }
-                if (val < -900 && strcmp(metric, "water_level_low") != 0)
-                    continue;
-                int exceeded = 0;
-                if (strcmp(metric, "water_level_low") == 0)
+                timer_wheel_add(&config_timer, now + config_refresh);
+                if (config_changed(&supabase_cfg, "device_thresholds", &thr_version, now) > 0)
                 {
-                    double low_hz_cutoff = WATER_LEVEL_LOW_HZ_DEFAULT;
-                    if (cached_thresholds[t].max_value < 1e8)
-                        low_hz_cutoff = cached_thresholds[t].max_value;
-                    else if (cached_thresholds[t].min_value > -1e8)
-                        low_hz_cutoff = cached_thresholds[t].min_value;
-                    exceeded = (photo_freq >= 0 && val < low_hz_cutoff);
-                }
-                else
-                    exceeded = (cached_thresholds[t].min_value > -1e8 && val < cached_thresholds[t].min_value) ||
-                               (cached_thresholds[t].max_value < 1e8 && val > cached_thresholds[t].max_value);
-                if (exceeded && cooldown_ptr && (now - *cooldown_ptr) >= cooldown_seconds)
-                {
-                    char msg[128];
-                    if (strcmp(metric, "water_level_low") == 0)
+                    device_threshold_t *fetched = NULL;
+                    int fetched_count = 0;
+                    if (supabase_fetch_thresholds(&supabase_cfg, &fetched, &fetched_count) >= 0)
                     {
-                        double low_hz_cutoff = WATER_LEVEL_LOW_HZ_DEFAULT;
-                        if (cached_thresholds[t].max_value < 1e8)
-                            low_hz_cutoff = cached_thresholds[t].max_value;
-                        else if (cached_thresholds[t].min_value > -1e8)
-                            low_hz_cutoff = cached_thresholds[t].min_value;
-                        snprintf(msg, sizeof(msg), "Water level is low - refill reservoir (%.0fHz < %.0fHz)", val, low_hz_cutoff);
+                        config_fetched(&thr_version, now);
+                        if (sql_save_thresholds(db, fetched, fetched_count) != SQLITE_OK)
+                            fprintf(stderr, "  [Thresholds] Failed to persist %d threshold(s)\n", fetched_count);
+                        /* Resolve metric names and actions once per refresh, not per evaluation */
+                        if (thresholds_compile(fetched, fetched_count) < 0)
+                            fprintf(stderr, "  [Thresholds] Out of memory compiling thresholds\n");
+                        free(fetched);
+                        printf("  [Thresholds] Refreshed %d threshold(s) from Supabase\n", thresholds_count());
                     }
                     else
-                        snprintf(msg, sizeof(msg), "%s %.1f outside range [%.1f, %.1f]",
-                                 metric, val, cached_thresholds[t].min_value, cached_thresholds[t].max_value);
-                    char alert_type_buf[64];
-                    const char *alert_type =
-                        (strcmp(metric, "water_level_low") == 0)
-                            ? "water_level_low"
-                            : (snprintf(alert_type_buf, sizeof(alert_type_buf), "threshold_%s", metric), alert_type_buf);
-                    const char *severity = (strcmp(metric, "water_level_low") == 0) ? "high" : "medium";
-                    printf("  [Thresholds] EXCEEDED: %s\n", msg);
-                    if (supabase_insert_alert(&supabase_cfg, supabase_cfg.device_id,
-                                              alert_type, msg, severity, "threshold") == 0)
                     {
-                        *cooldown_ptr = now;
-                        printf("  [Thresholds] Alert inserted for %s\n", metric);
-                        if (strcmp(metric, "temp_c") == 0 || strcmp(metric, "humidity") == 0 ||
-                            strcmp(metric, "gas_resistance") == 0)
-                        {
-                            if (fans_init() == 0)
-                            {
-                                fans_set_both(FAN_MIN_DUTY_WHEN_ON);
-                                dev_state.fan_duty = FAN_MIN_DUTY_WHEN_ON;
-                                state_save(STATE_PATH, &dev_state);
-                            }
-                            ventilation_off_at = now + 300;
-                        }
+                        fprintf(stderr, "  [Thresholds] Failed to fetch from Supabase (using cached %d)\n", thresholds_count());
                     }
-                    else
+                }
+                if (config_changed(&supabase_cfg, "schedules", &sched_version, now) > 0)
+                {
+                    device_schedule_t *fetched = NULL;
+                    int fetched_count = 0;
+                    if (supabase_fetch_schedules(&supabase_cfg, &fetched, &fetched_count) >= 0)
                     {
-                        fprintf(stderr, "  [Thresholds] ERROR: Failed to insert alert for %s\n", metric);
+                        config_fetched(&sched_version, now);
+                        if (sql_save_schedules(db, fetched, fetched_count) != SQLITE_OK)
+                            fprintf(stderr, "  [Schedule] Failed to persist %d schedule(s)\n", fetched_count);
+                        printf("  [Schedule] Refreshed %d schedule(s) from Supabase\n",
+                               scheduler_load(fetched, fetched_count, now));
+                        free(fetched);
                     }
                 }
-            }
-
-            /* Schedule evaluation (every 60s) */
-            if (now - last_schedule_fetch >= 60)
-            {
-                last_schedule_fetch = now;
-                device_schedule_t *sched = NULL;
-                int sched_count = 0;
-                if (supabase_fetch_schedules(&supabase_cfg, &sched, &sched_count) >= 0 && sched)
+                if (config_changed(&supabase_cfg, "automation_rules", &rule_version, now) > 0)
                 {
-                    static struct
+                    device_rule_t *fetched = NULL;
+                    int fetched_count = 0;
+                    if (supabase_fetch_rules(&supabase_cfg, &fetched, &fetched_count) >= 0)
                     {
-                        char id[SCHEDULE_ID_LEN];
-                        time_t last_run;
-                    } run_cache[16];
-                    static int run_cache_n = 0;
-                    struct tm *tm_now = localtime(&now);
-                    int min = tm_now ? tm_now->tm_min : 0;
-                    int hour = tm_now ? tm_now->tm_hour : 0;
-                    for (int s = 0; s < sched_count; s++)
-                    {
-                        time_t last_run = 0;
-                        for (int r = 0; r < run_cache_n; r++)
-                            if (strcmp(run_cache[r].id, sched[s].id) == 0)
-                            {
-                                last_run = run_cache[r].last_run;
-                                break;
-                            }
-                        int should_run = 0;
-                        if (sched[s].interval_seconds > 0)
-                            should_run = (now - last_run) >= (time_t)sched[s].interval_seconds;
-                        else if (sched[s].cron_expr[0])
-                        {
-                            int cron_min = -1, cron_hour = -1;
-                            if (sscanf(sched[s].cron_expr, "%d %d", &cron_min, &cron_hour) == 2)
-                                should_run = (min == cron_min && hour == cron_hour && (now - last_run) >= 60);
-                            else if (strncmp(sched[s].cron_expr, "*/", 2) == 0)
-                            {
-                                int n = 0;
-                                sscanf(sched[s].cron_expr + 2, "%d", &n);
-                                if (n > 0)
-                                    should_run = (min % n == 0) && (now - last_run) >= 60;
-                            }
-                        }
-                        if (should_run)
-                        {
-                            static struct
-                            {
-                                char id[SCHEDULE_ID_LEN];
-                                time_t last_alert_at;
-                            } sched_alert_cd[32];
-                            static int sched_alert_cd_n = 0;
-
-                            json_object *pl = json_tokener_parse(sched[s].payload_json);
-                            int state = 1, duration = 0, duty = 80;
-                            if (pl)
-                            {
-                                json_object *st = NULL, *du = NULL, *dt = NULL;
-                                if (json_object_object_get_ex(pl, "state", &st))
-                                    state = json_object_get_boolean(st) ? 1 : 0;
-                                if (json_object_object_get_ex(pl, "duration_sec", &du))
-                                    duration = json_object_get_int(du);
-                                if (json_object_object_get_ex(pl, "duty_percent", &dt))
-                                    duty = json_object_get_int(dt);
-                                json_object_put(pl);
-                            }
-                            int sched_applied = 0;
-                            const char *alert_type = "schedule";
-                            char alert_msg[192];
-
-                            if (strcmp(sched[s].schedule_type, "lights") == 0)
-                            {
-                                if (lights_init() == 0 && lights_set(state) == 0)
-                                {
-                                    dev_state.lights_on = state;
-                                    lights_on = state;
-                                    lights_off_at = (state && duration > 0) ? (now + duration) : 0;
-                                    if (lights_off_at)
-                                        printf("  -> Lights ON (auto-off in %ds) [schedule]\n", duration);
-                                    else
-                                        printf("  -> Lights %s [schedule]\n", state ? "ON" : "OFF");
-                                    alert_type = "schedule_lights";
-                                    if (state)
-                                    {
-                                        if (lights_off_at)
-                                            snprintf(alert_msg, sizeof(alert_msg),
-                                                     "Scheduled: Grow lights ON (auto-off in %d s)", duration);
-                                        else
-                                            snprintf(alert_msg, sizeof(alert_msg),
-                                                     "Scheduled: Grow lights ON");
-                                    }
-                                    else
-                                        snprintf(alert_msg, sizeof(alert_msg),
-                                                 "Scheduled: Grow lights OFF");
-                                    sched_applied = 1;
-                                }
-                                else
-                                    fprintf(stderr, "  [Schedule] lights: init or GPIO failed\n");
-                            }
-                            else if (strcmp(sched[s].schedule_type, "pump") == 0)
-                            {
-                                if (pump_init() == 0 && pump_set(state) == 0)
-                                {
-                                    dev_state.pump_on = state;
-                                    pump_on = state;
-                                    pump_off_at = (state && duration > 0) ? (now + duration) : 0;
-                                    printf("  -> Pump %s [schedule]\n", state ? "ON" : "OFF");
-                                    alert_type = "schedule_pump";
-                                    snprintf(alert_msg, sizeof(alert_msg), "Scheduled: Pump turned %s",
-                                             state ? "ON" : "OFF");
-                                    sched_applied = 1;
-                                }
-                                else
-                                    fprintf(stderr, "  [Schedule] pump: init or GPIO failed\n");
-                            }
-                            else if (strcmp(sched[s].schedule_type, "ventilation") == 0)
-                            {
-                                int fan_duty_target = state ? (duty > 0 ? duty : FAN_MIN_DUTY_WHEN_ON) : 0;
-                                if (fans_init() == 0 && fans_set_both(fan_duty_target) == 0)
-                                {
-                                    dev_state.fan_duty = fan_duty_target;
-                                    ventilation_off_at = (state && duration > 0) ? (now + duration) : 0;
-                                    printf("  -> Ventilation %s [schedule] (duty=%d%%)\n",
-                                           state ? "ON" : "OFF", fan_duty_target);
-                                    alert_type = "schedule_ventilation";
-                                    if (state)
-                                        snprintf(alert_msg, sizeof(alert_msg),
-                                                 "Scheduled: Ventilation ON at %d%%",
-                                                 fan_duty_target);
-                                    else
-                                        snprintf(alert_msg, sizeof(alert_msg),
-                                                 "Scheduled: Ventilation OFF");
-                                    sched_applied = 1;
-                                }
-                                else
-                                    fprintf(stderr, "  [Schedule] ventilation: init or fans_set failed\n");
-                            }
-
-                            if (sched_applied)
-                            {
-                                state_save(STATE_PATH, &dev_state);
-                                if (supabase_update_actuator_state(&supabase_cfg,
-                                        dev_state.lights_on, dev_state.pump_on, dev_state.fan_duty,
-                                        -1, -1) != 0)
-                                    fprintf(stderr, "  [Schedule] actuator state upsert failed\n");
-
-                                /* At most one alert per schedule id per cooldown window */
-                                enum { SCHED_ALERT_COOLDOWN_SEC = 120 };
-                                time_t *last_alert_at = NULL;
-                                for (int a = 0; a < sched_alert_cd_n; a++)
-                                    if (strcmp(sched_alert_cd[a].id, sched[s].id) == 0)
-                                    {
-                                        last_alert_at = &sched_alert_cd[a].last_alert_at;
-                                        break;
-                                    }
-                                if (!last_alert_at && sched_alert_cd_n < 32)
-                                {
-                                    int i = sched_alert_cd_n++;
-                                    snprintf(sched_alert_cd[i].id, sizeof(sched_alert_cd[i].id), "%s",
-                                             sched[s].id);
-                                    last_alert_at = &sched_alert_cd[i].last_alert_at;
-                                    *last_alert_at = 0;
-                                }
-                                if (last_alert_at && (now - *last_alert_at) >= SCHED_ALERT_COOLDOWN_SEC)
-                                {
-                                    if (supabase_insert_alert(&supabase_cfg, supabase_cfg.device_id,
-                                            alert_type, alert_msg, "low", "scheduled") == 0)
-                                        *last_alert_at = now;
-                                }
-
-                                int found = 0;
-                                for (int r = 0; r < run_cache_n; r++)
-                                    if (strcmp(run_cache[r].id, sched[s].id) == 0)
-                                    {
-                                        run_cache[r].last_run = now;
-                                        found = 1;
-                                        break;
-                                    }
-                                if (!found && run_cache_n < 16)
-                                {
-                                    snprintf(run_cache[run_cache_n].id, sizeof(run_cache[run_cache_n].id), "%s",
-                                             sched[s].id);
-                                    run_cache[run_cache_n].last_run = now;
-                                    run_cache_n++;
-                                }
-                                supabase_update_schedule_last_run(&supabase_cfg, sched[s].id);
-                            }
-                        }
+                        config_fetched(&rule_version, now);
+                        if (sql_save_rules(db, fetched, fetched_count) != SQLITE_OK)
+                            fprintf(stderr, "  [Rules] Failed to persist %d rule(s)\n", fetched_count);
+                        if (rules_compile(fetched, fetched_count) < 0)
+                            fprintf(stderr, "  [Rules] Out of memory compiling rules\n");
+                        free(fetched);
+                        printf("  [Rules] Refreshed %d rule(s) from Supabase\n", rules_count());
                     }
-                    free(sched);
                 }
             }
         }
 
-        sleep(DATA_READ_INTERVAL);
+        /* Everything that changed this tick goes out as one upsert */
+        if (supabase_enabled && supabase_cfg.device_id)
+            actuator_state_flush(&supabase_cfg);
+
+        /* Sleep until the next sensor read or timer expiry, whichever is first */
+        int wait = DATA_READ_INTERVAL;
+        time_t next_expiry = timer_wheel_next_expiry();
+        time_t until_expiry = next_expiry - time(NULL);
+        if (next_expiry > 0 && until_expiry < wait)
+            wait = until_expiry > 0 ? (int)until_expiry : 0;
+        wait_tick(wait);
+#ifdef PHYTOPI_SIM
+        if (sim_done())
+            break;
+#endif
     }
 
-    if (cached_thresholds)
-        free(cached_thresholds);
+    thresholds_cleanup();
+    rules_cleanup();
+    scheduler_cleanup();
 
+    capture_cleanup();
+    realtime_cleanup();
+    journal_stop();
     if (supabase_enabled)
     {
         supabase_cleanup();
     }
-    bme680_cleanup();
+    safety_stop();
+    interlock_stop();
+    safety_report();
+    fan_control_report();
+    sensors_cleanup();
     sqlite3_close(db);
     gpio_cleanup();
-    close(fd);
 
     return 0;
 }
@@ -0,0 +1,394 @@
+/**
+ * Supabase Realtime client for PhytoPi
+ * Speaks the Phoenix channel protocol over a libcurl websocket
+ * (CURLOPT_CONNECT_ONLY = 2, curl_ws_send / curl_ws_recv) and turns
+ * postgres_changes INSERTs on device_commands into a pending flag.
+ */
+#include "../lib/realtime.h"
+
+#include <curl/curl.h>
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+
+#define REALTIME_MAX_MSG (64 * 1024) /* larger messages are dropped */
+
+/* curl_ws_recv() hands out a const frame pointer from 8.0 on */
+#if LIBCURL_VERSION_NUM >= 0x080000
+#define WS_FRAME const struct curl_ws_frame
+#else
+#define WS_FRAME struct curl_ws_frame
+#endif
+
+static CURL *ws = NULL;
+static curl_socket_t ws_sock = CURL_SOCKET_BAD;
+static char *ws_url = NULL;
+static char topic[128];
+static const supabase_config_t *rt_cfg = NULL;
+
+static int enabled = 0;
+static int joined = 0;
+static int pending = 0;
+static unsigned long ref_seq = 0;
+static unsigned long join_ref = 0;
+static unsigned long heartbeat_ref = 0; /* 0 = no heartbeat awaiting reply */
+
+static long last_heartbeat = 0;
+static long next_connect = 0;
+static int backoff_sec = 1;
+
+static char *msg = NULL;
+static size_t msg_len = 0;
+static int msg_overflow = 0;
+
+static long mono_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec;
+}
+
+static void disconnect(const char *why)
+{
+    if (ws)
+    {
+        if (why)
+            fprintf(stderr, "Realtime: disconnected (%s), polling until reconnect in %ds\n", why, backoff_sec);
+        curl_easy_cleanup(ws);
+    }
+    ws = NULL;
+    ws_sock = CURL_SOCKET_BAD;
+    joined = 0;
+    heartbeat_ref = 0;
+    msg_len = 0;
+    msg_overflow = 0;
+    next_connect = mono_sec() + backoff_sec;
+    if (backoff_sec < REALTIME_RECONNECT_MAX_SEC)
+        backoff_sec *= 2;
+}
+
+/*
+ * Helper: send one Phoenix message. Messages are small, so a frame that
+ * cannot go out whole is treated as a dead socket.
+ */
+static int ws_send_message(const char *msg_topic, const char *event, json_object *payload, unsigned long ref)
+{
+    json_object *m = json_object_new_object();
+    char ref_str[24];
+    snprintf(ref_str, sizeof(ref_str), "%lu", ref);
+    json_object_object_add(m, "topic", json_object_new_string(msg_topic));
+    json_object_object_add(m, "event", json_object_new_string(event));
+    json_object_object_add(m, "payload", payload ? payload : json_object_new_object());
+    json_object_object_add(m, "ref", json_object_new_string(ref_str));
+    if (strcmp(event, "phx_join") == 0)
+        json_object_object_add(m, "join_ref", json_object_new_string(ref_str));
+
+    const char *s = json_object_to_json_string_ext(m, JSON_C_TO_STRING_PLAIN);
+    size_t len = strlen(s);
+    int ret = -1;
+    for (int attempt = 0; attempt < 10; attempt++)
+    {
+        size_t sent = 0;
+        CURLcode rc = curl_ws_send(ws, s, len, &sent, 0, CURLWS_TEXT);
+        if (rc == CURLE_OK && sent == len)
+        {
+            ret = 0;
+            break;
+        }
+        if (rc != CURLE_AGAIN || sent != 0)
+            break;
+        struct pollfd pfd = {.fd = ws_sock, .events = POLLOUT};
+        poll(&pfd, 1, 100);
+    }
+    json_object_put(m);
+    return ret;
+}
+
+static int send_join(void)
+{
+    json_object *change = json_object_new_object();
+    char filter[96];
+    snprintf(filter, sizeof(filter), "device_id=eq.%s", rt_cfg->device_id);
+    json_object_object_add(change, "event", json_object_new_string("INSERT"));
+    json_object_object_add(change, "schema", json_object_new_string("public"));
+    json_object_object_add(change, "table", json_object_new_string("device_commands"));
+    json_object_object_add(change, "filter", json_object_new_string(filter));
+
+    json_object *changes = json_object_new_array();
+    json_object_array_add(changes, change);
+    json_object *config = json_object_new_object();
+    json_object_object_add(config, "postgres_changes", changes);
+    json_object *payload = json_object_new_object();
+    json_object_object_add(payload, "config", config);
+    json_object_object_add(payload, "access_token", json_object_new_string(rt_cfg->api_key));
+
+    join_ref = ++ref_seq;
+    return ws_send_message(topic, "phx_join", payload, join_ref);
+}
+
+static int try_connect(void)
+{
+    ws = curl_easy_init();
+    if (!ws)
+        return -1;
+    curl_easy_setopt(ws, CURLOPT_URL, ws_url);
+    curl_easy_setopt(ws, CURLOPT_CONNECT_ONLY, 2L); /* websocket upgrade, then hand over the socket */
+    curl_easy_setopt(ws, CURLOPT_CONNECTTIMEOUT, (long)REALTIME_CONNECT_TIMEOUT);
+    curl_easy_setopt(ws, CURLOPT_TIMEOUT, (long)REALTIME_CONNECT_TIMEOUT * 2);
+
+    CURLcode res = curl_easy_perform(ws);
+    if (res != CURLE_OK)
+    {
+        fprintf(stderr, "Realtime: connect failed: %s\n", curl_easy_strerror(res));
+        if (res == CURLE_UNSUPPORTED_PROTOCOL)
+        {
+            fprintf(stderr, "Realtime: libcurl built without websocket support, polling only\n");
+            enabled = 0;
+        }
+        disconnect(NULL);
+        return -1;
+    }
+    if (curl_easy_getinfo(ws, CURLINFO_ACTIVESOCKET, &ws_sock) != CURLE_OK || ws_sock == CURL_SOCKET_BAD)
+    {
+        disconnect("no socket");
+        return -1;
+    }
+    last_heartbeat = mono_sec();
+    if (send_join() != 0)
+    {
+        disconnect("join send failed");
+        return -1;
+    }
+    return 0;
+}
+
+static unsigned long get_ref(json_object *m)
+{
+    json_object *ref = NULL;
+    if (!json_object_object_get_ex(m, "ref", &ref) || !ref)
+        return 0;
+    return strtoul(json_object_get_string(ref), NULL, 10);
+}
+
+static void handle_message(const char *text)
+{
+    json_object *m = json_tokener_parse(text);
+    if (!m)
+        return;
+    json_object *ev = NULL, *tp = NULL, *payload = NULL;
+    json_object_object_get_ex(m, "event", &ev);
+    json_object_object_get_ex(m, "topic", &tp);
+    json_object_object_get_ex(m, "payload", &payload);
+    const char *event = ev ? json_object_get_string(ev) : "";
+    const char *msg_topic = tp ? json_object_get_string(tp) : "";
+
+    if (strcmp(event, "phx_reply") == 0)
+    {
+        unsigned long ref = get_ref(m);
+        json_object *st = NULL;
+        const char *status = (payload && json_object_object_get_ex(payload, "status", &st)) ? json_object_get_string(st) : "";
+        if (ref && ref == heartbeat_ref)
+            heartbeat_ref = 0;
+        else if (ref && ref == join_ref)
+        {
+            if (strcmp(status, "ok") == 0)
+            {
+                joined = 1;
+                backoff_sec = 1;
+                pending = 1; /* pick up anything queued while we were not subscribed */
+                printf("Realtime: subscribed to device_commands for %s\n", rt_cfg->device_id);
+            }
+            else
+            {
+                fprintf(stderr, "Realtime: join rejected: %s\n", json_object_to_json_string(payload));
+                disconnect("join rejected");
+            }
+        }
+    }
+    else if (strcmp(event, "postgres_changes") == 0 && strcmp(msg_topic, topic) == 0)
+    {
+        json_object *data = NULL, *type = NULL;
+        if (payload && json_object_object_get_ex(payload, "data", &data) &&
+            json_object_object_get_ex(data, "type", &type) && strcmp(json_object_get_string(type), "INSERT") == 0)
+            pending = 1;
+    }
+    else if ((strcmp(event, "phx_error") == 0 || strcmp(event, "phx_close") == 0) && strcmp(msg_topic, topic) == 0)
+    {
+        disconnect(event);
+    }
+    json_object_put(m);
+}
+
+/*
+ * Helper: read every frame available without blocking, reassembling
+ * fragmented text messages. Returns -1 if the socket is gone.
+ */
+static int ws_drain(void)
+{
+    char buf[4096];
+    for (;;)
+    {
+        size_t rlen = 0;
+        WS_FRAME *meta = NULL;
+        CURLcode rc = curl_ws_recv(ws, buf, sizeof(buf), &rlen, &meta);
+        if (rc == CURLE_AGAIN)
+            return 0;
+        if (rc != CURLE_OK || !meta)
+            return -1;
+        if (meta->flags & CURLWS_CLOSE)
+            return -1;
+        if (!(meta->flags & CURLWS_TEXT))
+            continue; /* pings are answered by libcurl, nothing else is expected */
+
+        if (!msg_overflow)
+        {
+            if (msg_len + rlen + 1 > REALTIME_MAX_MSG)
+                msg_overflow = 1;
+            else
+            {
+                if (!msg)
+                    msg = (char *)malloc(REALTIME_MAX_MSG);
+                if (!msg)
+                    return -1;
+                memcpy(msg + msg_len, buf, rlen);
+                msg_len += rlen;
+            }
+        }
+        if (meta->bytesleft == 0 && !(meta->flags & CURLWS_CONT))
+        {
+            if (msg_overflow)
+                fprintf(stderr, "Realtime: dropped message over %d bytes\n", REALTIME_MAX_MSG);
+            else
+            {
+                msg[msg_len] = '\0';
+                handle_message(msg);
+            }
+            msg_len = 0;
+            msg_overflow = 0;
+            if (!ws)
+                return -1; /* handle_message disconnected */
+        }
+    }
+}
+
+static void heartbeat(long now)
+{
+    if (now - last_heartbeat < REALTIME_HEARTBEAT_SEC)
+        return;
+    if (heartbeat_ref)
+    {
+        disconnect("heartbeat timeout");
+        return;
+    }
+    last_heartbeat = now;
+    heartbeat_ref = ++ref_seq;
+    if (ws_send_message("phoenix", "heartbeat", NULL, heartbeat_ref) != 0)
+        disconnect("heartbeat send failed");
+}
+
+int realtime_init(const supabase_config_t *cfg)
+{
+    const char *env = getenv("SUPABASE_REALTIME");
+    if (env && strcmp(env, "0") == 0)
+    {
+        printf("Realtime: disabled by SUPABASE_REALTIME=0, polling commands\n");
+        return -1;
+    }
+    if (!cfg || !cfg->api_url || !cfg->api_key || !cfg->device_id)
+        return -1;
+
+    const char *override = getenv("SUPABASE_REALTIME_URL");
+    if (override && override[0])
+        ws_url = strdup(override);
+    else
+    {
+        /* http(s)://host -> ws(s)://host/realtime/v1/websocket */
+        const char *rest = cfg->api_url;
+        const char *scheme = "ws";
+        if (strncmp(rest, "https://", 8) == 0)
+        {
+            scheme = "wss";
+            rest += 8;
+        }
+        else if (strncmp(rest, "http://", 7) == 0)
+            rest += 7;
+        size_t len = strlen(rest) + strlen(cfg->api_key) + 64;
+        ws_url = (char *)malloc(len);
+        if (ws_url)
+            snprintf(ws_url, len, "%s://%s/realtime/v1/websocket?apikey=%s&vsn=1.0.0", scheme, rest, cfg->api_key);
+    }
+    if (!ws_url)
+        return -1;
+
+    rt_cfg = cfg;
+    snprintf(topic, sizeof(topic), "realtime:device_commands:%s", cfg->device_id);
+    enabled = 1;
+    next_connect = 0;
+    try_connect();
+    return enabled ? 0 : -1;
+}
+
+int realtime_connected(void)
+{
+    return ws && joined;
+}
+
+int realtime_poll(int timeout_ms)
+{
+    if (!enabled)
+        return -1;
+
+    long now = mono_sec();
+    if (!ws)
+    {
+        if (now < next_connect || try_connect() != 0)
+            return pending ? 1 : -1;
+    }
+
+    if (!pending && timeout_ms > 0)
+    {
+        /* Wake at the next heartbeat at the latest */
+        long hb_in = (last_heartbeat + REALTIME_HEARTBEAT_SEC - now) * 1000;
+        if (hb_in < timeout_ms)
+            timeout_ms = hb_in > 0 ? (int)hb_in : 0;
+        struct pollfd pfd = {.fd = ws_sock, .events = POLLIN};
+        poll(&pfd, 1, timeout_ms);
+    }
+
+    if (ws_drain() != 0)
+    {
+        if (ws)
+            disconnect("socket closed");
+        return pending ? 1 : -1;
+    }
+    heartbeat(mono_sec());
+    if (pending)
+        return 1;
+    return ws ? 0 : -1;
+}
+
+int realtime_take_pending(void)
+{
+    int p = pending;
+    pending = 0;
+    return p;
+}
+
+void realtime_cleanup(void)
+{
+    if (ws && joined)
+        ws_send_message(topic, "phx_leave", NULL, ++ref_seq);
+    if (ws)
+        curl_easy_cleanup(ws);
+    ws = NULL;
+    ws_sock = CURL_SOCKET_BAD;
+    joined = 0;
+    enabled = 0;
+    free(ws_url);
+    ws_url = NULL;
+    free(msg);
+    msg = NULL;
+}
@@ -0,0 +1,236 @@
+/**
+ * Local automation rules for PhytoPi
+ */
+#include "../lib/rules.h"
+#include "../lib/sensors.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static rule_t *rules = NULL;
+static int n_rules = 0;
+
+/* Rules of actuator a are rules[act_start[a] .. act_start[a + 1]) */
+static int act_start[RULE_ACTUATOR_COUNT + 1];
+
+/* Dense group index per registry metric, -1 = no rule reads it */
+static int metric_group[SENSOR_MAX_METRICS];
+static int n_groups = 0;
+
+/* Per-group extremes of the valid readings, rebuilt each evaluation */
+static double group_lo[SENSOR_MAX_METRICS];
+static double group_hi[SENSOR_MAX_METRICS];
+
+/* Level last applied per actuator (confirmed by rules_applied), kept across
+ * recompiles so a deleted latched rule still releases its actuator */
+static int last_level[RULE_ACTUATOR_COUNT];
+
+static int parse_actuator(const char *name)
+{
+    if (strcmp(name, "lights") == 0)
+        return RULE_LIGHTS;
+    if (strcmp(name, "pump") == 0)
+        return RULE_PUMP;
+    if (strcmp(name, "fans") == 0)
+        return RULE_FANS;
+    return -1;
+}
+
+int rules_compile(const device_rule_t *rows, int count)
+{
+    rule_t *out = (rule_t *)calloc(count > 0 ? count : 1, sizeof(rule_t));
+    int *order = (int *)malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    if (!out || !order)
+    {
+        free(out);
+        free(order);
+        return -1;
+    }
+
+    /* Registry group head -> dense group index, assigned as rules need them */
+    int head_group[SENSOR_MAX_METRICS];
+    for (int i = 0; i < SENSOR_MAX_METRICS; i++)
+        head_group[i] = -1;
+    int groups = 0;
+
+    /* First pass: validate rows and count rules per actuator */
+    int per_act[RULE_ACTUATOR_COUNT] = {0};
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const device_rule_t *row = &rows[i];
+        if (!row->enabled)
+            continue;
+        int act = parse_actuator(row->actuator);
+        int head = sensors_group_find(row->metric);
+        if (act < 0 || head < 0)
+        {
+            fprintf(stderr, "  [Rules] %s: unknown %s '%s', skipped\n", row->id,
+                    act < 0 ? "actuator" : "metric", act < 0 ? row->actuator : row->metric);
+            continue;
+        }
+        if (head_group[head] < 0)
+            head_group[head] = groups++;
+        order[n++] = i;
+        per_act[act]++;
+    }
+    act_start[0] = 0;
+    for (int a = 0; a < RULE_ACTUATOR_COUNT; a++)
+        act_start[a + 1] = act_start[a] + per_act[a];
+
+    /* Second pass: place each rule in its actuator's run */
+    int fill[RULE_ACTUATOR_COUNT];
+    memcpy(fill, act_start, sizeof(fill));
+    for (int k = 0; k < n; k++)
+    {
+        const device_rule_t *row = &rows[order[k]];
+        rule_actuator_t act = (rule_actuator_t)parse_actuator(row->actuator);
+        rule_t *r = &out[fill[act]++];
+        r->actuator = act;
+        r->group = head_group[sensors_group_find(row->metric)];
+        r->above = row->above;
+        r->on_value = row->on_value;
+        r->off_value = row->off_value;
+        if (act == RULE_FANS)
+            r->duty = row->duty_percent > 0 && row->duty_percent <= 100 ? row->duty_percent : 100;
+        else
+            r->duty = 1;
+        r->min_on_sec = row->min_on_sec > 0 ? row->min_on_sec : 0;
+        r->min_off_sec = row->min_off_sec > 0 ? row->min_off_sec : 0;
+        r->max_on_sec = row->max_on_sec > 0 ? row->max_on_sec : 0;
+        snprintf(r->id, sizeof(r->id), "%s", row->id);
+        snprintf(r->metric, sizeof(r->metric), "%s", row->metric);
+
+        /* A refresh must not drop a latch or restart its hold time */
+        for (int o = 0; o < n_rules; o++)
+        {
+            if (strcmp(rules[o].id, r->id) == 0)
+            {
+                r->latched = rules[o].latched;
+                r->changed = rules[o].changed;
+                break;
+            }
+        }
+    }
+    free(order);
+
+    /* Every metric of a group maps to the group's dense index */
+    for (int m = 0; m < SENSOR_MAX_METRICS; m++)
+        metric_group[m] = -1;
+    for (int h = 0; h < SENSOR_MAX_METRICS; h++)
+    {
+        if (head_group[h] < 0)
+            continue;
+        for (int m = h; m >= 0; m = sensors_metric(m)->next_in_group)
+            metric_group[m] = head_group[h];
+    }
+
+    free(rules);
+    rules = out;
+    n_rules = n;
+    n_groups = groups;
+    return n;
+}
+
+int rules_count(void)
+{
+    return n_rules;
+}
+
+const rule_t *rules_rule(int idx)
+{
+    if (idx < 0 || idx >= n_rules)
+        return NULL;
+    return &rules[idx];
+}
+
+int rules_controls(rule_actuator_t act)
+{
+    return act_start[act + 1] > act_start[act];
+}
+
+/*
+ * Helper: step one rule's latch against its group's extremes
+ */
+static void step_rule(rule_t *r, time_t now)
+{
+    double v = r->above ? group_hi[r->group] : group_lo[r->group];
+    if (isinf(v))
+        return; /* no valid reading: hold the latch */
+    if (!r->latched)
+    {
+        int trip = r->above ? v > r->on_value : v < r->on_value;
+        if (trip && now - r->changed >= r->min_off_sec)
+        {
+            r->latched = 1;
+            r->changed = now;
+        }
+    }
+    else
+    {
+        int release = r->above ? v < r->off_value : v > r->off_value;
+        if (release && now - r->changed >= r->min_on_sec)
+        {
+            r->latched = 0;
+            r->changed = now;
+        }
+    }
+}
+
+unsigned rules_evaluate(time_t now, rule_output_t out[RULE_ACTUATOR_COUNT])
+{
+    /* Collapse each group to its extremes; any probe past the bound counts */
+    for (int g = 0; g < n_groups; g++)
+    {
+        group_lo[g] = INFINITY;
+        group_hi[g] = -INFINITY;
+    }
+    int n_metrics = sensors_metric_count();
+    for (int m = 0; m < n_metrics && n_rules > 0; m++)
+    {
+        int g = metric_group[m];
+        const sensor_metric_t *sm = sensors_metric(m);
+        if (g < 0 || !sm->valid)
+            continue;
+        group_lo[g] = fmin(group_lo[g], sm->value);
+        group_hi[g] = fmax(group_hi[g], sm->value);
+    }
+
+    unsigned changed = 0;
+    for (int a = 0; a < RULE_ACTUATOR_COUNT; a++)
+    {
+        out[a].level = 0;
+        out[a].max_on_sec = 0;
+        out[a].rule = -1;
+        for (int i = act_start[a]; i < act_start[a + 1]; i++)
+        {
+            rule_t *r = &rules[i];
+            step_rule(r, now);
+            if (r->latched && r->duty > out[a].level)
+            {
+                out[a].level = r->duty;
+                out[a].max_on_sec = r->max_on_sec;
+                out[a].rule = i;
+            }
+        }
+        if (out[a].level != last_level[a])
+            changed |= 1u << a;
+    }
+    return changed;
+}
+
+void rules_applied(rule_actuator_t act, int level)
+{
+    if (act >= 0 && act < RULE_ACTUATOR_COUNT)
+        last_level[act] = level;
+}
+
+void rules_cleanup(void)
+{
+    free(rules);
+    rules = NULL;
+    n_rules = 0;
+    n_groups = 0;
+    memset(act_start, 0, sizeof(act_start));
+}
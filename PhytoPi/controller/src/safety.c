@@ -0,0 +1,300 @@
+/**
+ * Actuator safety thread for PhytoPi
+ * Timed auto-off (pump, lights, ventilation) is enforced from a small
+ * real-time thread sleeping on a timerfd armed for the earliest deadline.
+ */
+#include "../lib/safety.h"
+#include "../lib/gpio.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#define NS_PER_SEC 1000000000LL
+#define SAFETY_STACK_SIZE (64 * 1024)
+#define SAFETY_RETRY_NS (100 * 1000000LL) /* retry a failed switch-off after 100ms */
+
+static const char *act_names[SAFETY_COUNT] = {"lights", "pump", "fans"};
+
+/* Shared by the real-time thread and the main loop. Priority inheritance keeps
+ * the thread from waiting behind a preempted normal-priority holder. */
+static pthread_mutex_t lock;
+static pthread_once_t lock_once = PTHREAD_ONCE_INIT;
+static int64_t deadline_ns[SAFETY_COUNT]; /* 0 = disarmed */
+static int fired[SAFETY_COUNT];
+
+/* Overshoot statistics (written under lock) */
+static unsigned long hist[SAFETY_HIST_BUCKETS];
+static unsigned long fired_total = 0;
+static int64_t overshoot_max_ns = 0;
+
+static pthread_t thread;
+static void *thread_stack = NULL;
+static int timer_fd = -1;
+static int wake_fd = -1;
+static int running = 0;
+static volatile int stop_requested = 0;
+
+static void lock_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void lock_acquire(void)
+{
+    pthread_once(&lock_once, lock_init);
+    pthread_mutex_lock(&lock);
+}
+
+/*
+ * Helper: deadline clock. The simulator has no real-time thread and
+ * checks deadlines on its virtual clock from the main loop instead.
+ */
+static int64_t now_ns(void)
+{
+#ifdef PHYTOPI_SIM
+    return (int64_t)time(NULL) * NS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+static int switch_off(safety_actuator_t act)
+{
+    switch (act)
+    {
+    case SAFETY_LIGHTS:
+        return lights_set(0);
+    case SAFETY_PUMP:
+        return pump_set(0);
+    case SAFETY_FANS:
+        return fans_set_both(0);
+    default:
+        return -1;
+    }
+}
+
+static void record_overshoot(int64_t ns)
+{
+    int64_t us = ns / 1000;
+    int b = 0;
+    while (b < SAFETY_HIST_BUCKETS - 1 && (1LL << b) <= us)
+        b++;
+    hist[b]++;
+    fired_total++;
+    if (ns > overshoot_max_ns)
+        overshoot_max_ns = ns;
+}
+
+/*
+ * Helper: switch off every expired actuator. Caller holds lock.
+ * Returns the earliest remaining deadline, 0 if none.
+ */
+static int64_t service_locked(void)
+{
+    int64_t next = 0;
+    for (int a = 0; a < SAFETY_COUNT; a++)
+    {
+        if (!deadline_ns[a])
+            continue;
+        int64_t now = now_ns();
+        if (deadline_ns[a] <= now)
+        {
+            if (switch_off((safety_actuator_t)a) == 0)
+            {
+                record_overshoot(now_ns() - deadline_ns[a]);
+                deadline_ns[a] = 0;
+                fired[a] = 1;
+                continue;
+            }
+            fprintf(stderr, "Safety: auto-off of %s failed, retrying\n", act_names[a]);
+            deadline_ns[a] = now + SAFETY_RETRY_NS;
+        }
+        if (!next || deadline_ns[a] < next)
+            next = deadline_ns[a];
+    }
+    return next;
+}
+
+#ifndef PHYTOPI_SIM
+/* The simulator never starts the thread (see safety_start) */
+static void *safety_thread(void *arg)
+{
+    while (!stop_requested)
+    {
+        lock_acquire();
+        int64_t next = service_locked();
+        pthread_mutex_unlock(&lock);
+
+        /* Zero it_value disarms the timer */
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = next / NS_PER_SEC;
+        its.it_value.tv_nsec = next % NS_PER_SEC;
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+            fprintf(stderr, "Safety: timerfd_settime failed: %s\n", strerror(errno));
+
+        struct pollfd pfd[2] = {
+            {.fd = timer_fd, .events = POLLIN},
+            {.fd = wake_fd, .events = POLLIN},
+        };
+        if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+            break;
+        uint64_t drain;
+        if (pfd[0].revents & POLLIN)
+            (void)!read(timer_fd, &drain, sizeof(drain));
+        if (pfd[1].revents & POLLIN)
+            (void)!read(wake_fd, &drain, sizeof(drain));
+    }
+    return NULL;
+}
+#endif
+
+static void wake_thread(void)
+{
+    if (wake_fd < 0)
+        return;
+    uint64_t one = 1;
+    (void)!write(wake_fd, &one, sizeof(one));
+}
+
+int safety_start(void)
+{
+#ifdef PHYTOPI_SIM
+    printf("Safety: simulator build, auto-off deadlines checked in the main loop\n");
+    return -1;
+#else
+    if (running)
+        return 0;
+    pthread_once(&lock_once, lock_init);
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (timer_fd < 0 || wake_fd < 0)
+    {
+        fprintf(stderr, "Safety: timerfd/eventfd failed: %s\n", strerror(errno));
+        safety_stop();
+        return -1;
+    }
+
+    /* Keep the thread's stack and the already-mapped code/data resident */
+    if (posix_memalign(&thread_stack, (size_t)sysconf(_SC_PAGESIZE), SAFETY_STACK_SIZE) != 0)
+    {
+        thread_stack = NULL;
+        safety_stop();
+        return -1;
+    }
+    memset(thread_stack, 0, SAFETY_STACK_SIZE);
+    if (mlock(thread_stack, SAFETY_STACK_SIZE) != 0 || mlockall(MCL_CURRENT) != 0)
+        fprintf(stderr, "Safety: mlock failed (%s), page faults may delay auto-off\n", strerror(errno));
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, thread_stack, SAFETY_STACK_SIZE);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    struct sched_param sp = {.sched_priority = SAFETY_RT_PRIORITY};
+    pthread_attr_setschedparam(&attr, &sp);
+
+    int rc = pthread_create(&thread, &attr, safety_thread, NULL);
+    if (rc == EPERM)
+    {
+        fprintf(stderr, "Safety: no permission for SCHED_FIFO, using normal scheduling\n");
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        rc = pthread_create(&thread, &attr, safety_thread, NULL);
+    }
+    pthread_attr_destroy(&attr);
+    if (rc != 0)
+    {
+        fprintf(stderr, "Safety: thread start failed (%s), checking deadlines in the main loop\n", strerror(rc));
+        safety_stop();
+        return -1;
+    }
+    running = 1;
+    printf("Safety: auto-off thread running\n");
+    return 0;
+#endif
+}
+
+void safety_arm(safety_actuator_t act, int duration_sec)
+{
+    if (act < 0 || act >= SAFETY_COUNT)
+        return;
+    lock_acquire();
+    deadline_ns[act] = (duration_sec > 0) ? now_ns() + (int64_t)duration_sec * NS_PER_SEC : 0;
+    fired[act] = 0;
+    pthread_mutex_unlock(&lock);
+    wake_thread();
+}
+
+int safety_armed(safety_actuator_t act)
+{
+    if (act < 0 || act >= SAFETY_COUNT)
+        return 0;
+    lock_acquire();
+    int armed = deadline_ns[act] != 0;
+    pthread_mutex_unlock(&lock);
+    return armed;
+}
+
+int safety_take_fired(safety_actuator_t act)
+{
+    if (act < 0 || act >= SAFETY_COUNT)
+        return 0;
+    lock_acquire();
+    if (!running)
+        service_locked();
+    int f = fired[act];
+    fired[act] = 0;
+    pthread_mutex_unlock(&lock);
+    return f;
+}
+
+void safety_report(void)
+{
+    lock_acquire();
+    printf("Safety: %lu auto-off(s), max overshoot %.3f ms\n", fired_total, overshoot_max_ns / 1e6);
+    for (int b = 0; b < SAFETY_HIST_BUCKETS; b++)
+    {
+        if (!hist[b])
+            continue;
+        if (b == SAFETY_HIST_BUCKETS - 1)
+            printf("  >= %lld us: %lu\n", 1LL << (b - 1), hist[b]);
+        else
+            printf("  <  %lld us: %lu\n", 1LL << b, hist[b]);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void safety_stop(void)
+{
+    if (running)
+    {
+        stop_requested = 1;
+        wake_thread();
+        pthread_join(thread, NULL);
+        running = 0;
+    }
+    if (timer_fd >= 0)
+        close(timer_fd);
+    if (wake_fd >= 0)
+        close(wake_fd);
+    timer_fd = wake_fd = -1;
+    if (thread_stack)
+    {
+        munlock(thread_stack, SAFETY_STACK_SIZE);
+        free(thread_stack);
+        thread_stack = NULL;
+    }
+}
@@ -0,0 +1,308 @@
+/**
+ * Schedule timing for PhytoPi
+ * Each schedule arms a timer-wheel timer at its next fire time; their run
+ * state (last run, next fire, last alert) is found through an open-addressing
+ * hash index on the schedule id and persisted in the SQLite table
+ * schedule_state.
+ */
+#include "../lib/scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    sqlite_schedule_state_t st;
+    device_schedule_t row;
+    cron_expr_t cron;
+    int is_cron;
+    int dirty; /* state changed since the last save */
+    wheel_timer_t timer;
+} sched_entry_t;
+
+static sqlite3 *sdb = NULL;
+
+static sched_entry_t *entries = NULL;
+static int n_entries = 0;
+static int *index_slots = NULL; /* entry index or -1, open addressing */
+static int index_size = 0;
+static int *due = NULL;         /* entry indices expired on the wheel, oldest first */
+static int due_head = 0;
+static int due_n = 0;
+
+static unsigned int id_hash(const char *id)
+{
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)id; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Helper: position of id in an index (its slot, or the empty slot it would take) */
+static int index_probe(const int *slots, int size, const sched_entry_t *in, const char *id)
+{
+    int i = (int)(id_hash(id) & (unsigned int)(size - 1));
+    while (slots[i] >= 0 && strcmp(in[slots[i]].st.id, id) != 0)
+        i = (i + 1) & (size - 1);
+    return i;
+}
+
+static sched_entry_t *find_entry(const char *id)
+{
+    if (!index_slots || !id)
+        return NULL;
+    int slot = index_slots[index_probe(index_slots, index_size, entries, id)];
+    return slot >= 0 ? &entries[slot] : NULL;
+}
+
+/* Helper: allocate an empty index with room for n ids at load <= 1/2 */
+static int *index_alloc(int n, int *size)
+{
+    *size = 64;
+    while (*size < n * 2)
+        *size *= 2;
+    int *slots = (int *)malloc((size_t)*size * sizeof(int));
+    if (slots)
+        for (int i = 0; i < *size; i++)
+            slots[i] = -1;
+    return slots;
+}
+
+/* Helper: replace the live arrays (entries, index, due queue). The old
+ * entries' timers are disarmed first: they live inside the freed array. */
+static void install(sched_entry_t *e, int n, int *slots, int size, int *d)
+{
+    for (int i = 0; i < n_entries; i++)
+        timer_wheel_cancel(&entries[i].timer);
+    free(entries);
+    free(index_slots);
+    free(due);
+    entries = e;
+    n_entries = n;
+    index_slots = slots;
+    index_size = size;
+    due = d;
+    due_head = 0;
+    due_n = 0;
+}
+
+/* Wheel callback: queue the schedule for scheduler_take_due */
+static void schedule_expired(wheel_timer_t *t)
+{
+    due[due_n++] = (int)((sched_entry_t *)t->arg - entries);
+}
+
+static void arm(sched_entry_t *e)
+{
+    e->timer.fn = schedule_expired;
+    e->timer.arg = e;
+    timer_wheel_add(&e->timer, (time_t)e->st.next_fire);
+}
+
+/*
+ * Helper: write every changed run state in one transaction
+ */
+static void flush_state(void)
+{
+    if (!sdb)
+        return;
+    int n_dirty = 0;
+    for (int i = 0; i < n_entries; i++)
+        n_dirty += entries[i].dirty;
+    if (n_dirty == 0)
+        return;
+
+    sqlite_schedule_state_t *rows = (sqlite_schedule_state_t *)malloc((size_t)n_dirty * sizeof(sqlite_schedule_state_t));
+    if (!rows)
+        return;
+    int n = 0;
+    for (int i = 0; i < n_entries; i++)
+        if (entries[i].dirty)
+            rows[n++] = entries[i].st;
+    if (sql_save_schedule_state(sdb, rows, n) == SQLITE_OK)
+        for (int i = 0; i < n_entries; i++)
+            entries[i].dirty = 0;
+    free(rows);
+}
+
+int scheduler_init(sqlite3 *db)
+{
+    sdb = db;
+    sqlite_schedule_state_t *rows = NULL;
+    int count = 0;
+    if (sql_load_schedule_state(db, &rows, &count) != 0)
+        return -1;
+
+    /* Restored state waits, unarmed, for scheduler_load to claim it */
+    sched_entry_t *e = (sched_entry_t *)calloc(count > 0 ? count : 1, sizeof(sched_entry_t));
+    int size;
+    int *slots = index_alloc(count, &size);
+    if (!e || !slots)
+    {
+        free(e);
+        free(slots);
+        free(rows);
+        return -1;
+    }
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int slot = index_probe(slots, size, e, rows[i].id);
+        if (slots[slot] >= 0)
+            continue;
+        e[n].st = rows[i];
+        slots[slot] = n++;
+    }
+    free(rows);
+    install(e, n, slots, size, NULL);
+    return n;
+}
+
+/*
+ * Helper: does the state describe the same timing as the row
+ */
+static int same_timing(const sqlite_schedule_state_t *st, const device_schedule_t *row)
+{
+    return st->interval_seconds == row->interval_seconds && strcmp(st->cron_expr, row->cron_expr) == 0;
+}
+
+int scheduler_load(const device_schedule_t *rows, int count, time_t now)
+{
+    sched_entry_t *next = (sched_entry_t *)calloc(count > 0 ? count : 1, sizeof(sched_entry_t));
+    int *next_due = (int *)calloc(count > 0 ? count : 1, sizeof(int));
+    int size;
+    int *slots = index_alloc(count, &size);
+    if (!next || !next_due || !slots)
+    {
+        free(next);
+        free(next_due);
+        free(slots);
+        return -1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const device_schedule_t *row = &rows[i];
+        int slot = index_probe(slots, size, next, row->id);
+        if (slots[slot] >= 0)
+            continue; /* duplicate id */
+
+        sched_entry_t *e = &next[n];
+        memset(e, 0, sizeof(*e));
+        e->row = *row;
+        e->is_cron = (row->interval_seconds <= 0);
+        if (e->is_cron && cron_parse(row->cron_expr, &e->cron) != 0)
+        {
+            fprintf(stderr, "  [Schedule] %s: invalid cron '%s', skipped\n", row->id, row->cron_expr);
+            continue;
+        }
+
+        /* Carry run state over from the previous set or the persisted table */
+        const sched_entry_t *old = find_entry(row->id);
+        snprintf(e->st.id, sizeof(e->st.id), "%s", row->id);
+        snprintf(e->st.cron_expr, sizeof(e->st.cron_expr), "%s", row->cron_expr);
+        e->st.interval_seconds = row->interval_seconds;
+        if (old)
+        {
+            e->st.last_run = old->st.last_run;
+            e->st.last_alert = old->st.last_alert;
+            e->dirty = old->dirty;
+            if (same_timing(&old->st, row))
+                e->st.next_fire = old->st.next_fire;
+        }
+        if (!old || !same_timing(&old->st, row) || e->st.next_fire <= 0)
+        {
+            if (e->is_cron)
+                e->st.next_fire = cron_next(&e->cron, now - 1);
+            else
+                e->st.next_fire = e->st.last_run > 0 ? e->st.last_run + row->interval_seconds : now;
+            e->dirty = 1;
+        }
+        if (e->st.next_fire < 0)
+        {
+            fprintf(stderr, "  [Schedule] %s: cron '%s' never fires, skipped\n", row->id, row->cron_expr);
+            continue;
+        }
+
+        slots[slot] = n++;
+    }
+
+    /* Runs that were due but not yet taken are re-armed in the past and
+     * expire again on the next advance */
+    install(next, n, slots, size, next_due);
+    for (int i = 0; i < n_entries; i++)
+        arm(&entries[i]);
+
+    if (sdb)
+        sql_prune_schedule_state(sdb);
+    flush_state();
+    return n;
+}
+
+int scheduler_take_due(time_t now, device_schedule_t *out)
+{
+    while (due_head < due_n)
+    {
+        sched_entry_t *e = &entries[due[due_head++]];
+        time_t late = now - (time_t)e->st.next_fire;
+        int fire = 1;
+
+        if (e->is_cron)
+        {
+            /* Missed occurrences collapse into this one run (or none) */
+            if (late > SCHEDULE_MISFIRE_GRACE)
+            {
+                fprintf(stderr, "  [Schedule] %s: missed run by %lds, skipping to next\n", e->st.id, (long)late);
+                fire = 0;
+            }
+            e->st.next_fire = cron_next(&e->cron, now);
+        }
+        else
+        {
+            e->st.next_fire = now + e->row.interval_seconds;
+        }
+        if (fire)
+            e->st.last_run = now;
+        e->dirty = 1;
+
+        /* No further occurrence: leave it unarmed */
+        if (e->st.next_fire >= 0)
+            arm(e);
+
+        if (fire)
+        {
+            *out = e->row;
+            return 1;
+        }
+    }
+    due_head = 0;
+    due_n = 0;
+    flush_state();
+    return 0;
+}
+
+int scheduler_alert_due(const char *id, time_t now, int cooldown_sec)
+{
+    const sched_entry_t *e = find_entry(id);
+    return !e || now - (time_t)e->st.last_alert >= cooldown_sec;
+}
+
+void scheduler_alerted(const char *id, time_t now)
+{
+    sched_entry_t *e = find_entry(id);
+    if (e)
+    {
+        e->st.last_alert = now;
+        e->dirty = 1;
+    }
+}
+
+void scheduler_cleanup(void)
+{
+    flush_state();
+    install(NULL, 0, NULL, 0, NULL);
+    sdb = NULL;
+}
@@ -0,0 +1,249 @@
+/**
+ * Built-in sensor drivers for PhytoPi
+ * Adapters that expose the BME680, soil probes, photoelectric water level
+ * and fan duty through the sensor registry.
+ */
+#include "../lib/sensor_drivers.h"
+#include "../lib/bme680.h"
+#include "../lib/soil.h"
+#include "../lib/gpio.h"
+#include "../lib/interlock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 5-state frequency bands (Hz): 20=empty, 50=DP1, 100=DP2, 200=DP3, 400=DP4. Hysteresis 8 Hz. */
+#define WATER_BAND_0_MAX 35 /* <35 Hz = Empty (0) */
+#define WATER_BAND_1_MIN 27 /* 35-75 = Low (1), hysteresis: exit at 27 */
+#define WATER_BAND_1_MAX 83
+#define WATER_BAND_2_MIN 67
+#define WATER_BAND_2_MAX 158
+#define WATER_BAND_3_MIN 142
+#define WATER_BAND_3_MAX 308
+#define WATER_BAND_4_MIN 292 /* >300 = Full (4), hysteresis: enter at 292 */
+
+/*
+ * -------------------------------
+ * BME680 (temp, humidity, pressure, gas)
+ *-------------------------------
+ */
+static metric_desc_t bme_metrics[] = {
+    {.name = "temp_c", .unit = "celsius", .deadband = 1, .persist = 1},
+    {.name = "humidity", .unit = "percent", .deadband = 2, .persist = 1},
+    {.name = "pressure", .unit = "hPa", .deadband = 2, .persist = 1},
+    {.name = "gas_resistance", .unit = "kOhm", .deadband = 5, .persist = 1},
+};
+
+static int bme_init(sensor_driver_t *drv)
+{
+    bme_metrics[0].sensor_id = getenv("SUPABASE_TEMPERATURE_SENSOR_ID");
+    bme_metrics[1].sensor_id = getenv("SUPABASE_HUMIDITY_SENSOR_ID");
+    bme_metrics[2].sensor_id = getenv("SUPABASE_PRESSURE_SENSOR_ID");
+    bme_metrics[3].sensor_id = getenv("SUPABASE_GAS_SENSOR_ID");
+    return bme680_init();
+}
+
+static int bme_trigger(sensor_driver_t *drv)
+{
+    return bme680_trigger();
+}
+
+static int bme_collect(sensor_driver_t *drv, double *values)
+{
+    bme680_data_t data;
+    if (bme680_collect(&data) != 0 || !data.valid)
+        return -1;
+    values[0] = data.temperature;
+    values[1] = data.humidity;
+    values[2] = data.pressure;
+    values[3] = data.gas_resistance;
+    return 0;
+}
+
+static void bme_cleanup(sensor_driver_t *drv)
+{
+    bme680_cleanup();
+}
+
+static sensor_driver_t bme_driver = {
+    .name = "bme680",
+    .period_sec = 3, /* every 3s for stability */
+    .init = bme_init,
+    .trigger = bme_trigger,
+    .collect = bme_collect,
+    .cleanup = bme_cleanup,
+    .metrics = bme_metrics,
+    .n_metrics = sizeof(bme_metrics) / sizeof(bme_metrics[0]),
+    .fail_alert_type = "sensor_failure_bme680",
+    .fail_alert_msg = "BME680 sensor unreachable after repeated failures",
+};
+
+/*
+ * -------------------------------
+ * SOIL PROBES (PCF8591, one metric per probe)
+ *-------------------------------
+ */
+static metric_desc_t soil_metrics[SOIL_MAX_PROBES];
+
+static int soil_init(sensor_driver_t *drv)
+{
+    int n = soil_probes_init();
+    drv->n_metrics = 0;
+    if (n <= 0)
+        return -1;
+    for (int p = 0; p < n; p++)
+    {
+        metric_desc_t *m = &soil_metrics[p];
+        /* Probe 0 keeps the historical "soil_moisture" name */
+        if (p == 0)
+            snprintf(m->name, sizeof(m->name), "soil_moisture");
+        else
+            snprintf(m->name, sizeof(m->name), "soil_moisture.%d", p);
+        snprintf(m->group, sizeof(m->group), "soil_moisture");
+        m->unit = "percent";
+        m->deadband = 2; /* percent points */
+        m->persist = 1;
+        m->sensor_id = soil_probe_get(p)->sensor_id;
+    }
+    drv->n_metrics = n;
+    return 0;
+}
+
+static int soil_collect(sensor_driver_t *drv, double *values)
+{
+    if (soil_probes_scan() == 0)
+        return -1;
+    for (int p = 0; p < drv->n_metrics; p++)
+    {
+        int pct = soil_probe_get(p)->pct;
+        values[p] = (pct >= 0) ? (double)pct : SENSOR_VALUE_INVALID;
+    }
+    return 0;
+}
+
+static void soil_cleanup(sensor_driver_t *drv)
+{
+    soil_probes_cleanup();
+}
+
+static sensor_driver_t soil_driver = {
+    .name = "soil",
+    .period_sec = DATA_READ_INTERVAL,
+    .init = soil_init,
+    .collect = soil_collect,
+    .cleanup = soil_cleanup,
+    .metrics = soil_metrics,
+};
+
+/*
+ * -------------------------------
+ * PHOTOELECTRIC WATER LEVEL
+ * "water_level" is the 0-4 state that gets stored and synced;
+ * "water_level_hz" is the live frequency behind the water_level_low threshold.
+ *-------------------------------
+ */
+static metric_desc_t water_metrics[] = {
+    {.name = "water_level", .unit = "level", .deadband = 1, .persist = 1},
+    {.name = "water_level_hz", .group = "water_level_low", .unit = "Hz", .persist = 0},
+};
+
+static int water_state = -1;
+
+/*
+ * Map photoelectric frequency (Hz) to 5-state water level (0-4) with hysteresis.
+ * 0=Empty, 1=Low, 2=Mid, 3=High, 4=Full
+ */
+int frequency_to_water_state(int hz, int last_state)
+{
+    if (hz < 0)
+        return last_state >= 0 ? last_state : 0;
+    if (hz < WATER_BAND_0_MAX)
+        return 0;
+    if (hz < WATER_BAND_1_MIN)
+        return (last_state == 0) ? 0 : 1;
+    if (hz < WATER_BAND_1_MAX)
+        return 1;
+    if (hz < WATER_BAND_2_MIN)
+        return (last_state == 1) ? 1 : 2;
+    if (hz < WATER_BAND_2_MAX)
+        return 2;
+    if (hz < WATER_BAND_3_MIN)
+        return (last_state == 2) ? 2 : 3;
+    if (hz < WATER_BAND_3_MAX)
+        return 3;
+    if (hz < WATER_BAND_4_MIN)
+        return (last_state == 3) ? 3 : 4;
+    return 4;
+}
+
+static int water_init(sensor_driver_t *drv)
+{
+    water_metrics[0].sensor_id = getenv("SUPABASE_WATER_LEVEL_PHOTOELECTRIC_SENSOR_ID");
+    return 0;
+}
+
+static int water_collect(sensor_driver_t *drv, double *values)
+{
+    int hz = -1;
+    /* The interlock measures continuously from the edge stream; without it,
+     * measure here and let the interlock see every reading */
+    if (interlock_water_hz(&hz) != 0)
+    {
+        if (read_photoelectric_water_level(&hz) != 0 || hz < 0)
+            return -1;
+        interlock_feed(hz);
+    }
+    water_state = frequency_to_water_state(hz, water_state);
+    values[0] = water_state;
+    values[1] = hz;
+    return 0;
+}
+
+static sensor_driver_t water_driver = {
+    .name = "photoelectric",
+    .period_sec = 2,
+    .init = water_init,
+    .collect = water_collect,
+    .metrics = water_metrics,
+    .n_metrics = sizeof(water_metrics) / sizeof(water_metrics[0]),
+    .fail_alert_type = "sensor_failure_photoelectric",
+    .fail_alert_msg = "Photoelectric water level sensor unreachable",
+};
+
+/*
+ * -------------------------------
+ * FAN DUTY (actuator state exposed as a live metric)
+ *-------------------------------
+ */
+static metric_desc_t fan_metrics[] = {
+    {.name = "fan_duty", .unit = "percent", .persist = 0},
+};
+
+static int fan_collect(sensor_driver_t *drv, double *values)
+{
+    const int *duty = (const int *)drv->ctx;
+    if (!duty)
+        return -1;
+    values[0] = *duty;
+    return 0;
+}
+
+static sensor_driver_t fan_driver = {
+    .name = "fan_duty",
+    .period_sec = 0, /* every tick */
+    .collect = fan_collect,
+    .metrics = fan_metrics,
+    .n_metrics = 1,
+};
+
+int sensor_drivers_register_builtin(const int *fan_duty)
+{
+    fan_driver.ctx = (void *)fan_duty;
+    if (sensors_register(&bme_driver) != 0 ||
+        sensors_register(&soil_driver) != 0 ||
+        sensors_register(&water_driver) != 0 ||
+        sensors_register(&fan_driver) != 0)
+        return -1;
+    return 0;
+}
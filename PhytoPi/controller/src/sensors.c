@@ -0,0 +1,290 @@
+/**
+ * Sensor driver registry for PhytoPi
+ * Drivers declare their metrics once; polling cadence, deadband storage,
+ * sync mapping and threshold lookups all work off the resulting table.
+ */
+#include "../lib/sensors.h"
+#include "../lib/sql.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define METRIC_HASH_SIZE 128 /* power of two, > 2 * SENSOR_MAX_METRICS */
+
+static sensor_driver_t *drivers[SENSOR_MAX_DRIVERS];
+static int driver_count = 0;
+
+static sensor_metric_t metrics[SENSOR_MAX_METRICS];
+static int metric_count = 0;
+
+/* Open-addressing tables: slot holds metric index + 1, 0 = empty */
+static int name_slots[METRIC_HASH_SIZE];
+static int group_slots[METRIC_HASH_SIZE];
+
+/*
+ * Helper: FNV-1a string hash
+ */
+static unsigned int hash_str(const char *s)
+{
+    unsigned int h = 2166136261u;
+    while (*s)
+    {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Helper: insert into a hash table unless the key is already present.
+ * by_group selects whether the descriptor's name or group is the key.
+ * Returns 1 if inserted, 0 if already present, -1 if full.
+ */
+static int hash_insert(int *slots, const char *key, int idx, int by_group)
+{
+    unsigned int h = hash_str(key) & (METRIC_HASH_SIZE - 1);
+    for (int probe = 0; probe < METRIC_HASH_SIZE; probe++)
+    {
+        int *slot = &slots[(h + probe) & (METRIC_HASH_SIZE - 1)];
+        if (*slot == 0)
+        {
+            *slot = idx + 1;
+            return 1;
+        }
+        const metric_desc_t *d = metrics[*slot - 1].desc;
+        if (strcmp(by_group ? d->group : d->name, key) == 0)
+            return 0;
+    }
+    return -1;
+}
+
+static int hash_lookup(const int *slots, const char *key, int by_group)
+{
+    if (!key)
+        return -1;
+    unsigned int h = hash_str(key) & (METRIC_HASH_SIZE - 1);
+    for (int probe = 0; probe < METRIC_HASH_SIZE; probe++)
+    {
+        int slot = slots[(h + probe) & (METRIC_HASH_SIZE - 1)];
+        if (slot == 0)
+            return -1;
+        const metric_desc_t *d = metrics[slot - 1].desc;
+        if (strcmp(by_group ? d->group : d->name, key) == 0)
+            return slot - 1;
+    }
+    return -1;
+}
+
+int sensors_register(sensor_driver_t *drv)
+{
+    if (!drv || !drv->collect || driver_count >= SENSOR_MAX_DRIVERS)
+        return -1;
+    drivers[driver_count++] = drv;
+    return 0;
+}
+
+int sensors_init(void)
+{
+    metric_count = 0;
+    memset(name_slots, 0, sizeof(name_slots));
+    memset(group_slots, 0, sizeof(group_slots));
+
+    for (int d = 0; d < driver_count; d++)
+    {
+        sensor_driver_t *drv = drivers[d];
+        drv->init_ok = drv->init ? (drv->init(drv) == 0) : 1;
+        if (!drv->init_ok)
+            fprintf(stderr, "Warning: sensor driver '%s' init failed\n", drv->name);
+        drv->fail_count = 0;
+        drv->last_poll = 0;
+        drv->last_fail_alert = 0;
+        drv->first_metric = metric_count;
+
+        for (int m = 0; m < drv->n_metrics; m++)
+        {
+            if (metric_count >= SENSOR_MAX_METRICS)
+            {
+                fprintf(stderr, "Warning: more than %d metrics, '%s' truncated\n", SENSOR_MAX_METRICS, drv->name);
+                drv->n_metrics = m;
+                break;
+            }
+            metric_desc_t *desc = &drv->metrics[m];
+            if (!desc->group[0])
+                snprintf(desc->group, sizeof(desc->group), "%s", desc->name);
+
+            int idx = metric_count++;
+            sensor_metric_t *sm = &metrics[idx];
+            sm->desc = desc;
+            sm->drv = drv;
+            sm->value = SENSOR_VALUE_INVALID;
+            sm->valid = 0;
+            sm->last_saved = SENSOR_VALUE_INVALID;
+            sm->last_saved_ts = 0;
+            sm->next_in_group = -1;
+
+            if (hash_insert(name_slots, desc->name, idx, 0) == 0)
+                fprintf(stderr, "Warning: duplicate metric name '%s'\n", desc->name);
+
+            /* Chain metrics sharing a group behind the first one */
+            int head = hash_lookup(group_slots, desc->group, 1);
+            if (head < 0)
+                hash_insert(group_slots, desc->group, idx, 1);
+            else
+            {
+                while (metrics[head].next_in_group >= 0)
+                    head = metrics[head].next_in_group;
+                metrics[head].next_in_group = idx;
+            }
+        }
+    }
+
+    printf("Sensors: %d driver(s), %d metric(s)\n", driver_count, metric_count);
+    return metric_count;
+}
+
+int sensors_poll(time_t now)
+{
+    sensor_driver_t *due[SENSOR_MAX_DRIVERS];
+    int trigger_failed[SENSOR_MAX_DRIVERS];
+    int n_due = 0;
+
+    for (int d = 0; d < driver_count; d++)
+    {
+        sensor_driver_t *drv = drivers[d];
+        if (now - drv->last_poll < drv->period_sec)
+            continue;
+        drv->last_poll = now;
+        trigger_failed[n_due] = drv->trigger && drv->trigger(drv) != 0;
+        due[n_due++] = drv;
+    }
+
+    for (int i = 0; i < n_due; i++)
+    {
+        sensor_driver_t *drv = due[i];
+        double values[SENSOR_MAX_METRICS];
+        for (int m = 0; m < drv->n_metrics; m++)
+            values[m] = SENSOR_VALUE_INVALID;
+
+        /* No measurement was started: skip collect so the poll counts one failure */
+        if (!trigger_failed[i] && drv->collect(drv, values) == 0)
+        {
+            drv->fail_count = 0;
+            for (int m = 0; m < drv->n_metrics; m++)
+            {
+                sensor_metric_t *sm = &metrics[drv->first_metric + m];
+                sm->valid = values[m] > SENSOR_VALUE_INVALID + 1;
+                sm->value = values[m];
+            }
+        }
+        else
+        {
+            drv->fail_count++;
+            if (drv->fail_count % 10 == 0)
+                fprintf(stderr, "Warning: %s read failed (consecutive: %d)\n", drv->name, drv->fail_count);
+            /* Invalidate stale readings so threshold evaluation skips them
+             * rather than using an outdated cached value. */
+            if (drv->fail_count >= SENSOR_FAIL_INVALIDATE_AFTER)
+                for (int m = 0; m < drv->n_metrics; m++)
+                {
+                    metrics[drv->first_metric + m].valid = 0;
+                    metrics[drv->first_metric + m].value = SENSOR_VALUE_INVALID;
+                }
+        }
+    }
+    return n_due;
+}
+
+int sensors_store(sqlite3 *db, time_t now)
+{
+    int stored = 0;
+    for (int i = 0; i < metric_count; i++)
+    {
+        sensor_metric_t *sm = &metrics[i];
+        if (!sm->valid || !sm->desc->persist)
+            continue;
+        if (fabs(sm->value - sm->last_saved) < sm->desc->deadband &&
+            (now - sm->last_saved_ts) < SENSOR_HEARTBEAT_INTERVAL)
+            continue;
+        if (sql_insert_metric_reading(db, sm->desc->name, sm->value, (int)now) == SQLITE_OK)
+        {
+            printf("  -> Saved %s %.1f (was %.1f)\n", sm->desc->name, sm->value, sm->last_saved);
+            sm->last_saved = sm->value;
+            sm->last_saved_ts = now;
+            stored++;
+        }
+    }
+    return stored;
+}
+
+int sensors_metric_count(void)
+{
+    return metric_count;
+}
+
+sensor_metric_t *sensors_metric(int idx)
+{
+    if (idx < 0 || idx >= metric_count)
+        return NULL;
+    return &metrics[idx];
+}
+
+int sensors_metric_find(const char *name)
+{
+    return hash_lookup(name_slots, name, 0);
+}
+
+int sensors_group_find(const char *group)
+{
+    return hash_lookup(group_slots, group, 1);
+}
+
+int sensors_driver_count(void)
+{
+    return driver_count;
+}
+
+sensor_driver_t *sensors_driver(int idx)
+{
+    if (idx < 0 || idx >= driver_count)
+        return NULL;
+    return drivers[idx];
+}
+
+sensor_driver_t *sensors_driver_find(const char *name)
+{
+    for (int d = 0; d < driver_count; d++)
+        if (strcmp(drivers[d]->name, name) == 0)
+            return drivers[d];
+    return NULL;
+}
+
+int sensors_driver_all_valid(const sensor_driver_t *drv)
+{
+    if (!drv || drv->n_metrics == 0)
+        return 0;
+    for (int m = 0; m < drv->n_metrics; m++)
+        if (!metrics[drv->first_metric + m].valid)
+            return 0;
+    return 1;
+}
+
+void sensors_cleanup(void)
+{
+    for (int d = 0; d < driver_count; d++)
+        if (drivers[d]->cleanup)
+            drivers[d]->cleanup(drivers[d]);
+}
+
+void sensors_print(time_t now, const char *prefix)
+{
+    printf("[%ld] %s", now, prefix ? prefix : "");
+    for (int i = 0; i < metric_count; i++)
+    {
+        if (metrics[i].valid)
+            printf(" %s=%.1f", metrics[i].desc->name, metrics[i].value);
+        else
+            printf(" %s=-", metrics[i].desc->name);
+    }
+    printf("\n");
+}
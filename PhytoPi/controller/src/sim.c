@@ -0,0 +1,544 @@
+/**
+ * Simulated hardware backend for PhytoPi (make SIM=1)
+ * Implements the gpio.h and bme680.h interfaces without a Pi so the full
+ * loop, storage and sync can be run and profiled on a workstation.
+ */
+#define SIM_NO_REDIRECT
+#include "../lib/gpio.h"
+#include "../lib/bme680.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SIM_MAX_FAULTS 32
+#define SIM_MAX_FDS 256
+#define SIM_SOIL_DRY_RATE 0.005   /* raw ADC counts lost per second */
+#define SIM_PUMP_WET_RATE 0.5     /* raw ADC counts gained per pump second */
+#define SIM_PUMP_DRAIN_RATE 0.2   /* water level Hz lost per pump second */
+#define SIM_THERMAL_TAU 120.0     /* actuator effect time constant (s) */
+#define SIM_LIGHTS_HEAT 2.0       /* deg C at lights on, steady state */
+#define SIM_FAN_COOL 3.0          /* deg C at 100 % fan, steady state */
+#define SIM_FAN_DRY 8.0           /* RH points at 100 % fan, steady state */
+
+enum { SIG_TEMP, SIG_HUMIDITY, SIG_PRESSURE, SIG_GAS, SIG_SOIL, SIG_WATER, SIG_COUNT };
+
+typedef struct {
+    double base;
+    double amp;
+    double period;
+    double noise;
+} sim_wave_t;
+
+typedef struct {
+    char dev[16];
+    double start;
+    double end; /* < 0 = until exit */
+} sim_fault_t;
+
+static const char *sig_env[SIG_COUNT] = {
+    "SIM_WAVE_TEMP", "SIM_WAVE_HUMIDITY", "SIM_WAVE_PRESSURE",
+    "SIM_WAVE_GAS", "SIM_WAVE_SOIL", "SIM_WAVE_WATER",
+};
+
+static sim_wave_t waves[SIG_COUNT] = {
+    [SIG_TEMP] = {23.0, 3.0, 86400, 0.15},
+    [SIG_HUMIDITY] = {55.0, 8.0, 86400, 0.8},
+    [SIG_PRESSURE] = {1013.0, 1.5, 43200, 0.2},
+    [SIG_GAS] = {120.0, 20.0, 3600, 3.0},
+    [SIG_SOIL] = {75.0, 0.0, 0, 1.5},
+    [SIG_WATER] = {350.0, 0.0, 0, 4.0},
+};
+
+static sim_fault_t faults[SIM_MAX_FAULTS];
+static int fault_count = 0;
+
+static int sim_ready = 0;
+static double speed = 1.0;
+static double duration = -1.0;
+static double skipped = 0.0;
+static struct timespec real_start;
+static time_t wall_start;
+static unsigned int seed = 1;
+
+/* Actuators */
+static int lights = 0;
+static int pump = 0;
+static int pump_locked = 0;
+static int fan_duty[2] = {0, 0};
+
+/* Plant model */
+static double model_t = 0.0;
+static double soil_offset = 0.0;
+static double water_offset = 0.0;
+static double heat_offset = 0.0;
+static double dry_offset = 0.0;
+
+/* Climate seen by the BME680, for sim_report() */
+static double temp_sum, temp_min = INFINITY, temp_max = -INFINITY;
+static double fan_duty_seconds = 0.0;
+
+/* Bus handles: fd -> PCF8591 address */
+static int fd_addr[SIM_MAX_FDS];
+
+/* Counters for sim_report() */
+static long n_light_writes, n_pump_writes, n_pwm_writes;
+static long n_bme_reads, n_adc_scans, n_water_reads, n_faulted;
+static double pump_seconds = 0.0;
+
+/*
+ * Helper: parse "base:amp:period:noise" into a waveform, keeping defaults for missing fields
+ */
+static void parse_wave(const char *s, sim_wave_t *w)
+{
+    double v[4] = {w->base, w->amp, w->period, w->noise};
+    int n = sscanf(s, "%lf:%lf:%lf:%lf", &v[0], &v[1], &v[2], &v[3]);
+    if (n <= 0)
+    {
+        fprintf(stderr, "Sim: ignoring malformed waveform '%s'\n", s);
+        return;
+    }
+    w->base = v[0];
+    w->amp = v[1];
+    w->period = v[2];
+    w->noise = v[3];
+}
+
+/*
+ * Helper: parse "dev@start[+duration];..." into the fault table
+ */
+static void parse_faults(const char *s)
+{
+    char *copy = strdup(s);
+    if (!copy)
+        return;
+    char *save = NULL;
+    for (char *tok = strtok_r(copy, ";", &save); tok && fault_count < SIM_MAX_FAULTS; tok = strtok_r(NULL, ";", &save))
+    {
+        sim_fault_t *f = &faults[fault_count];
+        double start = 0, dur = -1;
+        char dev[16];
+        int n = sscanf(tok, "%15[^@]@%lf+%lf", dev, &start, &dur);
+        if (n < 2)
+        {
+            fprintf(stderr, "Sim: ignoring malformed fault '%s'\n", tok);
+            continue;
+        }
+        snprintf(f->dev, sizeof(f->dev), "%s", dev);
+        f->start = start;
+        f->end = (n == 3) ? start + dur : -1;
+        fault_count++;
+    }
+    free(copy);
+}
+
+static void sim_setup(void)
+{
+    if (sim_ready)
+        return;
+    sim_ready = 1;
+
+    const char *env = getenv("SIM_SPEED");
+    if (env && env[0])
+        speed = atof(env);
+    if (speed < 0)
+        speed = 0;
+    env = getenv("SIM_DURATION");
+    if (env && env[0])
+        duration = atof(env);
+    env = getenv("SIM_SEED");
+    if (env && env[0])
+        seed = (unsigned int)strtoul(env, NULL, 0);
+    for (int i = 0; i < SIG_COUNT; i++)
+    {
+        env = getenv(sig_env[i]);
+        if (env && env[0])
+            parse_wave(env, &waves[i]);
+    }
+    env = getenv("SIM_FAULTS");
+    if (env && env[0])
+        parse_faults(env);
+
+    for (int i = 0; i < SIM_MAX_FDS; i++)
+        fd_addr[i] = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+    wall_start = time(NULL);
+    printf("Sim: hardware backend active, speed %.1fx, %d fault(s) scripted\n", speed, fault_count);
+}
+
+/*
+ * Helper: virtual seconds since start
+ */
+static double sim_elapsed(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double real = (double)(now.tv_sec - real_start.tv_sec) + (now.tv_nsec - real_start.tv_nsec) / 1e9;
+    return skipped + real * speed;
+}
+
+time_t sim_time(time_t *t)
+{
+    sim_setup();
+    time_t v = wall_start + (time_t)sim_elapsed();
+    if (t)
+        *t = v;
+    return v;
+}
+
+unsigned int sim_sleep(unsigned int seconds)
+{
+    sim_setup();
+    if (speed <= 0)
+    {
+        skipped += seconds;
+        return 0;
+    }
+    double real = seconds / speed;
+    struct timespec ts = {(time_t)real, (long)((real - (time_t)real) * 1e9)};
+    nanosleep(&ts, NULL);
+    return 0;
+}
+
+/*
+ * Helper: standard normal sample (Box-Muller)
+ */
+static double gauss(void)
+{
+    double u1 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double wave(int sig, double t)
+{
+    const sim_wave_t *w = &waves[sig];
+    double v = w->base;
+    if (w->period > 0)
+        v += w->amp * sin(2.0 * M_PI * t / w->period);
+    if (w->noise > 0)
+        v += w->noise * gauss();
+    return v;
+}
+
+/*
+ * Helper: integrate the plant model up to the current virtual time
+ */
+static double sim_advance(void)
+{
+    sim_setup();
+    double t = sim_elapsed();
+    double dt = t - model_t;
+    if (dt <= 0)
+        return t;
+    model_t = t;
+
+    soil_offset -= SIM_SOIL_DRY_RATE * dt;
+    if (pump)
+    {
+        soil_offset += SIM_PUMP_WET_RATE * dt;
+        water_offset -= SIM_PUMP_DRAIN_RATE * dt;
+        pump_seconds += dt;
+    }
+    if (soil_offset < -waves[SIG_SOIL].base)
+        soil_offset = -waves[SIG_SOIL].base;
+    if (soil_offset > 255)
+        soil_offset = 255;
+
+    double duty = (fan_duty[0] + fan_duty[1]) / 200.0;
+    fan_duty_seconds += duty * 100.0 * dt;
+    double k = 1.0 - exp(-dt / SIM_THERMAL_TAU);
+    heat_offset += ((lights ? SIM_LIGHTS_HEAT : 0.0) - SIM_FAN_COOL * duty - heat_offset) * k;
+    dry_offset += (SIM_FAN_DRY * duty - dry_offset) * k;
+    return t;
+}
+
+static int sim_fault(const char *dev)
+{
+    double t = sim_advance();
+    for (int i = 0; i < fault_count; i++)
+    {
+        if (strcmp(faults[i].dev, dev) != 0 || t < faults[i].start)
+            continue;
+        if (faults[i].end < 0 || t < faults[i].end)
+        {
+            n_faulted++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void sim_report(void)
+{
+    if (!sim_ready)
+        return;
+    printf("Sim: %.0f virtual s, lights writes %ld, pump writes %ld (%.0f s on), pwm writes %ld\n",
+           sim_elapsed(), n_light_writes, n_pump_writes, pump_seconds, n_pwm_writes);
+    printf("Sim: bme680 reads %ld, adc scans %ld, water reads %ld, faulted calls %ld\n",
+           n_bme_reads, n_adc_scans, n_water_reads, n_faulted);
+    if (n_bme_reads > 0)
+        printf("Sim: temperature mean %.2f C (min %.2f, max %.2f), mean fan duty %.1f%%\n",
+               temp_sum / n_bme_reads, temp_min, temp_max, model_t > 0 ? fan_duty_seconds / model_t : 0.0);
+}
+
+int sim_done(void)
+{
+    sim_setup();
+    return duration >= 0 && sim_elapsed() >= duration;
+}
+
+/*
+ * -------------------------------
+ * GPIO
+ *-------------------------------
+ */
+int gpio_init(int pin)
+{
+    sim_setup();
+    return 0;
+}
+
+int gpio_config_input(int pin)
+{
+    return 0;
+}
+
+int gpio_config_output(int pin)
+{
+    return 0;
+}
+
+int gpio_write(int value)
+{
+    return 0;
+}
+
+int gpio_read(void)
+{
+    return 0;
+}
+
+int gpio_cleanup(void)
+{
+    sim_report();
+    return 0;
+}
+
+int actuators_init(void)
+{
+    sim_setup();
+    return 0;
+}
+
+int actuators_set(unsigned int mask, unsigned int values)
+{
+    if (((mask & ACT_LIGHTS) && sim_fault("lights")) || ((mask & ACT_PUMP) && sim_fault("pump")))
+        return -1;
+    int refused = pump_locked && (mask & values & ACT_PUMP);
+    if (refused)
+        values &= ~ACT_PUMP;
+    if (mask & ACT_LIGHTS)
+    {
+        lights = (values & ACT_LIGHTS) ? 1 : 0;
+        n_light_writes++;
+    }
+    if (mask & ACT_PUMP)
+    {
+        pump = (values & ACT_PUMP) ? 1 : 0;
+        n_pump_writes++;
+    }
+    return refused ? -1 : 0;
+}
+
+unsigned int actuators_get(void)
+{
+    return (lights ? ACT_LIGHTS : 0) | (pump ? ACT_PUMP : 0);
+}
+
+int lights_init(void)
+{
+    return sim_fault("lights") ? -1 : 0;
+}
+
+int lights_set(int on)
+{
+    return actuators_set(ACT_LIGHTS, on ? ACT_LIGHTS : 0);
+}
+
+int pump_init(void)
+{
+    return sim_fault("pump") ? -1 : 0;
+}
+
+int pump_set(int on)
+{
+    return actuators_set(ACT_PUMP, on ? ACT_PUMP : 0);
+}
+
+int pump_lockout(int on)
+{
+    pump_locked = on ? 1 : 0;
+    if (!pump_locked || !pump)
+        return 0;
+    sim_advance(); /* account the pump time up to the cut */
+    pump = 0;
+    n_pump_writes++;
+    return 1;
+}
+
+int pump_locked_out(void)
+{
+    return pump_locked;
+}
+
+int fans_init(void)
+{
+    return sim_fault("pwm") ? -1 : 0;
+}
+
+int fans_set_speed(int fan_id, int duty_percent)
+{
+    if (fan_id != 1 && fan_id != 2)
+        return -1;
+    if (sim_fault("pwm"))
+        return -1;
+    if (duty_percent < 0) duty_percent = 0;
+    if (duty_percent > 100) duty_percent = 100;
+    fan_duty[fan_id - 1] = duty_percent;
+    n_pwm_writes++;
+    return 0;
+}
+
+int fans_set_both(int duty_percent)
+{
+    int r1 = fans_set_speed(1, duty_percent);
+    int r2 = fans_set_speed(2, duty_percent);
+    return (r1 == 0 && r2 == 0) ? 0 : -1;
+}
+
+int read_photoelectric_water_level(int *frequency_hz)
+{
+    if (!frequency_hz)
+        return -1;
+    if (sim_fault("water"))
+        return -1;
+    n_water_reads++;
+    double hz = wave(SIG_WATER, model_t) + water_offset;
+    if (hz < 20)
+        hz = 20; /* sensor idles at 20 Hz with no liquid */
+    *frequency_hz = (int)(hz / 10.0 + 0.5) * 10; /* real reading counts edges over 100 ms */
+    return 0;
+}
+
+/* No edge stream in the simulator: the water driver's readings feed the interlock */
+int water_level_watch(void)
+{
+    return -1;
+}
+
+int water_level_read_edges(void)
+{
+    return -1;
+}
+
+/*
+ * -------------------------------
+ * I2C / PCF8591 ADC
+ *-------------------------------
+ */
+int i2c_init(const char *i2c_bus)
+{
+    return i2c_init_addr(i2c_bus, PCF8591_ADDR);
+}
+
+/* Backed by /dev/null so callers can close() the handle as usual */
+int i2c_init_addr(const char *i2c_bus, int addr)
+{
+    sim_setup();
+    if (sim_fault("soil"))
+        return -1;
+    int fd = open("/dev/null", O_RDWR);
+    if (fd < 0 || fd >= SIM_MAX_FDS)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    fd_addr[fd] = addr;
+    return fd;
+}
+
+int read_pcf8591_scan(int fd, int values[PCF8591_CHANNELS])
+{
+    if (fd < 0 || fd >= SIM_MAX_FDS || fd_addr[fd] < 0 || !values)
+        return -1;
+    if (sim_fault("soil"))
+        return -1;
+    n_adc_scans++;
+    for (int ch = 0; ch < PCF8591_CHANNELS; ch++)
+    {
+        /* Spread probes a little so they are distinguishable in the data */
+        double raw = wave(SIG_SOIL, model_t) + soil_offset + ch * 7 + (fd_addr[fd] - PCF8591_ADDR) * 13;
+        if (raw < 0) raw = 0;
+        if (raw > 255) raw = 255;
+        values[ch] = (int)raw;
+    }
+    return 0;
+}
+
+int read_pcf8591_channel(int fd, int channel)
+{
+    int values[PCF8591_CHANNELS];
+    if (channel < 0 || channel > 3 || read_pcf8591_scan(fd, values) != 0)
+        return -1;
+    return values[channel];
+}
+
+/*
+ * -------------------------------
+ * BME680
+ *-------------------------------
+ */
+int bme680_init(void)
+{
+    sim_setup();
+    return sim_fault("bme680") ? -1 : 0;
+}
+
+int bme680_trigger(void)
+{
+    return sim_fault("bme680") ? -1 : 0;
+}
+
+int bme680_collect(bme680_data_t *data)
+{
+    if (!data)
+        return -1;
+    memset(data, 0, sizeof(*data));
+    if (sim_fault("bme680"))
+        return -1;
+    n_bme_reads++;
+    data->temperature = (float)(wave(SIG_TEMP, model_t) + heat_offset);
+    temp_sum += data->temperature;
+    temp_min = fmin(temp_min, data->temperature);
+    temp_max = fmax(temp_max, data->temperature);
+    data->humidity = (float)(wave(SIG_HUMIDITY, model_t) - dry_offset);
+    if (data->humidity < 0) data->humidity = 0;
+    if (data->humidity > 100) data->humidity = 100;
+    data->pressure = (float)wave(SIG_PRESSURE, model_t);
+    data->gas_resistance = (float)wave(SIG_GAS, model_t);
+    data->valid = 1;
+    return 0;
+}
+
+int bme680_read(bme680_data_t *data)
+{
+    if (bme680_trigger() != 0)
+        return -1;
+    return bme680_collect(data);
+}
+
+void bme680_cleanup(void)
+{
+}
@@ -0,0 +1,204 @@
+/**
+ * Soil moisture probe table for PhytoPi
+ * Probes are grouped by (bus, address) so each PCF8591 is read with one
+ * auto-increment scan per tick regardless of how many probes it serves.
+ */
+#include "../lib/soil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SOIL_ADC_MAX_DEFAULT 150
+
+typedef struct {
+    char bus[SOIL_BUS_LEN];
+    int addr;
+    int fd;
+    int values[PCF8591_CHANNELS];
+} soil_adc_t;
+
+static soil_probe_t probes[SOIL_MAX_PROBES];
+static int probe_count = 0;
+static soil_adc_t adcs[SOIL_MAX_ADCS];
+static int adc_count = 0;
+
+/*
+ * Helper: find or open the ADC for a probe's (bus, addr)
+ */
+static int adc_index_for(const char *bus, int addr)
+{
+    for (int i = 0; i < adc_count; i++)
+        if (adcs[i].addr == addr && strcmp(adcs[i].bus, bus) == 0)
+            return i;
+    if (adc_count >= SOIL_MAX_ADCS)
+        return -1;
+
+    soil_adc_t *a = &adcs[adc_count];
+    size_t len = strnlen(bus, sizeof(a->bus) - 1); /* parse_probe rejects longer paths */
+    memcpy(a->bus, bus, len);
+    a->bus[len] = '\0';
+    a->addr = addr;
+    a->fd = i2c_init_addr(bus, addr);
+    for (int ch = 0; ch < PCF8591_CHANNELS; ch++)
+        a->values[ch] = -1;
+    if (a->fd < 0)
+        fprintf(stderr, "Soil: PCF8591 at %s 0x%02x unavailable\n", bus, addr);
+    return adc_count++;
+}
+
+/*
+ * Helper: parse one "bus:addr:channel:raw_dry:raw_wet[:sensor_id]" entry
+ */
+static int parse_probe(char *entry, soil_probe_t *p)
+{
+    char *fields[6] = {0};
+    int n = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(entry, ":", &save); tok && n < 6; tok = strtok_r(NULL, ":", &save))
+        fields[n++] = tok;
+    if (n < 5)
+        return -1;
+
+    size_t bus_len = strlen(fields[0]);
+    if (bus_len >= sizeof(p->bus))
+    {
+        fprintf(stderr, "Soil: bus path '%s' longer than %d characters\n", fields[0], SOIL_BUS_LEN - 1);
+        return -1;
+    }
+    memset(p, 0, sizeof(*p));
+    memcpy(p->bus, fields[0], bus_len + 1);
+    p->addr = (int)strtol(fields[1], NULL, 0);
+    p->channel = atoi(fields[2]);
+    p->raw_dry = atoi(fields[3]);
+    p->raw_wet = atoi(fields[4]);
+    if (n > 5)
+        snprintf(p->sensor_id, sizeof(p->sensor_id), "%s", fields[5]);
+
+    if (p->addr < 0x03 || p->addr > 0x77 || p->channel < 0 || p->channel >= PCF8591_CHANNELS ||
+        p->raw_dry == p->raw_wet)
+        return -1;
+    return 0;
+}
+
+int soil_probes_init(void)
+{
+    probe_count = 0;
+    adc_count = 0;
+
+    const char *table = getenv("SOIL_PROBES");
+    if (table && table[0])
+    {
+        char *copy = strdup(table);
+        if (!copy)
+            return -1;
+        char *save = NULL;
+        for (char *entry = strtok_r(copy, ";", &save); entry; entry = strtok_r(NULL, ";", &save))
+        {
+            if (probe_count >= SOIL_MAX_PROBES)
+            {
+                fprintf(stderr, "Soil: more than %d probes configured, ignoring the rest\n", SOIL_MAX_PROBES);
+                break;
+            }
+            if (parse_probe(entry, &probes[probe_count]) != 0)
+            {
+                fprintf(stderr, "Soil: malformed SOIL_PROBES entry #%d\n", probe_count + 1);
+                free(copy);
+                probe_count = 0;
+                return -1;
+            }
+            probe_count++;
+        }
+        free(copy);
+    }
+    else
+    {
+        /* Legacy single probe: PCF8591_ADDR AIN0, 0..SOIL_ADC_MAX */
+        soil_probe_t *p = &probes[0];
+        memset(p, 0, sizeof(*p));
+        snprintf(p->bus, sizeof(p->bus), "%s", "/dev/i2c-1");
+        p->addr = PCF8591_ADDR;
+        p->channel = 0;
+        p->raw_dry = 0;
+        p->raw_wet = SOIL_ADC_MAX_DEFAULT;
+        const char *max_env = getenv("SOIL_ADC_MAX");
+        if (max_env && max_env[0])
+        {
+            int v = atoi(max_env);
+            if (v >= 1 && v <= 255)
+                p->raw_wet = v;
+        }
+        const char *sid = getenv("SUPABASE_SOIL_MOISTURE_SENSOR_ID");
+        if (sid)
+            snprintf(p->sensor_id, sizeof(p->sensor_id), "%s", sid);
+        probe_count = 1;
+    }
+
+    for (int i = 0; i < probe_count; i++)
+    {
+        probes[i].adc = adc_index_for(probes[i].bus, probes[i].addr);
+        probes[i].raw = -1;
+        probes[i].pct = -1;
+    }
+
+    printf("Soil: %d probe(s) on %d ADC(s)\n", probe_count, adc_count);
+    return probe_count;
+}
+
+int soil_probes_scan(void)
+{
+    for (int a = 0; a < adc_count; a++)
+    {
+        if (adcs[a].fd < 0 || read_pcf8591_scan(adcs[a].fd, adcs[a].values) != 0)
+            for (int ch = 0; ch < PCF8591_CHANNELS; ch++)
+                adcs[a].values[ch] = -1;
+    }
+
+    int valid = 0;
+    for (int i = 0; i < probe_count; i++)
+    {
+        soil_probe_t *p = &probes[i];
+        p->raw = (p->adc >= 0) ? adcs[p->adc].values[p->channel] : -1;
+        p->pct = soil_raw_to_percent(p, p->raw);
+        if (p->pct >= 0)
+            valid++;
+    }
+    return valid;
+}
+
+int soil_probes_count(void)
+{
+    return probe_count;
+}
+
+soil_probe_t *soil_probe_get(int idx)
+{
+    if (idx < 0 || idx >= probe_count)
+        return NULL;
+    return &probes[idx];
+}
+
+int soil_raw_to_percent(const soil_probe_t *p, int raw)
+{
+    if (!p || raw < 0 || p->raw_dry == p->raw_wet)
+        return -1;
+    double pct = 100.0 * (double)(raw - p->raw_dry) / (double)(p->raw_wet - p->raw_dry);
+    if (pct < 0.0)
+        pct = 0.0;
+    if (pct > 100.0)
+        pct = 100.0;
+    return (int)(pct + 0.5);
+}
+
+void soil_probes_cleanup(void)
+{
+    for (int a = 0; a < adc_count; a++)
+    {
+        if (adcs[a].fd >= 0)
+            close(adcs[a].fd);
+        adcs[a].fd = -1;
+    }
+    adc_count = 0;
+    probe_count = 0;
+}
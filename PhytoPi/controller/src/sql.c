@@ -61,107 +61,112 @@ int sql_execute_insert(sqlite3 *db, const char *sql, int data, int data2, int ti
     return SQLITE_OK;
 }
 
-sqlite3 *db_init(const char *db_file)
+/*
+ * Helper: 1 if table exists and has the given column
+ */
+static int table_has_column(sqlite3 *db, const char *table, const char *column)
 {
-    sqlite3 *db;
-    int rc = sqlite3_open(db_file, &db);
-    if (rc)
-    {
-        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
-        return NULL;
-    }
-
-    sql_execute(db, "CREATE TABLE IF NOT EXISTS temp_hum_data (id INTEGER PRIMARY KEY, humidity INTEGER, temperature INTEGER, timestamp INTEGER, synced INTEGER DEFAULT 0);");
-    sql_execute(db, "CREATE TABLE IF NOT EXISTS soil_moisture_data (id INTEGER PRIMARY KEY, humidity INTEGER, timestamp INTEGER, synced INTEGER DEFAULT 0);");
-    sql_execute(db, "CREATE TABLE IF NOT EXISTS water_level_data (id INTEGER PRIMARY KEY, has_water BOOLEAN, timestamp INTEGER, synced INTEGER DEFAULT 0);");
-    sql_execute(db, "CREATE TABLE IF NOT EXISTS bme680_data (id INTEGER PRIMARY KEY, temperature REAL, humidity REAL, pressure REAL, gas_resistance REAL, timestamp INTEGER, synced INTEGER DEFAULT 0);");
-    sql_execute(db, "CREATE TABLE IF NOT EXISTS water_level_photoelectric (id INTEGER PRIMARY KEY, frequency_hz INTEGER, timestamp INTEGER, synced INTEGER DEFAULT 0);");
-
-    // Migrate existing tables: add synced column if it doesn't exist
-    // SQLite doesn't support IF NOT EXISTS for ALTER TABLE, so we check first
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA table_info(%s);", table);
     sqlite3_stmt *check_stmt;
-    int has_synced = 0;
-
-    // Check temp_hum_data
-    if (sqlite3_prepare_v2(db, "PRAGMA table_info(temp_hum_data);", -1, &check_stmt, NULL) == SQLITE_OK)
+    int found = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &check_stmt, NULL) == SQLITE_OK)
     {
         while (sqlite3_step(check_stmt) == SQLITE_ROW)
         {
             const char *col_name = (const char *)sqlite3_column_text(check_stmt, 1);
-            if (col_name && strcmp(col_name, "synced") == 0)
+            if (col_name && strcmp(col_name, column) == 0)
             {
-                has_synced = 1;
+                found = 1;
                 break;
             }
         }
         sqlite3_finalize(check_stmt);
-        if (!has_synced)
-        {
-            sql_execute(db, "ALTER TABLE temp_hum_data ADD COLUMN synced INTEGER DEFAULT 0;");
-        }
     }
+    return found;
+}
 
-    // Check soil_moisture_data
-    has_synced = 0;
-    if (sqlite3_prepare_v2(db, "PRAGMA table_info(soil_moisture_data);", -1, &check_stmt, NULL) == SQLITE_OK)
-    {
-        while (sqlite3_step(check_stmt) == SQLITE_ROW)
-        {
-            const char *col_name = (const char *)sqlite3_column_text(check_stmt, 1);
-            if (col_name && strcmp(col_name, "synced") == 0)
-            {
-                has_synced = 1;
-                break;
-            }
-        }
-        sqlite3_finalize(check_stmt);
-        if (!has_synced)
-        {
-            sql_execute(db, "ALTER TABLE soil_moisture_data ADD COLUMN synced INTEGER DEFAULT 0;");
-        }
-    }
+/*
+ * Helper: move unsynced rows of a pre-registry per-sensor table into
+ * sensor_readings so they are still uploaded, then mark them synced.
+ */
+static void migrate_legacy_table(sqlite3 *db, const char *table, const char *select_sql)
+{
+    if (!table_has_column(db, table, "synced"))
+        return;
+    char sql[1024];
+    snprintf(sql, sizeof(sql),
+             "BEGIN;"
+             "INSERT INTO sensor_readings (metric, value, timestamp) %s;"
+             "UPDATE %s SET synced = 1 WHERE synced = 0;"
+             "COMMIT;",
+             select_sql, table);
+    if (sql_execute(db, sql) != SQLITE_OK)
+        sql_execute(db, "ROLLBACK;");
+}
 
-    // Check water_level_data
-    has_synced = 0;
-    if (sqlite3_prepare_v2(db, "PRAGMA table_info(water_level_data);", -1, &check_stmt, NULL) == SQLITE_OK)
+sqlite3 *db_init(const char *db_file)
+{
+    sqlite3 *db;
+    int rc = sqlite3_open(db_file, &db);
+    if (rc)
     {
-        while (sqlite3_step(check_stmt) == SQLITE_ROW)
-        {
-            const char *col_name = (const char *)sqlite3_column_text(check_stmt, 1);
-            if (col_name && strcmp(col_name, "synced") == 0)
-            {
-                has_synced = 1;
-                break;
-            }
-        }
-        sqlite3_finalize(check_stmt);
-        if (!has_synced)
-        {
-            sql_execute(db, "ALTER TABLE water_level_data ADD COLUMN synced INTEGER DEFAULT 0;");
-        }
+        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+        return NULL;
     }
 
-    // Create indexes for faster unsynced queries
-    sql_execute(db, "CREATE INDEX IF NOT EXISTS idx_temp_hum_synced ON temp_hum_data(synced);");
-    sql_execute(db, "CREATE INDEX IF NOT EXISTS idx_soil_moisture_synced ON soil_moisture_data(synced);");
-    sql_execute(db, "CREATE INDEX IF NOT EXISTS idx_water_level_synced ON water_level_data(synced);");
-    sql_execute(db, "CREATE INDEX IF NOT EXISTS idx_bme680_synced ON bme680_data(synced);");
-    sql_execute(db, "CREATE INDEX IF NOT EXISTS idx_water_photoelectric_synced ON water_level_photoelectric(synced);");
+    // WAL lets the journal's ack thread write without blocking readers here
+    sqlite3_busy_timeout(db, SQL_BUSY_TIMEOUT_MS);
+    sql_execute(db, "PRAGMA journal_mode=WAL;");
+
+    // One table for every metric; the sensor registry maps metric -> Supabase sensor
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS sensor_readings (id INTEGER PRIMARY KEY, metric TEXT NOT NULL, value REAL, timestamp INTEGER, synced INTEGER DEFAULT 0);");
+    sql_execute(db, "CREATE INDEX IF NOT EXISTS idx_sensor_readings_synced ON sensor_readings(synced);");
+
+    // Alerts wait here until the sync path has delivered them
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS alert_outbox (id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT NOT NULL, message TEXT NOT NULL, severity TEXT, source TEXT, timestamp INTEGER NOT NULL);");
+
+    // Last fetched configuration, loaded at startup before any network access
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS threshold_cache (id TEXT PRIMARY KEY, metric TEXT NOT NULL, min_value REAL, max_value REAL, enabled INTEGER, updated_at TEXT);");
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS schedule_cache (id TEXT PRIMARY KEY, schedule_type TEXT NOT NULL, cron_expr TEXT, interval_seconds INTEGER, payload TEXT, enabled INTEGER, updated_at TEXT);");
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS rule_cache (id TEXT PRIMARY KEY, metric TEXT NOT NULL, above INTEGER, on_value REAL, off_value REAL, actuator TEXT NOT NULL, duty_percent INTEGER, min_on_sec INTEGER, min_off_sec INTEGER, max_on_sec INTEGER, enabled INTEGER, updated_at TEXT);");
+
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS schedule_state (id TEXT PRIMARY KEY, cron_expr TEXT, interval_seconds INTEGER, last_run INTEGER, next_fire INTEGER, last_alert INTEGER);");
+
+    // Pump dry-run interlock events, kept locally whether or not they reach Supabase
+    sql_execute(db, "CREATE TABLE IF NOT EXISTS pump_interlock_log (id INTEGER PRIMARY KEY AUTOINCREMENT, event TEXT NOT NULL, water_hz INTEGER, timestamp INTEGER NOT NULL);");
+
+    // Carry over unsynced rows from the old per-sensor tables
+    migrate_legacy_table(db, "temp_hum_data",
+                         "SELECT 'humidity', humidity, timestamp FROM temp_hum_data WHERE synced = 0 "
+                         "UNION ALL SELECT 'temp_c', temperature, timestamp FROM temp_hum_data WHERE synced = 0");
+    if (table_has_column(db, "soil_moisture_data", "probe"))
+        migrate_legacy_table(db, "soil_moisture_data",
+                             "SELECT CASE WHEN probe > 0 THEN 'soil_moisture.' || probe ELSE 'soil_moisture' END, "
+                             "humidity, timestamp FROM soil_moisture_data WHERE synced = 0");
+    else
+        migrate_legacy_table(db, "soil_moisture_data",
+                             "SELECT 'soil_moisture', humidity, timestamp FROM soil_moisture_data WHERE synced = 0");
+    migrate_legacy_table(db, "bme680_data",
+                         "SELECT 'temp_c', temperature, timestamp FROM bme680_data WHERE synced = 0 "
+                         "UNION ALL SELECT 'humidity', humidity, timestamp FROM bme680_data WHERE synced = 0 "
+                         "UNION ALL SELECT 'pressure', pressure, timestamp FROM bme680_data WHERE synced = 0 "
+                         "UNION ALL SELECT 'gas_resistance', gas_resistance, timestamp FROM bme680_data WHERE synced = 0");
+    migrate_legacy_table(db, "water_level_photoelectric",
+                         "SELECT 'water_level', frequency_hz, timestamp FROM water_level_photoelectric WHERE synced = 0");
 
     return db;
 }
 
-int sql_execute_insert_bme680(sqlite3 *db, double temp, double humidity, double pressure, double gas, int timestamp)
+int sql_insert_metric_reading(sqlite3 *db, const char *metric, double value, int timestamp)
 {
-    const char *sql = "INSERT INTO bme680_data (temperature, humidity, pressure, gas_resistance, timestamp) VALUES (?, ?, ?, ?, ?);";
+    const char *sql = "INSERT INTO sensor_readings (metric, value, timestamp) VALUES (?, ?, ?);";
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
         return -1;
-    sqlite3_bind_double(stmt, 1, temp);
-    sqlite3_bind_double(stmt, 2, humidity);
-    sqlite3_bind_double(stmt, 3, pressure);
-    sqlite3_bind_double(stmt, 4, gas);
-    sqlite3_bind_int(stmt, 5, timestamp);
+    sqlite3_bind_text(stmt, 1, metric, -1, SQLITE_STATIC);
+    sqlite3_bind_double(stmt, 2, value);
+    sqlite3_bind_int(stmt, 3, timestamp);
     int rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
     return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
@@ -180,7 +185,7 @@ int sql_execute_insert_double(sqlite3 *db, const char *sql_str, double data, int
 }
 
 /*
- * Get all unsynced readings from all tables
+ * Get unsynced readings (oldest first, at most 500 per call)
  * Returns 0 on success, -1 on failure
  * Caller must free the readings array
  */
@@ -192,19 +197,9 @@ int sql_get_unsynced_readings(sqlite3 *db, sqlite_reading_t **readings, int *cou
     *count = 0;
     *readings = NULL;
 
-    // First, count total unsynced readings
+    // First, count unsynced readings (capped at the batch limit)
     const char *count_sql =
-        "SELECT COUNT(*) FROM ("
-        "  SELECT id FROM temp_hum_data WHERE synced = 0 "
-        "  UNION ALL "
-        "  SELECT id FROM soil_moisture_data WHERE synced = 0 "
-        "  UNION ALL "
-        "  SELECT id FROM water_level_data WHERE synced = 0 "
-        "  UNION ALL "
-        "  SELECT id FROM bme680_data WHERE synced = 0 "
-        "  UNION ALL "
-        "  SELECT id FROM water_level_photoelectric WHERE synced = 0"
-        ");";
+        "SELECT COUNT(*) FROM (SELECT id FROM sensor_readings WHERE synced = 0 LIMIT 500);";
 
     sqlite3_stmt *count_stmt;
     if (sqlite3_prepare_v2(db, count_sql, -1, &count_stmt, NULL) != SQLITE_OK)
@@ -231,130 +226,573 @@ int sql_get_unsynced_readings(sqlite3 *db, sqlite_reading_t **readings, int *cou
     }
 
     int idx = 0;
-
-    // Get unsynced temp_hum_data
-    const char *temp_hum_sql = "SELECT id, humidity, temperature, timestamp FROM temp_hum_data WHERE synced = 0 ORDER BY timestamp LIMIT 100;";
+    const char *sql = "SELECT id, metric, value, timestamp FROM sensor_readings WHERE synced = 0 ORDER BY id LIMIT 500;";
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, temp_hum_sql, -1, &stmt, NULL) == SQLITE_OK)
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK)
     {
         while (sqlite3_step(stmt) == SQLITE_ROW && idx < *count)
         {
+            const char *metric = (const char *)sqlite3_column_text(stmt, 1);
             (*readings)[idx].id = sqlite3_column_int(stmt, 0);
-            (*readings)[idx].value1 = sqlite3_column_int(stmt, 1);
-            (*readings)[idx].value2 = sqlite3_column_int(stmt, 2);
-            (*readings)[idx].value3 = 0;
-            (*readings)[idx].value4 = 0;
+            snprintf((*readings)[idx].metric, sizeof((*readings)[idx].metric), "%s", metric ? metric : "");
+            (*readings)[idx].value = sqlite3_column_double(stmt, 2);
             (*readings)[idx].timestamp = sqlite3_column_int64(stmt, 3);
-            strcpy((*readings)[idx].table_name, "temp_hum_data");
             idx++;
         }
         sqlite3_finalize(stmt);
     }
 
-    // Get unsynced soil_moisture_data
-    const char *soil_sql = "SELECT id, humidity, timestamp FROM soil_moisture_data WHERE synced = 0 ORDER BY timestamp LIMIT 100;";
-    if (sqlite3_prepare_v2(db, soil_sql, -1, &stmt, NULL) == SQLITE_OK)
+    *count = idx; // Update count to actual number retrieved
+    return 0;
+}
+
+/*
+ * Mark a reading as synced
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_mark_as_synced(sqlite3 *db, const char *table_name, int id)
+{
+    if (!db || !table_name)
+        return -1;
+
+    char sql[256];
+    snprintf(sql, sizeof(sql), "UPDATE %s SET synced = 1 WHERE id = ?;", table_name);
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
     {
-        while (sqlite3_step(stmt) == SQLITE_ROW && idx < *count)
+        fprintf(stderr, "Failed to mark as synced: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
+
+    return SQLITE_OK;
+}
+
+/*
+ * Record one pump interlock event
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_log_interlock(sqlite3 *db, const char *event, int water_hz, int64_t timestamp)
+{
+    if (!db || !event)
+        return -1;
+
+    const char *sql = "INSERT INTO pump_interlock_log (event, water_hz, timestamp) VALUES (?, ?, ?);";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_text(stmt, 1, event, -1, SQLITE_STATIC);
+    if (water_hz >= 0)
+        sqlite3_bind_int(stmt, 2, water_hz);
+    else
+        sqlite3_bind_null(stmt, 2);
+    sqlite3_bind_int64(stmt, 3, timestamp);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Failed to log interlock event: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * Queue an alert for delivery
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_alert_enqueue(sqlite3 *db, const char *type, const char *message, const char *severity,
+                      const char *source, int64_t timestamp)
+{
+    if (!db || !type || !message)
+        return -1;
+
+    const char *sql = "INSERT INTO alert_outbox (type, message, severity, source, timestamp) VALUES (?, ?, ?, ?, ?);";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_text(stmt, 1, type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, message, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, severity ? severity : "medium", -1, SQLITE_STATIC);
+    if (source)
+        sqlite3_bind_text(stmt, 4, source, -1, SQLITE_STATIC);
+    else
+        sqlite3_bind_null(stmt, 4);
+    sqlite3_bind_int64(stmt, 5, timestamp);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Failed to queue alert: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * Get up to max queued alerts, oldest first
+ * Returns 0 on success, -1 on failure
+ * Caller must free the alerts array
+ */
+int sql_get_queued_alerts(sqlite3 *db, sqlite_alert_t **alerts, int *count, int max)
+{
+    if (!db || !alerts || !count || max <= 0)
+        return -1;
+
+    *count = 0;
+    *alerts = NULL;
+
+    const char *sql = "SELECT id, type, message, severity, source, timestamp FROM alert_outbox ORDER BY id LIMIT ?;";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, max);
+
+    int cap = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if (*count == cap)
         {
-            (*readings)[idx].id = sqlite3_column_int(stmt, 0);
-            (*readings)[idx].value1 = sqlite3_column_int(stmt, 1);
-            (*readings)[idx].value2 = 0;
-            (*readings)[idx].value3 = 0;
-            (*readings)[idx].value4 = 0;
-            (*readings)[idx].timestamp = sqlite3_column_int64(stmt, 2);
-            strcpy((*readings)[idx].table_name, "soil_moisture_data");
-            idx++;
+            cap = cap ? cap * 2 : 16;
+            sqlite_alert_t *grown = (sqlite_alert_t *)realloc(*alerts, (size_t)cap * sizeof(sqlite_alert_t));
+            if (!grown)
+                break;
+            *alerts = grown;
         }
-        sqlite3_finalize(stmt);
+        sqlite_alert_t *a = &(*alerts)[*count];
+        const char *type = (const char *)sqlite3_column_text(stmt, 1);
+        const char *message = (const char *)sqlite3_column_text(stmt, 2);
+        const char *severity = (const char *)sqlite3_column_text(stmt, 3);
+        const char *source = (const char *)sqlite3_column_text(stmt, 4);
+        a->id = sqlite3_column_int64(stmt, 0);
+        snprintf(a->type, sizeof(a->type), "%s", type ? type : "");
+        snprintf(a->message, sizeof(a->message), "%s", message ? message : "");
+        snprintf(a->severity, sizeof(a->severity), "%s", severity ? severity : "medium");
+        snprintf(a->source, sizeof(a->source), "%s", source ? source : "");
+        a->timestamp = sqlite3_column_int64(stmt, 5);
+        (*count)++;
     }
+    sqlite3_finalize(stmt);
+    return 0;
+}
 
-    // Get unsynced water_level_data
-    const char *water_sql = "SELECT id, has_water, timestamp FROM water_level_data WHERE synced = 0 ORDER BY timestamp LIMIT 100;";
-    if (sqlite3_prepare_v2(db, water_sql, -1, &stmt, NULL) == SQLITE_OK)
+/*
+ * Remove delivered alerts (every queued alert with id <= last_id)
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_delete_alerts_upto(sqlite3 *db, int64_t last_id)
+{
+    if (!db)
+        return -1;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM alert_outbox WHERE id <= ?;", -1, &stmt, NULL) != SQLITE_OK)
     {
-        while (sqlite3_step(stmt) == SQLITE_ROW && idx < *count)
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, last_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Failed to delete delivered alerts: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * Helper: run the prepared insert once per row inside one transaction after
+ * clearing the table. bind() fills the statement for row i.
+ * Returns SQLITE_OK on success, error code on failure (cache left unchanged)
+ */
+static int replace_cache(sqlite3 *db, const char *table, const char *insert_sql, int count,
+                         void (*bind)(sqlite3_stmt *stmt, const void *rows, int i), const void *rows)
+{
+    char clear_sql[64];
+    snprintf(clear_sql, sizeof(clear_sql), "DELETE FROM %s;", table);
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, insert_sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    int rc = sql_execute(db, "BEGIN;");
+    if (rc == SQLITE_OK)
+        rc = sql_execute(db, clear_sql);
+    for (int i = 0; i < count && rc == SQLITE_OK; i++)
+    {
+        bind(stmt, rows, i);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            rc = sqlite3_errcode(db);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to update %s: %s\n", table, sqlite3_errmsg(db));
+        sql_execute(db, "ROLLBACK;");
+        return rc;
+    }
+    return sql_execute(db, "COMMIT;");
+}
+
+static void bind_threshold(sqlite3_stmt *stmt, const void *rows, int i)
+{
+    const device_threshold_t *t = &((const device_threshold_t *)rows)[i];
+    sqlite3_bind_text(stmt, 1, t->id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, t->metric, -1, SQLITE_STATIC);
+    sqlite3_bind_double(stmt, 3, t->min_value);
+    sqlite3_bind_double(stmt, 4, t->max_value);
+    sqlite3_bind_int(stmt, 5, t->enabled);
+    sqlite3_bind_text(stmt, 6, t->updated_at, -1, SQLITE_STATIC);
+}
+
+static void bind_schedule(sqlite3_stmt *stmt, const void *rows, int i)
+{
+    const device_schedule_t *s = &((const device_schedule_t *)rows)[i];
+    sqlite3_bind_text(stmt, 1, s->id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, s->schedule_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, s->cron_expr, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, s->interval_seconds);
+    sqlite3_bind_text(stmt, 5, s->payload_json, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 6, s->enabled);
+    sqlite3_bind_text(stmt, 7, s->updated_at, -1, SQLITE_STATIC);
+}
+
+static void bind_rule(sqlite3_stmt *stmt, const void *rows, int i)
+{
+    const device_rule_t *r = &((const device_rule_t *)rows)[i];
+    sqlite3_bind_text(stmt, 1, r->id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, r->metric, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, r->above);
+    sqlite3_bind_double(stmt, 4, r->on_value);
+    sqlite3_bind_double(stmt, 5, r->off_value);
+    sqlite3_bind_text(stmt, 6, r->actuator, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 7, r->duty_percent);
+    sqlite3_bind_int(stmt, 8, r->min_on_sec);
+    sqlite3_bind_int(stmt, 9, r->min_off_sec);
+    sqlite3_bind_int(stmt, 10, r->max_on_sec);
+    sqlite3_bind_int(stmt, 11, r->enabled);
+    sqlite3_bind_text(stmt, 12, r->updated_at, -1, SQLITE_STATIC);
+}
+
+/*
+ * Replace the cached thresholds with the rows just fetched
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_save_thresholds(sqlite3 *db, const device_threshold_t *rows, int count)
+{
+    if (!db || (count > 0 && !rows))
+        return -1;
+    return replace_cache(db, "threshold_cache",
+                         "INSERT INTO threshold_cache (id, metric, min_value, max_value, enabled, updated_at) "
+                         "VALUES (?, ?, ?, ?, ?, ?);",
+                         count, bind_threshold, rows);
+}
+
+/*
+ * Replace the cached schedules with the rows just fetched
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_save_schedules(sqlite3 *db, const device_schedule_t *rows, int count)
+{
+    if (!db || (count > 0 && !rows))
+        return -1;
+    return replace_cache(db, "schedule_cache",
+                         "INSERT INTO schedule_cache (id, schedule_type, cron_expr, interval_seconds, payload, enabled, updated_at) "
+                         "VALUES (?, ?, ?, ?, ?, ?, ?);",
+                         count, bind_schedule, rows);
+}
+
+/*
+ * Replace the cached automation rules with the rows just fetched
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_save_rules(sqlite3 *db, const device_rule_t *rows, int count)
+{
+    if (!db || (count > 0 && !rows))
+        return -1;
+    return replace_cache(db, "rule_cache",
+                         "INSERT INTO rule_cache (id, metric, above, on_value, off_value, actuator, duty_percent, "
+                         "min_on_sec, min_off_sec, max_on_sec, enabled, updated_at) "
+                         "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);",
+                         count, bind_rule, rows);
+}
+
+/*
+ * Helper: copy a nullable text column into a fixed buffer
+ */
+static void column_text(sqlite3_stmt *stmt, int col, char *buf, size_t len)
+{
+    const char *v = (const char *)sqlite3_column_text(stmt, col);
+    snprintf(buf, len, "%s", v ? v : "");
+}
+
+/*
+ * Load the cached thresholds
+ * Returns 0 on success, -1 on failure
+ * Caller must free *out
+ */
+int sql_load_thresholds(sqlite3 *db, device_threshold_t **out, int *count)
+{
+    if (!db || !out || !count)
+        return -1;
+
+    *out = NULL;
+    *count = 0;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, metric, min_value, max_value, enabled, updated_at FROM threshold_cache;",
+                           -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    int cap = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if (*count == cap)
         {
-            (*readings)[idx].id = sqlite3_column_int(stmt, 0);
-            (*readings)[idx].value1 = sqlite3_column_int(stmt, 1);
-            (*readings)[idx].value2 = 0;
-            (*readings)[idx].value3 = 0;
-            (*readings)[idx].value4 = 0;
-            (*readings)[idx].timestamp = sqlite3_column_int64(stmt, 2);
-            strcpy((*readings)[idx].table_name, "water_level_data");
-            idx++;
+            cap = cap ? cap * 2 : 16;
+            device_threshold_t *grown = (device_threshold_t *)realloc(*out, (size_t)cap * sizeof(device_threshold_t));
+            if (!grown)
+                break;
+            *out = grown;
         }
-        sqlite3_finalize(stmt);
+        device_threshold_t *t = &(*out)[*count];
+        column_text(stmt, 0, t->id, sizeof(t->id));
+        column_text(stmt, 1, t->metric, sizeof(t->metric));
+        t->min_value = sqlite3_column_double(stmt, 2);
+        t->max_value = sqlite3_column_double(stmt, 3);
+        t->enabled = sqlite3_column_int(stmt, 4);
+        column_text(stmt, 5, t->updated_at, sizeof(t->updated_at));
+        (*count)++;
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+/*
+ * Load the cached schedules
+ * Returns 0 on success, -1 on failure
+ * Caller must free *out
+ */
+int sql_load_schedules(sqlite3 *db, device_schedule_t **out, int *count)
+{
+    if (!db || !out || !count)
+        return -1;
+
+    *out = NULL;
+    *count = 0;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, schedule_type, cron_expr, interval_seconds, payload, enabled, updated_at "
+                               "FROM schedule_cache;",
+                           -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
     }
 
-    // Get unsynced bme680_data (value1=temp, value2=humidity, value3=pressure, value4=gas)
-    const char *bme_sql = "SELECT id, temperature, humidity, pressure, gas_resistance, timestamp FROM bme680_data WHERE synced = 0 ORDER BY timestamp LIMIT 100;";
-    if (sqlite3_prepare_v2(db, bme_sql, -1, &stmt, NULL) == SQLITE_OK)
+    int cap = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        while (sqlite3_step(stmt) == SQLITE_ROW && idx < *count)
+        if (*count == cap)
         {
-            (*readings)[idx].id = sqlite3_column_int(stmt, 0);
-            (*readings)[idx].value1 = sqlite3_column_double(stmt, 1);
-            (*readings)[idx].value2 = sqlite3_column_double(stmt, 2);
-            (*readings)[idx].value3 = sqlite3_column_double(stmt, 3);
-            (*readings)[idx].value4 = sqlite3_column_double(stmt, 4);
-            (*readings)[idx].timestamp = sqlite3_column_int64(stmt, 5);
-            strcpy((*readings)[idx].table_name, "bme680_data");
-            idx++;
+            cap = cap ? cap * 2 : 16;
+            device_schedule_t *grown = (device_schedule_t *)realloc(*out, (size_t)cap * sizeof(device_schedule_t));
+            if (!grown)
+                break;
+            *out = grown;
         }
-        sqlite3_finalize(stmt);
+        device_schedule_t *s = &(*out)[*count];
+        column_text(stmt, 0, s->id, sizeof(s->id));
+        column_text(stmt, 1, s->schedule_type, sizeof(s->schedule_type));
+        column_text(stmt, 2, s->cron_expr, sizeof(s->cron_expr));
+        s->interval_seconds = sqlite3_column_int(stmt, 3);
+        column_text(stmt, 4, s->payload_json, sizeof(s->payload_json));
+        s->enabled = sqlite3_column_int(stmt, 5);
+        column_text(stmt, 6, s->updated_at, sizeof(s->updated_at));
+        (*count)++;
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+/*
+ * Load the cached automation rules
+ * Returns 0 on success, -1 on failure
+ * Caller must free *out
+ */
+int sql_load_rules(sqlite3 *db, device_rule_t **out, int *count)
+{
+    if (!db || !out || !count)
+        return -1;
+
+    *out = NULL;
+    *count = 0;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, metric, above, on_value, off_value, actuator, duty_percent, "
+                               "min_on_sec, min_off_sec, max_on_sec, enabled, updated_at FROM rule_cache;",
+                           -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
     }
 
-    // Get unsynced water_level_photoelectric
-    const char *photo_sql = "SELECT id, frequency_hz, timestamp FROM water_level_photoelectric WHERE synced = 0 ORDER BY timestamp LIMIT 100;";
-    if (sqlite3_prepare_v2(db, photo_sql, -1, &stmt, NULL) == SQLITE_OK)
+    int cap = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        while (sqlite3_step(stmt) == SQLITE_ROW && idx < *count)
+        if (*count == cap)
         {
-            (*readings)[idx].id = sqlite3_column_int(stmt, 0);
-            (*readings)[idx].value1 = sqlite3_column_int(stmt, 1);
-            (*readings)[idx].value2 = 0;
-            (*readings)[idx].value3 = 0;
-            (*readings)[idx].value4 = 0;
-            (*readings)[idx].timestamp = sqlite3_column_int64(stmt, 2);
-            strcpy((*readings)[idx].table_name, "water_level_photoelectric");
-            idx++;
+            cap = cap ? cap * 2 : 16;
+            device_rule_t *grown = (device_rule_t *)realloc(*out, (size_t)cap * sizeof(device_rule_t));
+            if (!grown)
+                break;
+            *out = grown;
         }
-        sqlite3_finalize(stmt);
+        device_rule_t *r = &(*out)[*count];
+        column_text(stmt, 0, r->id, sizeof(r->id));
+        column_text(stmt, 1, r->metric, sizeof(r->metric));
+        r->above = sqlite3_column_int(stmt, 2);
+        r->on_value = sqlite3_column_double(stmt, 3);
+        r->off_value = sqlite3_column_double(stmt, 4);
+        column_text(stmt, 5, r->actuator, sizeof(r->actuator));
+        r->duty_percent = sqlite3_column_int(stmt, 6);
+        r->min_on_sec = sqlite3_column_int(stmt, 7);
+        r->min_off_sec = sqlite3_column_int(stmt, 8);
+        r->max_on_sec = sqlite3_column_int(stmt, 9);
+        r->enabled = sqlite3_column_int(stmt, 10);
+        column_text(stmt, 11, r->updated_at, sizeof(r->updated_at));
+        (*count)++;
     }
-
-    *count = idx; // Update count to actual number retrieved
+    sqlite3_finalize(stmt);
     return 0;
 }
 
 /*
- * Mark a reading as synced
+ * Insert or update the run state of the given schedules in one transaction
  * Returns SQLITE_OK on success, error code on failure
  */
-int sql_mark_as_synced(sqlite3 *db, const char *table_name, int id)
+int sql_save_schedule_state(sqlite3 *db, const sqlite_schedule_state_t *rows, int count)
 {
-    if (!db || !table_name)
+    if (!db || (count > 0 && !rows))
         return -1;
 
-    char sql[256];
-    snprintf(sql, sizeof(sql), "UPDATE %s SET synced = 1 WHERE id = ?;", table_name);
-
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO schedule_state (id, cron_expr, interval_seconds, last_run, next_fire, last_alert) "
+                               "VALUES (?, ?, ?, ?, ?, ?);",
+                           -1, &stmt, NULL) != SQLITE_OK)
     {
         fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
         return -1;
     }
-
-    sqlite3_bind_int(stmt, 1, id);
-    int rc = sqlite3_step(stmt);
+    int rc = sql_execute(db, "BEGIN;");
+    for (int i = 0; i < count && rc == SQLITE_OK; i++)
+    {
+        sqlite3_bind_text(stmt, 1, rows[i].id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, rows[i].cron_expr, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, rows[i].interval_seconds);
+        sqlite3_bind_int64(stmt, 4, rows[i].last_run);
+        sqlite3_bind_int64(stmt, 5, rows[i].next_fire);
+        sqlite3_bind_int64(stmt, 6, rows[i].last_alert);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            rc = sqlite3_errcode(db);
+        sqlite3_reset(stmt);
+    }
     sqlite3_finalize(stmt);
 
-    if (rc != SQLITE_DONE)
+    if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "Failed to mark as synced: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to save schedule state: %s\n", sqlite3_errmsg(db));
+        sql_execute(db, "ROLLBACK;");
         return rc;
     }
+    return sql_execute(db, "COMMIT;");
+}
 
-    return SQLITE_OK;
-}
\ No newline at end of file
+/*
+ * Load the run state of every schedule
+ * Returns 0 on success, -1 on failure
+ * Caller must free *out
+ */
+int sql_load_schedule_state(sqlite3 *db, sqlite_schedule_state_t **out, int *count)
+{
+    if (!db || !out || !count)
+        return -1;
+
+    *out = NULL;
+    *count = 0;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, cron_expr, interval_seconds, last_run, next_fire, last_alert FROM schedule_state;",
+                           -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    int cap = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if (*count == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            sqlite_schedule_state_t *grown =
+                (sqlite_schedule_state_t *)realloc(*out, (size_t)cap * sizeof(sqlite_schedule_state_t));
+            if (!grown)
+                break;
+            *out = grown;
+        }
+        sqlite_schedule_state_t *st = &(*out)[*count];
+        column_text(stmt, 0, st->id, sizeof(st->id));
+        column_text(stmt, 1, st->cron_expr, sizeof(st->cron_expr));
+        st->interval_seconds = sqlite3_column_int(stmt, 2);
+        st->last_run = sqlite3_column_int64(stmt, 3);
+        st->next_fire = sqlite3_column_int64(stmt, 4);
+        st->last_alert = sqlite3_column_int64(stmt, 5);
+        (*count)++;
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+/*
+ * Drop run state of schedules that are no longer cached
+ * Returns SQLITE_OK on success, error code on failure
+ */
+int sql_prune_schedule_state(sqlite3 *db)
+{
+    if (!db)
+        return -1;
+    return sql_execute(db, "DELETE FROM schedule_state WHERE id NOT IN (SELECT id FROM schedule_cache);");
+}
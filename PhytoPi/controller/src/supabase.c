@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <json-c/json.h>
 
@@ -26,6 +27,34 @@ static size_t write_memory_callback(void *contents, size_t size, size_t nmemb, v
     return realsize;
 }
 
+static size_t discard_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    return size * nmemb;
+}
+
+/*
+ * Helper: perform the request configured on the shared handle. The response
+ * body goes to *body (NULL = discarded). Body, header and method options are
+ * reset afterwards so the next request never writes through a stale pointer.
+ * Returns the curl result and stores the HTTP status in *response_code.
+ */
+static CURLcode perform_request(struct memory_buffer *body, long *response_code)
+{
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, body ? write_memory_callback : discard_callback);
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)body);
+
+    CURLcode res = curl_easy_perform(curl_handle);
+    *response_code = 0;
+    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, response_code);
+
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, discard_callback);
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, NULL);
+    curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, NULL);
+    curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, NULL);
+    curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, NULL);
+    return res;
+}
+
 /*
  * Initialize Supabase HTTP client
  * Returns 0 on success, -1 on failure
@@ -142,10 +171,8 @@ int supabase_send_batch(supabase_config_t *config, supabase_reading_t *readings,
     curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
 
     // Perform request
-    CURLcode res = curl_easy_perform(curl_handle);
-    
     long response_code;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    CURLcode res = perform_request(NULL, &response_code);
 
     // Cleanup
     curl_slist_free_all(headers);
@@ -210,9 +237,8 @@ int supabase_insert_alert(supabase_config_t *config, const char *device_id,
     curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
 
-    CURLcode res = curl_easy_perform(curl_handle);
     long response_code = 0;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    CURLcode res = perform_request(NULL, &response_code);
     curl_slist_free_all(headers);
     json_object_put(alert);
 
@@ -221,6 +247,80 @@ int supabase_insert_alert(supabase_config_t *config, const char *device_id,
     return 0;
 }
 
+/*
+ * Insert a batch of alerts in one request (JSON array body).
+ * Every object carries the same keys, as PostgREST bulk inserts require.
+ */
+int supabase_insert_alerts(supabase_config_t *config, const char *device_id,
+                           const supabase_alert_t *alerts, int count)
+{
+    if (!config || !config->api_url || !config->api_key || !device_id || !alerts || count <= 0)
+        return -1;
+    if (!curl_handle)
+        return -1;
+
+    json_object *arr = json_object_new_array();
+    for (int i = 0; i < count; i++)
+    {
+        time_t ts = (time_t)alerts[i].timestamp;
+        struct tm tm_buf;
+        gmtime_r(&ts, &tm_buf);
+        char iso_buf[32];
+        strftime(iso_buf, sizeof(iso_buf), "%Y-%m-%dT%H:%M:%SZ", &tm_buf);
+
+        json_object *alert = json_object_new_object();
+        json_object_object_add(alert, "device_id", json_object_new_string(device_id));
+        json_object_object_add(alert, "type", json_object_new_string(alerts[i].type));
+        json_object_object_add(alert, "message", json_object_new_string(alerts[i].message));
+        json_object_object_add(alert, "severity",
+                               json_object_new_string(alerts[i].severity ? alerts[i].severity : "medium"));
+        json_object_object_add(alert, "source", (alerts[i].source && alerts[i].source[0])
+                                                    ? json_object_new_string(alerts[i].source)
+                                                    : NULL);
+        json_object_object_add(alert, "triggered_at", json_object_new_string(iso_buf));
+        json_object_array_add(arr, alert);
+    }
+
+    const char *json_string = json_object_to_json_string(arr);
+
+    char url[512];
+    snprintf(url, sizeof(url), "%s/rest/v1/alerts", config->api_url);
+
+    struct curl_slist *headers = NULL;
+    char apikey_header[256];
+    char auth_header[256];
+    snprintf(apikey_header, sizeof(apikey_header), "apikey: %s", config->api_key);
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", config->api_key);
+    headers = curl_slist_append(headers, apikey_header);
+    headers = curl_slist_append(headers, auth_header);
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Prefer: return=minimal");
+
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, json_string);
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+
+    struct memory_buffer chunk = {0};
+    long response_code = 0;
+    CURLcode res = perform_request(&chunk, &response_code);
+    curl_slist_free_all(headers);
+    json_object_put(arr);
+
+    int ret = -1;
+    if (res == CURLE_OK && response_code >= 200 && response_code < 300)
+        ret = 0;
+    else if (res == CURLE_OK && response_code >= 400 && response_code < 500 &&
+             response_code != 408 && response_code != 429)
+    {
+        fprintf(stderr, "  [Alerts] Batch of %d rejected (http=%ld): %.200s\n", count, response_code,
+                chunk.data ? chunk.data : "");
+        ret = -2;
+    }
+    free(chunk.data);
+    return ret;
+}
+
 /*
  * Fetch device thresholds for the configured device.
  * Returns count of thresholds, -1 on error. Caller must free *out.
@@ -249,13 +349,10 @@ int supabase_fetch_thresholds(supabase_config_t *config, device_threshold_t **ou
     struct memory_buffer chunk = {0};
     curl_easy_setopt(curl_handle, CURLOPT_URL, url);
     curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_memory_callback);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
     curl_easy_setopt(curl_handle, CURLOPT_HTTPGET, 1L);
 
-    CURLcode res = curl_easy_perform(curl_handle);
     long response_code = 0;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    CURLcode res = perform_request(&chunk, &response_code);
     curl_slist_free_all(headers);
 
     if (res != CURLE_OK || response_code < 200 || response_code >= 300)
@@ -291,7 +388,7 @@ int supabase_fetch_thresholds(supabase_config_t *config, device_threshold_t **ou
     for (int i = 0; i < n; i++)
     {
         json_object *obj = json_object_array_get_idx(root, i);
-        json_object *id_o = NULL, *metric_o = NULL, *min_o = NULL, *max_o = NULL, *en_o = NULL;
+        json_object *id_o = NULL, *metric_o = NULL, *min_o = NULL, *max_o = NULL, *en_o = NULL, *upd_o = NULL;
         if (json_object_object_get_ex(obj, "id", &id_o))
             snprintf(arr[i].id, sizeof(arr[i].id), "%s", json_object_get_string(id_o));
         if (json_object_object_get_ex(obj, "metric", &metric_o))
@@ -310,6 +407,8 @@ int supabase_fetch_thresholds(supabase_config_t *config, device_threshold_t **ou
             arr[i].enabled = json_object_get_boolean(en_o) ? 1 : 0;
         else
             arr[i].enabled = 1;
+        if (json_object_object_get_ex(obj, "updated_at", &upd_o) && json_object_get_string(upd_o))
+            snprintf(arr[i].updated_at, sizeof(arr[i].updated_at), "%s", json_object_get_string(upd_o));
     }
 
     json_object_put(root);
@@ -346,13 +445,10 @@ int supabase_fetch_schedules(supabase_config_t *config, device_schedule_t **out,
     struct memory_buffer chunk = {0};
     curl_easy_setopt(curl_handle, CURLOPT_URL, url);
     curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_memory_callback);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
     curl_easy_setopt(curl_handle, CURLOPT_HTTPGET, 1L);
 
-    CURLcode res = curl_easy_perform(curl_handle);
     long response_code = 0;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    CURLcode res = perform_request(&chunk, &response_code);
     curl_slist_free_all(headers);
 
     if (res != CURLE_OK || response_code < 200 || response_code >= 300)
@@ -388,7 +484,7 @@ int supabase_fetch_schedules(supabase_config_t *config, device_schedule_t **out,
     for (int i = 0; i < n; i++)
     {
         json_object *obj = json_object_array_get_idx(root, i);
-        json_object *id_o = NULL, *type_o = NULL, *cron_o = NULL, *interval_o = NULL, *payload_o = NULL, *en_o = NULL;
+        json_object *id_o = NULL, *type_o = NULL, *cron_o = NULL, *interval_o = NULL, *payload_o = NULL, *en_o = NULL, *upd_o = NULL;
         if (json_object_object_get_ex(obj, "id", &id_o))
             snprintf(arr[i].id, sizeof(arr[i].id), "%s", json_object_get_string(id_o));
         if (json_object_object_get_ex(obj, "schedule_type", &type_o))
@@ -403,6 +499,112 @@ int supabase_fetch_schedules(supabase_config_t *config, device_schedule_t **out,
             arr[i].enabled = json_object_get_boolean(en_o) ? 1 : 0;
         else
             arr[i].enabled = 1;
+        if (json_object_object_get_ex(obj, "updated_at", &upd_o) && json_object_get_string(upd_o))
+            snprintf(arr[i].updated_at, sizeof(arr[i].updated_at), "%s", json_object_get_string(upd_o));
+    }
+
+    json_object_put(root);
+    *out = arr;
+    *count = n;
+    return n;
+}
+
+/*
+ * Fetch enabled automation rules for the configured device.
+ * Returns count, -1 on error. Caller must free *out.
+ */
+int supabase_fetch_rules(supabase_config_t *config, device_rule_t **out, int *count)
+{
+    if (!config || !config->api_url || !config->api_key || !config->device_id || !out || !count)
+        return -1;
+    if (!curl_handle)
+        return -1;
+
+    char url[512];
+    snprintf(url, sizeof(url),
+             "%s/rest/v1/automation_rules?device_id=eq.%s&enabled=eq.true",
+             config->api_url, config->device_id);
+
+    struct curl_slist *headers = NULL;
+    char apikey_header[256];
+    char auth_header[256];
+    snprintf(apikey_header, sizeof(apikey_header), "apikey: %s", config->api_key);
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", config->api_key);
+    headers = curl_slist_append(headers, apikey_header);
+    headers = curl_slist_append(headers, auth_header);
+    headers = curl_slist_append(headers, "Accept: application/json");
+
+    struct memory_buffer chunk = {0};
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPGET, 1L);
+
+    long response_code = 0;
+    CURLcode res = perform_request(&chunk, &response_code);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK || response_code < 200 || response_code >= 300)
+    {
+        if (chunk.data) free(chunk.data);
+        return -1;
+    }
+
+    if (!chunk.data || chunk.size == 0)
+    {
+        free(chunk.data);
+        *out = NULL;
+        *count = 0;
+        return 0;
+    }
+
+    json_object *root = json_tokener_parse(chunk.data);
+    free(chunk.data);
+    if (!root || !json_object_is_type(root, json_type_array))
+    {
+        if (root) json_object_put(root);
+        return -1;
+    }
+
+    int n = json_object_array_length(root);
+    device_rule_t *arr = (device_rule_t *)calloc(n > 0 ? n : 1, sizeof(device_rule_t));
+    if (!arr)
+    {
+        json_object_put(root);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        json_object *obj = json_object_array_get_idx(root, i);
+        json_object *o = NULL;
+        device_rule_t *r = &arr[i];
+        if (json_object_object_get_ex(obj, "id", &o))
+            snprintf(r->id, sizeof(r->id), "%s", json_object_get_string(o));
+        if (json_object_object_get_ex(obj, "metric", &o))
+            snprintf(r->metric, sizeof(r->metric), "%s", json_object_get_string(o));
+        r->above = !(json_object_object_get_ex(obj, "comparison", &o) &&
+                     json_object_get_string(o) && strcmp(json_object_get_string(o), "below") == 0);
+        if (json_object_object_get_ex(obj, "on_value", &o))
+            r->on_value = json_object_get_double(o);
+        if (json_object_object_get_ex(obj, "off_value", &o) && json_object_get_type(o) != json_type_null)
+            r->off_value = json_object_get_double(o);
+        else
+            r->off_value = r->on_value;
+        if (json_object_object_get_ex(obj, "actuator", &o))
+            snprintf(r->actuator, sizeof(r->actuator), "%s", json_object_get_string(o));
+        r->duty_percent = json_object_object_get_ex(obj, "duty_percent", &o) ? json_object_get_int(o) : 100;
+        if (json_object_object_get_ex(obj, "min_on_seconds", &o))
+            r->min_on_sec = json_object_get_int(o);
+        if (json_object_object_get_ex(obj, "min_off_seconds", &o))
+            r->min_off_sec = json_object_get_int(o);
+        if (json_object_object_get_ex(obj, "max_on_seconds", &o))
+            r->max_on_sec = json_object_get_int(o);
+        if (json_object_object_get_ex(obj, "enabled", &o))
+            r->enabled = json_object_get_boolean(o) ? 1 : 0;
+        else
+            r->enabled = 1;
+        if (json_object_object_get_ex(obj, "updated_at", &o) && json_object_get_string(o))
+            snprintf(r->updated_at, sizeof(r->updated_at), "%s", json_object_get_string(o));
     }
 
     json_object_put(root);
@@ -450,19 +652,93 @@ int supabase_heartbeat(supabase_config_t *config)
     curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, "PATCH");
 
-    CURLcode res = curl_easy_perform(curl_handle);
     long response_code = 0;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    CURLcode res = perform_request(NULL, &response_code);
     curl_slist_free_all(headers);
     json_object_put(body);
 
-    curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, NULL);
-
     if (res != CURLE_OK || response_code < 200 || response_code >= 300)
         return -1;
     return 0;
 }
 
+/*
+ * Helper: pick the row total out of a "Content-Range: 0-0/5" header
+ */
+static size_t content_range_callback(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    size_t len = size * nitems;
+    long *total = (long *)userp;
+    if (len > 14 && strncasecmp(buffer, "Content-Range:", 14) == 0)
+    {
+        const char *slash = memchr(buffer, '/', len);
+        if (slash && slash[1] != '*')
+            *total = strtol(slash + 1, NULL, 10);
+    }
+    return len;
+}
+
+/*
+ * Fetch the newest updated_at and the row count of a device config table.
+ * The count comes back in Content-Range, so the body is at most one row.
+ * Returns 0 on success, -1 on error.
+ */
+int supabase_fetch_version(supabase_config_t *config, const char *table, supabase_version_t *out)
+{
+    if (!config || !config->api_url || !config->api_key || !config->device_id || !table || !out)
+        return -1;
+    if (!curl_handle)
+        return -1;
+
+    char url[512];
+    snprintf(url, sizeof(url),
+             "%s/rest/v1/%s?device_id=eq.%s&select=updated_at&order=updated_at.desc.nullslast&limit=1",
+             config->api_url, table, config->device_id);
+
+    struct curl_slist *headers = NULL;
+    char apikey_header[256];
+    char auth_header[256];
+    snprintf(apikey_header, sizeof(apikey_header), "apikey: %s", config->api_key);
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", config->api_key);
+    headers = curl_slist_append(headers, apikey_header);
+    headers = curl_slist_append(headers, auth_header);
+    headers = curl_slist_append(headers, "Accept: application/json");
+    headers = curl_slist_append(headers, "Prefer: count=exact");
+
+    long total = -1;
+    struct memory_buffer chunk = {0};
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, content_range_callback);
+    curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, (void *)&total);
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPGET, 1L);
+
+    long response_code = 0;
+    CURLcode res = perform_request(&chunk, &response_code);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK || response_code < 200 || response_code >= 300 || total < 0)
+    {
+        free(chunk.data);
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->count = total;
+    json_object *root = chunk.data ? json_tokener_parse(chunk.data) : NULL;
+    free(chunk.data);
+    if (root && json_object_is_type(root, json_type_array) && json_object_array_length(root) > 0)
+    {
+        json_object *upd_o = NULL;
+        if (json_object_object_get_ex(json_object_array_get_idx(root, 0), "updated_at", &upd_o) &&
+            json_object_get_string(upd_o))
+            snprintf(out->updated_at, sizeof(out->updated_at), "%s", json_object_get_string(upd_o));
+    }
+    if (root)
+        json_object_put(root);
+    return 0;
+}
+
 /*
  * Update schedule last_run_at. Returns 0 on success.
  */
@@ -501,14 +777,11 @@ int supabase_update_schedule_last_run(supabase_config_t *config, const char *sch
     curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, "PATCH");
 
-    CURLcode res = curl_easy_perform(curl_handle);
     long response_code = 0;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    CURLcode res = perform_request(NULL, &response_code);
     curl_slist_free_all(headers);
     json_object_put(body);
 
-    curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, NULL);
-
     if (res != CURLE_OK || response_code < 200 || response_code >= 300)
         return -1;
     return 0;
@@ -568,9 +841,8 @@ int supabase_update_actuator_state(supabase_config_t *config,
     curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
 
-    CURLcode res_act = curl_easy_perform(curl_handle);
     long rc_act = 0;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &rc_act);
+    CURLcode res_act = perform_request(NULL, &rc_act);
     curl_slist_free_all(headers);
     json_object_put(body);
 
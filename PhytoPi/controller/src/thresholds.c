@@ -0,0 +1,176 @@
+/**
+ * Compiled device thresholds for PhytoPi
+ */
+#include "../lib/thresholds.h"
+#include "../lib/sensors.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static threshold_rule_t *rules = NULL;
+static int n_rules = 0;
+
+/* Dense group index per registry metric, -1 = no rule reads it */
+static int metric_group[SENSOR_MAX_METRICS];
+static int n_groups = 0;
+
+/* Per-group extremes of the valid readings, rebuilt each evaluation */
+static double group_lo[SENSOR_MAX_METRICS];
+static double group_hi[SENSOR_MAX_METRICS];
+
+static int is_climate_metric(const char *metric)
+{
+    return strcmp(metric, "temp_c") == 0 || strcmp(metric, "humidity") == 0 ||
+           strcmp(metric, "gas_resistance") == 0;
+}
+
+int thresholds_compile(const device_threshold_t *rows, int count)
+{
+    threshold_rule_t *out = (threshold_rule_t *)calloc(count > 0 ? count : 1, sizeof(threshold_rule_t));
+    if (!out)
+        return -1;
+
+    /* Registry group head -> dense group index, assigned as rules need them */
+    int head_group[SENSOR_MAX_METRICS];
+    for (int i = 0; i < SENSOR_MAX_METRICS; i++)
+        head_group[i] = -1;
+    int groups = 0;
+
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const device_threshold_t *row = &rows[i];
+        if (!row->enabled)
+            continue;
+        int head = sensors_group_find(row->metric);
+        if (head < 0)
+            continue; /* no sensor on this device reports the metric */
+        if (head_group[head] < 0)
+            head_group[head] = groups++;
+
+        threshold_rule_t *r = &out[n++];
+        r->group = head_group[head];
+        snprintf(r->id, sizeof(r->id), "%s", row->id);
+        snprintf(r->metric, sizeof(r->metric), "%s", row->metric);
+        r->water_low = (strcmp(row->metric, "water_level_low") == 0);
+        if (r->water_low)
+        {
+            /* The row carries the cutoff frequency in either column; below it is low */
+            r->min = row->max_value < 1e8    ? row->max_value
+                     : row->min_value > -1e8 ? row->min_value
+                                             : WATER_LEVEL_LOW_HZ_DEFAULT;
+            r->max = INFINITY;
+            r->cooldown_sec = WATER_ALERT_COOLDOWN;
+            r->severity = "high";
+            snprintf(r->alert_type, sizeof(r->alert_type), "water_level_low");
+        }
+        else
+        {
+            r->min = row->min_value > -1e8 ? row->min_value : -INFINITY;
+            r->max = row->max_value < 1e8 ? row->max_value : INFINITY;
+            r->cooldown_sec = THRESHOLD_ALERT_COOLDOWN;
+            r->severity = "medium";
+            snprintf(r->alert_type, sizeof(r->alert_type), "threshold_%s", row->metric);
+        }
+        r->action = is_climate_metric(row->metric) ? THR_ACT_VENTILATE : 0;
+
+        /* A refresh must not re-arm alerts that are still cooling down */
+        for (int o = 0; o < n_rules; o++)
+        {
+            if (strcmp(rules[o].id, r->id) == 0)
+            {
+                r->last_alert = rules[o].last_alert;
+                break;
+            }
+        }
+    }
+
+    /* Every metric of a group maps to the group's dense index */
+    for (int m = 0; m < SENSOR_MAX_METRICS; m++)
+        metric_group[m] = -1;
+    for (int h = 0; h < SENSOR_MAX_METRICS; h++)
+    {
+        if (head_group[h] < 0)
+            continue;
+        for (int m = h; m >= 0; m = sensors_metric(m)->next_in_group)
+            metric_group[m] = head_group[h];
+    }
+
+    free(rules);
+    rules = out;
+    n_rules = n;
+    n_groups = groups;
+    return n;
+}
+
+int thresholds_count(void)
+{
+    return n_rules;
+}
+
+const threshold_rule_t *thresholds_rule(int idx)
+{
+    if (idx < 0 || idx >= n_rules)
+        return NULL;
+    return &rules[idx];
+}
+
+int thresholds_evaluate(time_t now, unsigned *actions, threshold_hit_t *hits, int max_hits)
+{
+    *actions = 0;
+    if (n_rules == 0)
+        return 0;
+
+    /* Collapse each group to its extremes; any probe out of range counts */
+    for (int g = 0; g < n_groups; g++)
+    {
+        group_lo[g] = INFINITY;
+        group_hi[g] = -INFINITY;
+    }
+    int n_metrics = sensors_metric_count();
+    for (int m = 0; m < n_metrics; m++)
+    {
+        int g = metric_group[m];
+        const sensor_metric_t *sm = sensors_metric(m);
+        if (g < 0 || !sm->valid)
+            continue;
+        group_lo[g] = fmin(group_lo[g], sm->value);
+        group_hi[g] = fmax(group_hi[g], sm->value);
+    }
+
+    /* Groups without a valid reading stay at +inf/-inf and never compare true */
+    int n = 0;
+    for (int i = 0; i < n_rules; i++)
+    {
+        const threshold_rule_t *r = &rules[i];
+        double lo = group_lo[r->group];
+        double hi = group_hi[r->group];
+        int below = lo < r->min;
+        int above = hi > r->max;
+        if (!(below | above))
+            continue;
+        *actions |= r->action;
+        if (n < max_hits && now - r->last_alert >= r->cooldown_sec)
+        {
+            hits[n].rule = i;
+            hits[n].value = below ? lo : hi;
+            n++;
+        }
+    }
+    return n;
+}
+
+void thresholds_alerted(int idx, time_t now)
+{
+    if (idx >= 0 && idx < n_rules)
+        rules[idx].last_alert = now;
+}
+
+void thresholds_cleanup(void)
+{
+    free(rules);
+    rules = NULL;
+    n_rules = 0;
+    n_groups = 0;
+}
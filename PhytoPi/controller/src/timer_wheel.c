@@ -0,0 +1,208 @@
+/**
+ * Hierarchical timer wheel for PhytoPi
+ * Level l holds timers due 64^l to 64^(l+1) seconds ahead in slots indexed by
+ * bits 6l..6l+5 of their expiry; when the seconds count reaches a slot's
+ * window the slot cascades one level down, until level 0 expires it.
+ */
+#include "../lib/timer_wheel.h"
+#include <stddef.h>
+#include <string.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SPAN(l) ((time_t)1 << (TIMER_WHEEL_BITS * (l))) /* seconds covered below level l */
+
+static wheel_timer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static time_t processed = 0; /* every second up to here has been expired */
+static int n_pending = 0;
+
+static void link_timer(wheel_timer_t **head, wheel_timer_t *t)
+{
+    t->next = *head;
+    if (t->next)
+        t->next->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+}
+
+static void unlink_timer(wheel_timer_t *t)
+{
+    *t->pprev = t->next;
+    if (t->next)
+        t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/*
+ * Helper: put t in the slot for its distance from the next second to expire
+ */
+static void place(wheel_timer_t *t)
+{
+    time_t at = t->expires > processed ? t->expires : processed + 1;
+    time_t d = at - (processed + 1);
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && d >= LEVEL_SPAN(level + 1))
+        level++;
+    if (d >= LEVEL_SPAN(TIMER_WHEEL_LEVELS))
+        at = processed + LEVEL_SPAN(TIMER_WHEEL_LEVELS); /* park; re-placed when the slot cascades */
+    link_timer(&slots[level][(at >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK], t);
+}
+
+/*
+ * Helper: re-place every pending timer relative to a new base (clock jump)
+ */
+static void rebase(time_t base)
+{
+    wheel_timer_t *all = NULL;
+    for (int l = 0; l < TIMER_WHEEL_LEVELS; l++)
+    {
+        for (int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+        {
+            wheel_timer_t *t;
+            while ((t = slots[l][i]) != NULL)
+            {
+                unlink_timer(t);
+                t->next = all;
+                all = t;
+            }
+        }
+    }
+    processed = base;
+    while (all)
+    {
+        wheel_timer_t *t = all;
+        all = t->next;
+        t->next = NULL;
+        place(t);
+    }
+}
+
+/*
+ * Helper: expire the next second. Returns the number of timers expired.
+ */
+static int step(void)
+{
+    time_t s = processed + 1;
+
+    /* Cascade any slot whose window starts now, so its timers due this
+     * second reach level 0 before it expires */
+    for (int l = TIMER_WHEEL_LEVELS - 1; l > 0; l--)
+    {
+        if (s & (LEVEL_SPAN(l) - 1))
+            continue;
+        wheel_timer_t **head = &slots[l][(s >> (TIMER_WHEEL_BITS * l)) & SLOT_MASK];
+        wheel_timer_t *list = *head;
+        *head = NULL;
+        while (list)
+        {
+            wheel_timer_t *t = list;
+            list = t->next;
+            t->next = NULL;
+            place(t);
+        }
+    }
+
+    /* Detach the slot so callbacks re-adding 64 s ahead do not land in it;
+     * the local head keeps cancels from callbacks valid */
+    processed = s;
+    wheel_timer_t *expired = slots[0][s & SLOT_MASK];
+    slots[0][s & SLOT_MASK] = NULL;
+    if (expired)
+        expired->pprev = &expired;
+    int n = 0;
+    while (expired)
+    {
+        wheel_timer_t *t = expired;
+        unlink_timer(t);
+        n_pending--;
+        n++;
+        if (t->fn)
+            t->fn(t);
+    }
+    return n;
+}
+
+void timer_wheel_init(time_t now)
+{
+    memset(slots, 0, sizeof(slots));
+    processed = now - 1;
+    n_pending = 0;
+}
+
+void timer_wheel_add(wheel_timer_t *t, time_t expires)
+{
+    timer_wheel_cancel(t);
+    t->expires = expires;
+    place(t);
+    n_pending++;
+}
+
+void timer_wheel_cancel(wheel_timer_t *t)
+{
+    if (!t->pprev)
+        return;
+    unlink_timer(t);
+    n_pending--;
+}
+
+int timer_wheel_pending(const wheel_timer_t *t)
+{
+    return t->pprev != NULL;
+}
+
+int timer_wheel_advance(time_t now)
+{
+    if (now <= processed)
+        return 0;
+    if (n_pending == 0)
+    {
+        processed = now;
+        return 0;
+    }
+    /* Stepping second by second is cheap up to a level-1 span; beyond that
+     * (clock set at boot, long suspend) re-place everything once instead */
+    if (now - processed > LEVEL_SPAN(2))
+        rebase(now - 1);
+    int n = 0;
+    while (processed < now)
+        n += step();
+    return n;
+}
+
+/*
+ * Helper: earliest expiry in one slot's list
+ */
+static time_t list_min(const wheel_timer_t *t)
+{
+    time_t m = t->expires;
+    for (t = t->next; t; t = t->next)
+        if (t->expires < m)
+            m = t->expires;
+    return m;
+}
+
+time_t timer_wheel_next_expiry(void)
+{
+    if (n_pending == 0)
+        return 0;
+    /* Within a level the first occupied slot after the current one holds the
+     * level's earliest timers. Levels can overlap (a level-1 slot is not
+     * cascaded until its window starts), so take the minimum over all. */
+    time_t best = 0;
+    for (int l = 0; l < TIMER_WHEEL_LEVELS; l++)
+    {
+        int cur = (int)((processed >> (TIMER_WHEEL_BITS * l)) & SLOT_MASK);
+        for (int i = 1; i <= TIMER_WHEEL_SLOTS; i++)
+        {
+            const wheel_timer_t *head = slots[l][(cur + i) & SLOT_MASK];
+            if (head)
+            {
+                time_t m = list_min(head);
+                if (best == 0 || m < best)
+                    best = m;
+                break;
+            }
+        }
+    }
+    return best;
+}
@@ -0,0 +1,114 @@
+/**
+ * Standalone checks for cron_next (make test)
+ * Next-fire times are compared against hand-worked UTC instants in zones with
+ * a DST change, so the spring gap, the repeated autumn hour and the
+ * day-of-month/weekday OR rule are all pinned down.
+ */
+#include "../lib/cron.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int failures = 0;
+
+/* "YYYY-MM-DD HH:MM" in UTC */
+static time_t utc(const char *s)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(s, "%d-%d-%d %d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min) != 5)
+    {
+        fprintf(stderr, "bad time literal '%s'\n", s);
+        exit(2);
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return timegm(&tm);
+}
+
+static void set_zone(const char *tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+/*
+ * Helper: check the next fire time of expr after 'after' (both UTC literals;
+ * expect NULL for "never")
+ */
+static void check_next(const char *tz, const char *expr, const char *after, const char *expect)
+{
+    cron_expr_t c;
+    set_zone(tz);
+    if (cron_parse(expr, &c) != 0)
+    {
+        printf("FAIL %s '%s': does not parse\n", tz, expr);
+        failures++;
+        return;
+    }
+    time_t got = cron_next(&c, utc(after));
+    time_t want = expect ? utc(expect) : -1;
+    if (got != want)
+    {
+        char g[32] = "never", w[32] = "never";
+        struct tm tm;
+        if (got != -1 && gmtime_r(&got, &tm))
+            strftime(g, sizeof(g), "%Y-%m-%d %H:%M", &tm);
+        if (want != -1 && gmtime_r(&want, &tm))
+            strftime(w, sizeof(w), "%Y-%m-%d %H:%M", &tm);
+        printf("FAIL %s '%s' after %s UTC: got %s, want %s\n", tz, expr, after, g, w);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    /* New York: clocks go 02:00 EST -> 03:00 EDT on 2026-03-08 and
+     * 02:00 EDT -> 01:00 EST on 2026-11-01 */
+    const char *ny = "America/New_York";
+
+    /* Ordinary days on either side of the change (EST = UTC-5, EDT = UTC-4) */
+    check_next(ny, "30 6 * * *", "2026-03-06 12:00", "2026-03-07 11:30");
+    check_next(ny, "30 6 * * *", "2026-03-07 11:30", "2026-03-08 10:30");
+
+    /* 02:30 does not exist on the spring day: fires when the clock resumes */
+    check_next(ny, "30 2 * * *", "2026-03-08 05:00", "2026-03-08 07:30");
+    check_next(ny, "30 2 * * *", "2026-03-08 07:30", "2026-03-09 06:30");
+    check_next(ny, "*/15 * * * *", "2026-03-08 06:50", "2026-03-08 07:00");
+
+    /* 01:30 happens twice on the autumn day and fires once, in EDT */
+    check_next(ny, "30 1 * * *", "2026-11-01 04:00", "2026-11-01 05:30");
+    check_next(ny, "30 1 * * *", "2026-11-01 05:30", "2026-11-02 06:30");
+    check_next(ny, "30 1 * * *", "2026-11-01 06:00", "2026-11-02 06:30");
+    check_next(ny, "0 * * * *", "2026-11-01 05:00", "2026-11-01 07:00");
+
+    /* Both day fields restricted: the 13th OR a Friday */
+    check_next(ny, "0 12 13 * FRI", "2026-03-01 00:00", "2026-03-06 17:00");
+    check_next(ny, "0 12 13 * FRI", "2026-03-06 17:00", "2026-03-13 16:00");
+    check_next(ny, "0 12 13 * 1", "2026-03-10 00:00", "2026-03-13 16:00");
+    check_next(ny, "0 12 13 * 1", "2026-03-13 16:00", "2026-03-16 16:00");
+    /* Only one restricted: that one alone decides */
+    check_next(ny, "0 12 13 * *", "2026-03-01 00:00", "2026-03-13 16:00");
+    check_next(ny, "0 12 * * FRI", "2026-03-07 00:00", "2026-03-13 16:00");
+    check_next(ny, "0 12 13 * FRI", "2026-10-31 00:00", "2026-11-06 17:00");
+
+    /* Berlin: 02:00 CET -> 03:00 CEST on 2026-03-29, back on 2026-10-25 */
+    const char *berlin = "Europe/Berlin";
+    check_next(berlin, "30 2 * * *", "2026-03-28 12:00", "2026-03-29 01:30");
+    check_next(berlin, "30 2 * * *", "2026-03-29 01:30", "2026-03-30 00:30");
+    check_next(berlin, "30 2 * * *", "2026-10-24 12:00", "2026-10-25 00:30");
+    check_next(berlin, "30 2 * * *", "2026-10-25 00:30", "2026-10-26 01:30");
+    check_next(berlin, "@weekly", "2026-03-26 00:00", "2026-03-28 23:00");
+
+    /* Never matches */
+    check_next("UTC", "0 0 31 2 *", "2026-01-01 00:00", NULL);
+
+    if (failures)
+    {
+        printf("test_cron: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("test_cron: ok\n");
+    return 0;
+}
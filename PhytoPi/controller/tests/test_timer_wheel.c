@@ -0,0 +1,222 @@
+/**
+ * Standalone checks for the timer wheel (make test)
+ * Random adds, re-adds, cancels and periodic timers are run against a plain
+ * array of due times: after every advance the timers that expired, their
+ * order and timer_wheel_next_expiry() must match a brute-force scan.
+ * Delays reach past the top level (parked timers), advances of up to a
+ * level-1 span step through every cascade, and larger jumps take the rebase
+ * path.
+ */
+#include "../lib/timer_wheel.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define N_TIMERS 256
+#define TOP_SPAN ((time_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) /* parked beyond this */
+#define STEP_LIMIT ((time_t)1 << (TIMER_WHEEL_BITS * 2))                 /* larger advances rebase */
+
+typedef struct {
+    wheel_timer_t t;
+    time_t due;  /* the model: expiry as armed */
+    int armed;
+    int period;  /* re-added from its callback when > 0 */
+} test_timer_t;
+
+static test_timer_t timers[N_TIMERS];
+static time_t now = 0;      /* time of the advance in progress */
+static time_t prev_now = 0; /* every timer due up to here has expired */
+static time_t last_due = 0; /* due time of the previous expiry in this advance */
+static int jumping = 0;     /* this advance may rebase: overdue timers expire together */
+static int fired = 0;
+static int failures = 0;
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+#define CHECK(cond, ...)                    \
+    do                                      \
+    {                                       \
+        if (!(cond))                        \
+        {                                   \
+            if (failures++ < 20)            \
+            {                               \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");               \
+            }                               \
+        }                                   \
+    } while (0)
+
+static uint64_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static time_t random_below(time_t n)
+{
+    return (time_t)(next_random() % (uint64_t)n);
+}
+
+/* Delays spread over every level, plus some past the top one */
+static time_t random_delay(void)
+{
+    switch (random_below(6))
+    {
+    case 0:
+        return 1 + random_below(TIMER_WHEEL_SLOTS);
+    case 1:
+        return 1 + random_below(STEP_LIMIT);
+    case 2:
+        return 1 + random_below((time_t)1 << 18);
+    case 3:
+        return 1 + random_below(TOP_SPAN);
+    case 4:
+        return TOP_SPAN + random_below(TOP_SPAN);
+    default:
+        return 1 + random_below(600);
+    }
+}
+
+static void on_expire(wheel_timer_t *wt)
+{
+    test_timer_t *t = (test_timer_t *)wt->arg;
+    int id = (int)(t - timers);
+    CHECK(t->armed, "timer %d expired while not armed", id);
+    CHECK(t->due > prev_now && t->due <= now, "timer %d due %ld expired in advance (%ld, %ld]", id,
+          (long)t->due, (long)prev_now, (long)now);
+    if (!jumping)
+        CHECK(t->due >= last_due, "timer %d due %ld expired after one due %ld", id, (long)t->due,
+              (long)last_due);
+    last_due = t->due;
+    t->armed = 0;
+    fired++;
+
+    if (t->period > 0)
+    {
+        /* A rebase expires overdue timers at 'now', so restart from there */
+        t->due = (jumping ? now : t->due) + t->period;
+        t->armed = 1;
+        timer_wheel_add(&t->t, t->due);
+    }
+}
+
+/*
+ * Helper: compare the wheel against the model after an advance
+ */
+static void check_state(void)
+{
+    time_t min = 0;
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        test_timer_t *t = &timers[i];
+        CHECK(timer_wheel_pending(&t->t) == t->armed, "timer %d pending %d, model says %d", i,
+              timer_wheel_pending(&t->t), t->armed);
+        if (!t->armed)
+            continue;
+        CHECK(t->due > now, "timer %d due %ld missed by the advance to %ld", i, (long)t->due, (long)now);
+        if (min == 0 || t->due < min)
+            min = t->due;
+    }
+    time_t next = timer_wheel_next_expiry();
+    CHECK(next == min, "next expiry %ld, brute-force minimum %ld (now %ld)", (long)next, (long)min, (long)now);
+}
+
+/*
+ * Helper: random adds, re-adds and cancels at the current time
+ */
+static void shuffle_timers(int ops)
+{
+    for (int k = 0; k < ops; k++)
+    {
+        test_timer_t *t = &timers[random_below(N_TIMERS)];
+        if (t->armed && random_below(4) == 0)
+        {
+            timer_wheel_cancel(&t->t);
+            t->armed = 0;
+            continue;
+        }
+        t->period = random_below(8) == 0 ? (int)(1 + random_below(3 * TIMER_WHEEL_SLOTS)) : 0;
+        t->due = now + random_delay();
+        t->armed = 1;
+        timer_wheel_add(&t->t, t->due);
+    }
+}
+
+static void advance_to(time_t to)
+{
+    prev_now = now;
+    now = to;
+    last_due = 0;
+    jumping = to - prev_now > STEP_LIMIT;
+    fired = 0;
+    int n = timer_wheel_advance(to);
+    CHECK(n == fired, "advance to %ld returned %d, %d callbacks ran", (long)to, n, fired);
+    check_state();
+}
+
+int main(void)
+{
+    now = 1760000000 + random_below(TOP_SPAN);
+    timer_wheel_init(now);
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        timers[i].t.fn = on_expire;
+        timers[i].t.arg = &timers[i];
+    }
+    CHECK(timer_wheel_next_expiry() == 0, "empty wheel has next expiry %ld", (long)timer_wheel_next_expiry());
+
+    /* Stepping: walk past twice the top span so parked timers come back */
+    time_t end = now + 2 * TOP_SPAN + STEP_LIMIT;
+    shuffle_timers(N_TIMERS);
+    check_state();
+    long advances = 0;
+    while (now < end && failures == 0)
+    {
+        shuffle_timers((int)random_below(4));
+        time_t step = random_below(3) == 0 ? 1 + random_below(TIMER_WHEEL_SLOTS) : 1 + random_below(STEP_LIMIT);
+        advance_to(now + step);
+        advances++;
+
+        /* A clock stepping back only delays */
+        if (random_below(64) == 0)
+        {
+            int n = timer_wheel_advance(now - 1 - random_below(STEP_LIMIT));
+            CHECK(n == 0, "advance backwards expired %d", n);
+            check_state();
+        }
+    }
+
+    /* Jumps: the wheel re-places everything, overdue timers expire at once */
+    for (int k = 0; k < 2000 && failures == 0; k++)
+    {
+        shuffle_timers((int)random_below(16));
+        time_t jump = random_below(2) ? STEP_LIMIT + 1 + random_below((time_t)1 << 20)
+                                      : STEP_LIMIT + 1 + random_below(2 * TOP_SPAN);
+        advance_to(now + jump);
+        advances++;
+    }
+
+    /* A timer armed in the past is reported as it is and expires next */
+    test_timer_t *late = &timers[0];
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        timer_wheel_cancel(&timers[i].t);
+        timers[i].armed = 0;
+        timers[i].period = 0;
+    }
+    late->t.fn = NULL;
+    late->due = now - 30;
+    late->armed = 1;
+    timer_wheel_add(&late->t, late->due);
+    CHECK(timer_wheel_next_expiry() == now - 30, "past timer: next expiry %ld, want %ld",
+          (long)timer_wheel_next_expiry(), (long)(now - 30));
+    CHECK(timer_wheel_advance(now + 1) == 1 && !timer_wheel_pending(&late->t), "past timer did not expire");
+
+    if (failures)
+    {
+        printf("test_timer_wheel: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("test_timer_wheel: ok (%ld advances)\n", advances);
+    return 0;
+}
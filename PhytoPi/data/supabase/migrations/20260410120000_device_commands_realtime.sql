@@ -0,0 +1,16 @@
+-- Migration: Publish device_commands over Realtime
+-- Description: Controllers subscribe to INSERTs on device_commands for their device_id
+--              so queued commands are pushed instead of being polled every 2s.
+--              Polling remains as a slow fallback when the websocket is down.
+
+DO $$
+BEGIN
+  IF NOT EXISTS (
+    SELECT 1 FROM pg_publication_tables
+    WHERE pubname = 'supabase_realtime'
+      AND tablename = 'device_commands'
+      AND schemaname = 'public'
+  ) THEN
+    ALTER PUBLICATION supabase_realtime ADD TABLE public.device_commands;
+  END IF;
+END $$;
@@ -0,0 +1,8 @@
+-- Migration: Record why a device command failed
+-- Description: The controller validates command payloads when it fetches them and
+--              reports rejected or failed commands as status 'failed' with a reason.
+
+ALTER TABLE public.device_commands
+  ADD COLUMN IF NOT EXISTS error text NULL;
+
+COMMENT ON COLUMN public.device_commands.error IS 'Failure reason reported by the device when status = failed (invalid payload, unknown type, hardware error).';
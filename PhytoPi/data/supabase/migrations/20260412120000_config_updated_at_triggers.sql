@@ -0,0 +1,20 @@
+-- Migration: Keep updated_at current on device_thresholds and schedules
+-- Description: Controllers probe the newest updated_at and row count of these
+--              tables and only refetch them when either changes. Bump updated_at
+--              on edits to the configuration columns; last_run_at, which the
+--              device writes itself after each run, deliberately does not count.
+
+DROP TRIGGER IF EXISTS update_device_thresholds_updated_at ON public.device_thresholds;
+CREATE TRIGGER update_device_thresholds_updated_at
+  BEFORE UPDATE OF metric, min_value, max_value, enabled ON public.device_thresholds
+  FOR EACH ROW EXECUTE FUNCTION public.update_updated_at_column();
+
+DROP TRIGGER IF EXISTS update_schedules_updated_at ON public.schedules;
+CREATE TRIGGER update_schedules_updated_at
+  BEFORE UPDATE OF schedule_type, cron_expr, interval_seconds, payload, enabled ON public.schedules
+  FOR EACH ROW EXECUTE FUNCTION public.update_updated_at_column();
+
+CREATE INDEX IF NOT EXISTS idx_device_thresholds_device_updated
+  ON public.device_thresholds(device_id, updated_at DESC);
+CREATE INDEX IF NOT EXISTS idx_schedules_device_updated
+  ON public.schedules(device_id, updated_at DESC);
@@ -0,0 +1,73 @@
+-- Migration: automation_rules
+-- Description: Sensor-to-actuator rules the controller runs locally every
+--              sampling tick: switch an actuator on while a metric is above
+--              (or below) on_value and off again once it is back past
+--              off_value, holding each state at least min_on/min_off seconds.
+
+CREATE TABLE IF NOT EXISTS public.automation_rules (
+  id uuid PRIMARY KEY DEFAULT gen_random_uuid(),
+  device_id uuid NOT NULL REFERENCES public.device_units(id) ON DELETE CASCADE,
+  name text,
+  metric text NOT NULL,
+  comparison text NOT NULL CHECK (comparison IN ('above', 'below')),
+  on_value double precision NOT NULL,
+  off_value double precision,                 -- NULL = on_value (no hysteresis band)
+  actuator text NOT NULL CHECK (actuator IN ('lights', 'pump', 'fans')),
+  duty_percent integer NOT NULL DEFAULT 100 CHECK (duty_percent BETWEEN 1 AND 100), -- fans only
+  min_on_seconds integer NOT NULL DEFAULT 0 CHECK (min_on_seconds >= 0),
+  min_off_seconds integer NOT NULL DEFAULT 0 CHECK (min_off_seconds >= 0),
+  max_on_seconds integer NOT NULL DEFAULT 0 CHECK (max_on_seconds >= 0), -- 0 = no auto-off
+  enabled boolean DEFAULT true,
+  created_at timestamptz DEFAULT now(),
+  updated_at timestamptz DEFAULT now(),
+  -- The band must open away from on_value, or the rule would chatter
+  CHECK (off_value IS NULL
+         OR (comparison = 'above' AND off_value <= on_value)
+         OR (comparison = 'below' AND off_value >= on_value))
+);
+
+CREATE INDEX IF NOT EXISTS idx_automation_rules_device_updated
+  ON public.automation_rules(device_id, updated_at DESC);
+
+ALTER TABLE public.automation_rules ENABLE ROW LEVEL SECURITY;
+
+CREATE POLICY "Owners can manage automation rules"
+  ON public.automation_rules FOR ALL
+  TO authenticated
+  USING (
+    EXISTS (
+      SELECT 1 FROM public.user_devices
+      WHERE user_devices.device_id = automation_rules.device_id
+      AND user_devices.user_id = auth.uid()
+    )
+  )
+  WITH CHECK (
+    EXISTS (
+      SELECT 1 FROM public.user_devices
+      WHERE user_devices.device_id = automation_rules.device_id
+      AND user_devices.user_id = auth.uid()
+    )
+  );
+
+CREATE POLICY "Sharees can view automation rules"
+  ON public.automation_rules FOR SELECT
+  USING (
+    EXISTS (
+      SELECT 1 FROM public.device_shares
+      WHERE device_shares.device_id = automation_rules.device_id
+      AND device_shares.shared_with = auth.uid()
+      AND device_shares.accepted_at IS NOT NULL
+    )
+  );
+
+-- Pi (anon) can read rules for its device
+CREATE POLICY "Devices can read automation rules"
+  ON public.automation_rules FOR SELECT
+  TO anon
+  USING (true);
+
+-- Controllers refetch only when the newest updated_at or the row count changes
+DROP TRIGGER IF EXISTS update_automation_rules_updated_at ON public.automation_rules;
+CREATE TRIGGER update_automation_rules_updated_at
+  BEFORE UPDATE ON public.automation_rules
+  FOR EACH ROW EXECUTE FUNCTION public.update_updated_at_column();